@@ -0,0 +1,100 @@
+// change_detector.c
+#include "change_detector.h"
+#include <math.h>
+#include <string.h>
+
+static float field_value(const nivometro_data_t *d, change_field_t field) {
+    switch (field) {
+        case CHANGE_FIELD_ULTRASONIC:  return d->ultrasonic_distance_cm;
+        case CHANGE_FIELD_WEIGHT:      return d->weight_grams;
+        case CHANGE_FIELD_LASER:       return d->laser_distance_mm;
+        case CHANGE_FIELD_BATTERY:     return d->battery_voltage;
+        case CHANGE_FIELD_TEMPERATURE: return (float)d->temperature_c;
+        default:                       return 0.0f;
+    }
+}
+
+// true si algún campo vigilado se sale de su banda respecto a la última publicada
+static bool outside_deadband(const change_detector_t *det, const nivometro_data_t *d) {
+    for (int i = 0; i < CHANGE_FIELD_COUNT; i++) {
+        const change_deadband_t *band = &det->config.deadband[i];
+        if (band->abs <= 0.0f && band->rel <= 0.0f) {
+            continue;
+        }
+        // Sin medida del aire la temperatura no es un valor con el que comparar
+        if (i == CHANGE_FIELD_TEMPERATURE &&
+            (d->temperature_c == NIVOMETRO_TEMP_UNKNOWN || det->last.temperature_c == NIVOMETRO_TEMP_UNKNOWN)) {
+            continue;
+        }
+        
+        float ref = field_value(&det->last, (change_field_t)i);
+        float limit = fmaxf(band->abs, band->rel * fabsf(ref));
+        if (fabsf(field_value(d, (change_field_t)i) - ref) > limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+change_detector_config_t change_detector_default_config(void) {
+    change_detector_config_t config = {
+        .deadband = {
+            [CHANGE_FIELD_ULTRASONIC]  = { CHANGE_DEADBAND_ULTRASONIC_CM, 0.0f },
+            [CHANGE_FIELD_WEIGHT]      = { CHANGE_DEADBAND_WEIGHT_G, CHANGE_DEADBAND_WEIGHT_REL },
+            [CHANGE_FIELD_LASER]       = { CHANGE_DEADBAND_LASER_MM, 0.0f },
+            [CHANGE_FIELD_BATTERY]     = { CHANGE_DEADBAND_BATTERY_V, 0.0f },
+            [CHANGE_FIELD_TEMPERATURE] = { CHANGE_DEADBAND_TEMPERATURE_C, 0.0f },
+        },
+        .heartbeat_ms = CHANGE_HEARTBEAT_MS,
+    };
+    return config;
+}
+
+void change_detector_init(change_detector_t *det, const change_detector_config_t *config) {
+    if (det == NULL) {
+        return;
+    }
+    
+    memset(det, 0, sizeof(*det));
+    det->config = config ? *config : change_detector_default_config();
+}
+
+change_reason_t change_detector_check(change_detector_t *det, const nivometro_data_t *data) {
+    change_reason_t reason = CHANGE_SUPPRESSED;
+    if (det == NULL || data == NULL) {
+        return CHANGE_SUPPRESSED;
+    }
+    
+    if (!det->has_last) {
+        reason = CHANGE_FIRST;
+    } else if (data->sensor_status != det->last.sensor_status) {
+        reason = CHANGE_STATUS;
+    } else if (outside_deadband(det, data)) {
+        reason = CHANGE_DEADBAND;
+    } else if (det->config.heartbeat_ms > 0 &&
+               (data->timestamp_us < det->last.timestamp_us ||   // Reloj corregido hacia atrás: no fiarse del silencio
+                data->timestamp_us - det->last.timestamp_us >= (uint64_t)det->config.heartbeat_ms * 1000)) {
+        reason = CHANGE_HEARTBEAT;
+    }
+    
+    det->stats.seen++;
+    det->stats.reasons[reason]++;
+    if (reason == CHANGE_SUPPRESSED) {
+        det->stats.suppressed++;
+    } else {
+        det->last = *data;
+        det->has_last = true;
+    }
+    return reason;
+}
+
+const char *change_detector_reason_string(change_reason_t reason) {
+    switch (reason) {
+        case CHANGE_SUPPRESSED: return "suppressed";
+        case CHANGE_FIRST:      return "first";
+        case CHANGE_STATUS:     return "status";
+        case CHANGE_DEADBAND:   return "deadband";
+        case CHANGE_HEARTBEAT:  return "heartbeat";
+        default:                return "unknown";
+    }
+}
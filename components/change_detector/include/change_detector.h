@@ -0,0 +1,106 @@
+// change_detector.h
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nivometro_sensors.h"
+
+/*
+ * Informe por excepción: decide qué muestras merecen transmitirse
+ *
+ * Una muestra se publica si:
+ *   - es la primera,
+ *   - cambia sensor_status respecto a la última publicada,
+ *   - algún campo se aleja de su último valor publicado más que su banda muerta,
+ *     max(abs, rel * |último|), o
+ *   - han pasado heartbeat_ms desde la última publicada (latido).
+ * El resto se suprime y solo se cuenta. Las comparaciones son siempre contra la
+ * última muestra publicada, así que una deriva lenta acaba saliendo al superar la banda.
+ */
+
+// Campos vigilados
+typedef enum {
+    CHANGE_FIELD_ULTRASONIC = 0,     // ultrasonic_distance_cm
+    CHANGE_FIELD_WEIGHT,             // weight_grams
+    CHANGE_FIELD_LASER,              // laser_distance_mm
+    CHANGE_FIELD_BATTERY,            // battery_voltage
+    CHANGE_FIELD_TEMPERATURE,        // temperature_c (ignorado mientras valga NIVOMETRO_TEMP_UNKNOWN)
+    CHANGE_FIELD_COUNT
+} change_field_t;
+
+// Valores por defecto de las bandas muertas (abs en unidades del campo, rel en fracción)
+#define CHANGE_DEADBAND_ULTRASONIC_CM   1.0f    // Por encima del ruido del HC-SR04P filtrado
+#define CHANGE_DEADBAND_WEIGHT_G        50.0f
+#define CHANGE_DEADBAND_WEIGHT_REL      0.02f
+#define CHANGE_DEADBAND_LASER_MM        10.0f
+#define CHANGE_DEADBAND_BATTERY_V       0.05f
+#define CHANGE_DEADBAND_TEMPERATURE_C   2.0f
+#define CHANGE_HEARTBEAT_MS             3600000 // Al menos una muestra por hora aunque no cambie nada
+
+// Motivo de la decisión
+typedef enum {
+    CHANGE_SUPPRESSED = 0,           // Dentro de todas las bandas: no se publica
+    CHANGE_FIRST,                    // Primera muestra
+    CHANGE_STATUS,                   // Cambio de sensor_status
+    CHANGE_DEADBAND,                 // Algún campo fuera de su banda
+    CHANGE_HEARTBEAT,                // Latido por silencio máximo
+    CHANGE_REASON_COUNT
+} change_reason_t;
+
+// Banda muerta de un campo (abs = 0 y rel = 0: campo no vigilado)
+typedef struct {
+    float abs;
+    float rel;
+} change_deadband_t;
+
+// Configuración del detector
+typedef struct {
+    change_deadband_t deadband[CHANGE_FIELD_COUNT];
+    uint32_t heartbeat_ms;           // Silencio máximo (0 = sin latido)
+} change_detector_config_t;
+
+// Contadores
+typedef struct {
+    uint32_t seen;                   // Muestras evaluadas
+    uint32_t suppressed;             // Muestras suprimidas
+    uint32_t reasons[CHANGE_REASON_COUNT];  // Muestras por motivo (reasons[0] = suprimidas)
+} change_detector_stats_t;
+
+// Estado del detector (sin punteros: se puede conservar en memoria rtc)
+typedef struct {
+    change_detector_config_t config;
+    nivometro_data_t last;           // Última muestra publicada
+    bool has_last;
+    change_detector_stats_t stats;
+} change_detector_t;
+
+/**
+ * @brief Configuración con las bandas y el latido por defecto
+ * @return Configuración por defecto
+ */
+change_detector_config_t change_detector_default_config(void);
+
+/**
+ * @brief Inicializa el detector
+ * @param det Puntero al detector
+ * @param config Configuración (NULL = por defecto)
+ */
+void change_detector_init(change_detector_t *det, const change_detector_config_t *config);
+
+/**
+ * @brief Decide si una muestra se publica; si es así pasa a ser la referencia
+ * @param det Puntero al detector
+ * @param data Muestra (su timestamp_us mide el silencio)
+ * @return CHANGE_SUPPRESSED o el motivo de publicarla
+ */
+change_reason_t change_detector_check(change_detector_t *det, const nivometro_data_t *data);
+
+/**
+ * @brief Nombre corto de un motivo (logs y diagnóstico)
+ * @param reason Motivo
+ * @return Cadena constante
+ */
+const char *change_detector_reason_string(change_reason_t reason);
+
+#endif // CHANGE_DETECTOR_H
@@ -1,47 +1,150 @@
 #include "communication.h"
+#include <string.h>
+#include "sample_codec.h"
+#include "json_writer.h"
 #include "esp_netif.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
 #include "nivometro_sensors.h"
-#include "esp_sntp.h"
+#include "time_sync.h"
+#include <stdlib.h>
 #include <sys/time.h>
 #include <time.h>
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 
 #include "communication_secrets.h"                     // Aquí están ssid, contraseña y uri del broker mqtt
 
 static const char* TAG = "communication";              // Etiqueta que usará esp_logx para clasificar mensajes de este módulo
 static esp_mqtt_client_handle_t mqtt_client = NULL;    // Puntero al cliente mqtt una vez inicializado
-static bool mqtt_started = false;                      // Indica si ya se ha arrancado el cliente mqtt
 
 // Grupo de eventos para coordinar estado wifi y mqtt
 static EventGroupHandle_t comm_event_group;
 static const int WIFI_CONNECTED_BIT = BIT0;            // Bit que marca wifi listo
 static const int MQTT_CONNECTED_BIT = BIT1;            // Bit que marca mqtt listo
+static const int MQTT_PUBLISHED_BIT = BIT2;            // Bit que marca la llegada de un PUBACK
 
-// Topics mqtt donde se publicarán los datos
-static const char* MQTT_TOPIC_ULTRASONIC = "sensors/ultrasonic";
-static const char* MQTT_TOPIC_WEIGHT     = "sensors/weight";
-static const char* MQTT_TOPIC_LASER      = "sensors/laser";
+// Mensajes QoS1 publicados sin PUBACK todavía; el manejador mqtt los retira al confirmarse.
+// Los anillos de msg_id recientes se consumen al coincidir y se vacían al reconectar: el cliente
+// reutiliza los msg_id y una entrada vieja haría pasar una muestra nueva por confirmada o perdida
+#define RECENT_IDS_LEN       8                          // PUBACK adelantados y mensajes descartados recordados
+#define PUBLISHED_POLL_MS    50                         // Reintento de espera si otro esperador consumió el aviso
+static int outstanding_ids[COMM_MAX_OUTSTANDING];
+static uint8_t outstanding_count = 0;
+static int early_acked_ids[RECENT_IDS_LEN];             // PUBACK llegado antes de anotar el msg_id
+static uint8_t early_acked_next = 0;
+static int failed_ids[RECENT_IDS_LEN];                  // Descartados por el cliente (MQTT_EVENT_DELETED)
+static uint8_t failed_next = 0;
+static portMUX_TYPE outstanding_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t publish_mutex;                 // Serializa publicadores y el buffer batch_msg
+static uint32_t last_drain_ms = 0;
+
+// Petición de reenvío del histórico recibida por mqtt (la recoge la tarea de reenvío)
+#define REPLAY_PAYLOAD_MAX   24                         // Un uint64 en decimal cabe de sobra
+static uint64_t replay_since_us;
+static bool replay_requested = false;
+static portMUX_TYPE replay_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Última conexión wifi buena, conservada en memoria rtc durante el deep sleep
+#define WIFI_CACHE_MAGIC               0x57494649       // "WIFI"
+#define WIFI_CACHE_MAX_USES            100              // Renovar por dhcp cada N despertares
+#define WIFI_FAST_CONNECT_TIMEOUT_MS   3000             // Plazo de la conexión dirigida con caché
+#define WIFI_FULL_CONNECT_TIMEOUT_MS   20000            // Plazo del escaneo completo + dhcp
+#define TIME_SYNC_COLD_WAIT_MS         5000             // Espera máxima de sntp si la hora no es válida
+
+typedef struct {
+    uint32_t magic;                                     // WIFI_CACHE_MAGIC si el resto es válido
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint16_t uses;                                      // Despertares que la han reutilizado
+    esp_netif_ip_info_t ip_info;                        // ip, máscara y puerta de enlace
+    uint32_t dns;
+} wifi_cache_t;
+
+static RTC_DATA_ATTR wifi_cache_t wifi_cache;
+static RTC_DATA_ATTR communication_connect_stats_t connect_stats;
+static esp_netif_t* sta_netif = NULL;                   // Interfaz de la estación
+static volatile bool wifi_retry = true;                 // El manejador relanza la conexión tras una desconexión
+
+// Mensaje de lote: cabecera + una entrada por muestra
+#define BATCH_MSG_SIZE   2048                           // Cabe COMM_BATCH_MAX muestras con margen
+static char batch_msg[BATCH_MSG_SIZE];                  // Buffer estático para no cargar la pila de la tarea
+static nivometro_data_t stamped[COMM_BATCH_MAX];        // Copia del lote con la hora corregida (publish_mutex)
+_Static_assert(SAMPLE_CODEC_V2_SIZE_MAX(COMM_BATCH_MAX) <= BATCH_MSG_SIZE, "el lote binario no cabe en batch_msg");
 
 // Prototipos de funciones internas
+static bool remove_outstanding(int msg_id);
+static void clear_recent_ids(void);
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data);
-static void init_sntp_and_wait(void);                    // Arranca sntp y espera a sincronizar hora
-static void get_iso8601_utc(char *out, size_t out_size); // Rellena out con timestamp utc en formato iso8601
 
-void communication_init(void) {
+// Configura la estación: con caché, conexión dirigida (canal + bssid) e ip estática; sin ella, escaneo completo y dhcp
+static esp_err_t configure_sta(bool use_cache) {
+    wifi_config_t wifi_cfg = {
+        .sta = {
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK
+        }
+    };
+
+    // Copiar ssid y password con límite de tamaño
+    strncpy((char*)wifi_cfg.sta.ssid, WIFI_SSID, sizeof(wifi_cfg.sta.ssid));
+    strncpy((char*)wifi_cfg.sta.password, WIFI_PASSWORD, sizeof(wifi_cfg.sta.password));
+
+    if (use_cache) {
+        wifi_cfg.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_cfg.sta.channel = wifi_cache.channel;
+        wifi_cfg.sta.bssid_set = true;
+        memcpy(wifi_cfg.sta.bssid, wifi_cache.bssid, sizeof(wifi_cfg.sta.bssid));
+
+        // Reutilizar la concesión anterior: sin DISCOVER/OFFER/REQUEST/ACK
+        esp_netif_dhcpc_stop(sta_netif);
+        esp_netif_set_ip_info(sta_netif, &wifi_cache.ip_info);
+        esp_netif_dns_info_t dns = { .ip.u_addr.ip4.addr = wifi_cache.dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    } else {
+        wifi_cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_netif_dhcpc_start(sta_netif);
+    }
+    return esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg);
+}
+
+// Espera WIFI_CONNECTED_BIT como mucho timeout_ms
+static bool wait_wifi(uint32_t timeout_ms) {
+    EventBits_t bits = xEventGroupWaitBits(comm_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+// Guarda canal, bssid e ip de la conexión actual para el próximo despertar
+static void save_wifi_cache(const esp_netif_ip_info_t* ip_info) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return;
+
+    esp_netif_dns_info_t dns = { 0 };
+    esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+
+    memcpy(wifi_cache.bssid, ap.bssid, sizeof(wifi_cache.bssid));
+    wifi_cache.channel = ap.primary;
+    wifi_cache.ip_info = *ip_info;
+    wifi_cache.dns = dns.ip.u_addr.ip4.addr;
+    wifi_cache.magic = WIFI_CACHE_MAGIC;
+}
+
+esp_err_t communication_init(void) {
     // Crea el grupo de eventos para coordinar wifi y mqtt
     comm_event_group = xEventGroupCreate();
+    publish_mutex = xSemaphoreCreateMutex();
 
     ESP_LOGI(TAG, "Initializing communication module...");
 
     // 1) Inicializar capa de red y sistema de eventos
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();                // Prepara interfaz wifi en modo estación (sta)
+    sta_netif = esp_netif_create_default_wifi_sta();    // Prepara interfaz wifi en modo estación (sta)
 
     // 2) Configurar driver wifi
     wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -53,29 +156,64 @@ void communication_init(void) {
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &wifi_any_id_handle));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &ip_got_ip_handle));
 
-    // 4) Preparar credenciales extraídas de communication_secrets.h
-    wifi_config_t wifi_cfg = {
-        .sta = {
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK
-        }
-    };
-
-    // Copiar ssid y password con límite de tamaño
-    strncpy((char*)wifi_cfg.sta.ssid, WIFI_SSID, sizeof(wifi_cfg.sta.ssid));
-    strncpy((char*)wifi_cfg.sta.password, WIFI_PASSWORD, sizeof(wifi_cfg.sta.password));
+    // 4) Preparar credenciales extraídas de communication_secrets.h; con caché válida, conexión rápida
+    bool use_cache = wifi_cache.magic == WIFI_CACHE_MAGIC && wifi_cache.uses < WIFI_CACHE_MAX_USES;
+    if (use_cache) wifi_cache.uses++;
+    esp_err_t err = configure_sta(use_cache);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi config failed: %s", esp_err_to_name(err));
+        return err;
+    }
 
     // 5) Arrancar wifi en modo sta con esa configuración
+    int64_t t0 = esp_timer_get_time();
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_cfg));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    // 6) Bloquear aquí hasta que el handler marque WIFI_CONNECTED_BIT
-    xEventGroupWaitBits(comm_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    // 6) Esperar WIFI_CONNECTED_BIT con plazo; si la conexión dirigida falla, escaneo completo y dhcp
+    bool connected = wait_wifi(use_cache ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_FULL_CONNECT_TIMEOUT_MS);
+    bool fast = use_cache && connected;
+    if (use_cache) {
+        if (connected) {
+            connect_stats.fast_ok++;
+        } else {
+            ESP_LOGW(TAG, "Fast reconnect failed, falling back to full scan");
+            connect_stats.fast_fail++;
+            wifi_cache.magic = 0;
+            // Con el driver conectando no se admite set_config (ESP_ERR_WIFI_STATE): parar sin que el
+            // manejador relance la conexión, reconfigurar y arrancar de nuevo (STA_START conecta)
+            wifi_retry = false;
+            esp_wifi_stop();
+            err = configure_sta(false);
+            if (err == ESP_OK) err = esp_wifi_start();
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Wi-Fi fallback failed: %s", esp_err_to_name(err));
+            }
+        }
+    }
+    if (!fast) {
+        connected = connected || (err == ESP_OK && wait_wifi(WIFI_FULL_CONNECT_TIMEOUT_MS));
+        if (connected) connect_stats.full_ok++;
+        else connect_stats.full_fail++;
+    }
+    connect_stats.last_fast = fast;
+    connect_stats.last_connect_ms = connected ? (uint32_t)((esp_timer_get_time() - t0) / 1000) : 0;
 
-    // 7) Una vez con wifi, sincronizar hora con sntp
-    init_sntp_and_wait();
+    if (connected) {
+        ESP_LOGI(TAG, "Wi-Fi connected in %lu ms (%s)", (unsigned long)connect_stats.last_connect_ms,
+                 connect_stats.last_fast ? "cached" : "full scan");
+        // 7) La hora se resincroniza en segundo plano (GOT_IP); solo tras un arranque en frío
+        //    se espera, y de forma acotada, para no sellar las primeras muestras en 1970
+        if (!time_sync_is_valid()) {
+            time_sync_wait(TIME_SYNC_COLD_WAIT_MS);
+        }
+    } else {
+        // Sigue reintentando en segundo plano; las muestras van al outbox mientras tanto
+        ESP_LOGW(TAG, "Wi-Fi not connected after deadline, continuing offline");
+    }
 
     // 8) Configurar y arrancar cliente mqtt usando URI de communication_secrets.h
+    //    (se reconecta solo cuando la red esté disponible)
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = MQTT_URI
     };
@@ -83,7 +221,11 @@ void communication_init(void) {
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(
         mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
     esp_mqtt_client_start(mqtt_client);
-    mqtt_started = true;
+    return connected ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void communication_get_connect_stats(communication_connect_stats_t* out) {
+    if (out) *out = connect_stats;
 }
 
 void communication_wait_for_connection(void) {
@@ -94,74 +236,321 @@ void communication_wait_for_connection(void) {
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     // Lógica según evento wifi/ip
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        // Al arrancar wifi, disparar conexión
+        // Al arrancar wifi, disparar conexión; las desconexiones anteriores a este evento ya se
+        // han atendido (cola de eventos en orden), a partir de aquí se vuelve a reintentar
+        wifi_retry = true;
         esp_wifi_connect();
 
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        // Si se desconecta: limpiar bits y reintentar
+        // Si se desconecta: limpiar bits y reintentar (salvo mientras se reconfigura la estación)
         xEventGroupClearBits(comm_event_group, WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT);
-        mqtt_started = false;
-        esp_wifi_connect();
+        if (wifi_retry) esp_wifi_connect();
 
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        // Cuando obtiene ip, marcar wifi listo
+        // Cuando obtiene ip, recordar la conexión y marcar wifi listo
+        ip_event_got_ip_t* event = event_data;
+        save_wifi_cache(&event->ip_info);
+        time_sync_start();                              // Solo contacta con sntp si ha vencido el intervalo
         xEventGroupSetBits(comm_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
+// Petición de reenvío del histórico: timestamp en µs, el mismo "ts" de los lotes
+static void handle_replay_request(esp_mqtt_event_handle_t event) {
+    size_t topic_len = strlen(COMM_TOPIC_REPLAY);
+    if (event->topic_len != (int)topic_len || memcmp(event->topic, COMM_TOPIC_REPLAY, topic_len) != 0) return;
+
+    char payload[REPLAY_PAYLOAD_MAX];
+    char* end = payload;
+    unsigned long long since_us = 0;
+    if (event->data_len > 0 && event->data_len < (int)sizeof(payload) && event->data_len == event->total_data_len) {
+        memcpy(payload, event->data, event->data_len);
+        payload[event->data_len] = '\0';
+        since_us = strtoull(payload, &end, 10);
+    }
+    if (end == payload || *end != '\0') {
+        ESP_LOGW(TAG, "Ignoring malformed replay request (%d bytes)", event->data_len);
+        return;
+    }
+
+    taskENTER_CRITICAL(&replay_lock);
+    replay_since_us = since_us;
+    replay_requested = true;
+    taskEXIT_CRITICAL(&replay_lock);
+    ESP_LOGI(TAG, "Replay requested since %llu us", since_us);
+}
+
 static void mqtt_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
     // Lógica para eventos del cliente mqtt
     if (event_id == MQTT_EVENT_CONNECTED) {
-        // Se conectó al broker -> marcar mqtt listo
+        // Se conectó al broker -> olvidar los msg_id de la sesión anterior y marcar mqtt listo
+        taskENTER_CRITICAL(&outstanding_lock);
+        clear_recent_ids();
+        taskEXIT_CRITICAL(&outstanding_lock);
+        esp_mqtt_client_subscribe(mqtt_client, COMM_TOPIC_REPLAY, 1);
         xEventGroupSetBits(comm_event_group, MQTT_CONNECTED_BIT);
 
+    } else if (event_id == MQTT_EVENT_DATA) {
+        // Mensaje en un topic suscrito -> por ahora solo peticiones de reenvío
+        handle_replay_request(event_data);
+
     } else if (event_id == MQTT_EVENT_DISCONNECTED) {
         // Desconexión del broker -> limpiar bit y marcar estado
         xEventGroupClearBits(comm_event_group, MQTT_CONNECTED_BIT);
-        mqtt_started = false;
+
+    } else if (event_id == MQTT_EVENT_PUBLISHED || event_id == MQTT_EVENT_DELETED) {
+        // PUBACK recibido (o mensaje caducado en el outbox del cliente) -> deja de estar pendiente
+        esp_mqtt_event_handle_t event = event_data;
+        taskENTER_CRITICAL(&outstanding_lock);
+        if (!remove_outstanding(event->msg_id) && event_id == MQTT_EVENT_PUBLISHED) {
+            early_acked_ids[early_acked_next] = event->msg_id;
+            early_acked_next = (early_acked_next + 1) % RECENT_IDS_LEN;
+        }
+        if (event_id == MQTT_EVENT_DELETED) {
+            failed_ids[failed_next] = event->msg_id;
+            failed_next = (failed_next + 1) % RECENT_IDS_LEN;
+        }
+        taskEXIT_CRITICAL(&outstanding_lock);
+        xEventGroupSetBits(comm_event_group, MQTT_PUBLISHED_BIT);
+    }
+}
+
+// Las funciones siguientes se llaman con outstanding_lock tomado
+static bool remove_outstanding(int msg_id) {
+    for (uint8_t i = 0; i < outstanding_count; i++) {
+        if (outstanding_ids[i] == msg_id) {
+            outstanding_ids[i] = outstanding_ids[--outstanding_count];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool find_id(const int* ids, size_t len, int msg_id) {
+    for (size_t i = 0; i < len; i++) {
+        if (ids[i] == msg_id) return true;
+    }
+    return false;
+}
+
+static bool is_outstanding(int msg_id) {
+    return find_id(outstanding_ids, outstanding_count, msg_id);
+}
+
+// Busca msg_id en un anillo de recientes y lo retira (0 = hueco libre, los msg_id válidos son > 0)
+static bool take_id(int* ids, size_t len, int msg_id) {
+    for (size_t i = 0; i < len; i++) {
+        if (ids[i] == msg_id) {
+            ids[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void clear_recent_ids(void) {
+    memset(early_acked_ids, 0, sizeof(early_acked_ids));
+    memset(failed_ids, 0, sizeof(failed_ids));
+    early_acked_next = 0;
+    failed_next = 0;
+}
+
+// Publica QoS1 y anota el msg_id como pendiente; -1 si no hay hueco para seguirlo o falla el cliente
+static int publish_tracked(const char* topic, const char* data, int len) {
+    taskENTER_CRITICAL(&outstanding_lock);
+    bool full = outstanding_count >= COMM_MAX_OUTSTANDING;
+    taskEXIT_CRITICAL(&outstanding_lock);
+    if (full) {
+        ESP_LOGW(TAG, "%d messages awaiting PUBACK, not publishing to %s", COMM_MAX_OUTSTANDING, topic);
+        return -1;
+    }
+
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, len, 1, 0);
+    if (msg_id > 0) {
+        taskENTER_CRITICAL(&outstanding_lock);
+        take_id(failed_ids, RECENT_IDS_LEN, msg_id);  // Descarte de un mensaje anterior con el mismo id
+        if (!take_id(early_acked_ids, RECENT_IDS_LEN, msg_id)) {
+            outstanding_ids[outstanding_count++] = msg_id;
+        }
+        taskEXIT_CRITICAL(&outstanding_lock);
+    }
+    return msg_id;
+}
+
+bool communication_wait_connected(uint32_t timeout_ms) {
+    if (!comm_event_group) return false;
+    EventBits_t bits = xEventGroupWaitBits(comm_event_group, MQTT_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & MQTT_CONNECTED_BIT) != 0;
+}
+
+// Espera hasta que done() se cumpla o venza el plazo; cualquier PUBACK despierta para volver a comprobar
+static bool wait_publish_event(bool (*done)(int), int arg, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    while (!done(arg)) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) return false;
+        TickType_t wait = timeout - elapsed;
+        if (wait > pdMS_TO_TICKS(PUBLISHED_POLL_MS)) wait = pdMS_TO_TICKS(PUBLISHED_POLL_MS);
+        xEventGroupWaitBits(comm_event_group, MQTT_PUBLISHED_BIT, pdTRUE, pdFALSE, wait);
+    }
+    return true;
+}
+
+static bool id_settled(int msg_id) {
+    taskENTER_CRITICAL(&outstanding_lock);
+    bool pending = is_outstanding(msg_id);
+    taskEXIT_CRITICAL(&outstanding_lock);
+    return !pending;
+}
+
+static bool none_outstanding(int unused) {
+    (void)unused;
+    return communication_outstanding_count() == 0;
+}
+
+bool communication_wait_published(int msg_id, uint32_t timeout_ms) {
+    if (!comm_event_group || msg_id <= 0) return false;
+    if (!wait_publish_event(id_settled, msg_id, timeout_ms)) return false;
+
+    // Fuera de la lista: confirmado, salvo que el cliente lo descartara
+    taskENTER_CRITICAL(&outstanding_lock);
+    bool failed = take_id(failed_ids, RECENT_IDS_LEN, msg_id);
+    taskEXIT_CRITICAL(&outstanding_lock);
+    return !failed;
+}
+
+size_t communication_outstanding_count(void) {
+    taskENTER_CRITICAL(&outstanding_lock);
+    size_t count = outstanding_count;
+    taskEXIT_CRITICAL(&outstanding_lock);
+    return count;
+}
+
+bool communication_wait_all_published(uint32_t timeout_ms) {
+    if (!comm_event_group) return false;
+    int64_t t0 = esp_timer_get_time();
+    size_t pending = communication_outstanding_count();
+
+    bool drained = wait_publish_event(none_outstanding, 0, timeout_ms);
+    last_drain_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    if (drained) {
+        ESP_LOGI(TAG, "Outbox drained: %u messages confirmed in %lu ms",
+                 (unsigned)pending, (unsigned long)last_drain_ms);
+    } else {
+        ESP_LOGW(TAG, "Outbox not drained after %lu ms, %u messages without PUBACK",
+                 (unsigned long)last_drain_ms, (unsigned)communication_outstanding_count());
     }
+    return drained;
+}
+
+uint32_t communication_last_drain_ms(void) {
+    return last_drain_ms;
+}
+
+bool communication_take_replay_request(uint64_t* since_us) {
+    if (!since_us) return false;
+    taskENTER_CRITICAL(&replay_lock);
+    bool requested = replay_requested;
+    if (requested) *since_us = replay_since_us;
+    replay_requested = false;
+    taskEXIT_CRITICAL(&replay_lock);
+    return requested;
+}
+
+int communication_publish(const char* topic, const char* payload) {
+    // Protege contra llamadas inválidas
+    if (!mqtt_client || !topic || !payload) return -1;
+
+    xSemaphoreTake(publish_mutex, portMAX_DELAY);
+    int msg_id = publish_tracked(topic, payload, 0);
+    xSemaphoreGive(publish_mutex);
+    ESP_LOGI(TAG, "Published to %s: %s", topic, payload);
+    return msg_id;
 }
 
-static void init_sntp_and_wait(void) {
-    // Configura sntp para obtener la hora
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    esp_sntp_init();
-    // Espera en bucle hasta que se sincronice
-    while (sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+// Devuelve el lote con las marcas anteriores a la primera sincronización llevadas a UTC
+// (se llama con publish_mutex tomado); sin esas marcas, el propio lote sin copiar
+static const nivometro_data_t* stamp_samples(const nivometro_data_t* samples, size_t count) {
+    size_t first = 0;
+    while (first < count && time_sync_timestamp_valid(samples[first].timestamp_us)) first++;
+    if (first == count) return samples;
+
+    memcpy(stamped, samples, count * sizeof(*samples));
+    for (size_t i = first; i < count; i++) {
+        stamped[i].timestamp_us = time_sync_correct_us(samples[i].timestamp_us);
     }
+    if (!time_sync_timestamp_valid(stamped[count - 1].timestamp_us)) {
+        ESP_LOGW(TAG, "Publishing samples without synchronized time");
+    }
+    return stamped;
 }
 
-static void get_iso8601_utc(char *out, size_t out_size) {
-    // Obtiene tiempo actual y lo formatea en iso8601 utc
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    struct tm tm_utc;
-    gmtime_r(&tv.tv_sec, &tm_utc);
-    strftime(out, out_size, "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+int communication_publish_batch(const nivometro_data_t* samples, size_t count) {
+    // Protege contra llamadas inválidas
+    if (!mqtt_client || !samples || count == 0) return -1;
+    if (count > COMM_BATCH_MAX) count = COMM_BATCH_MAX;
+
+    // {"v":1,"n":N,"s":[{...},{...}]} -> una sola cabecera mqtt, un topic y un PUBACK para N muestras
+    xSemaphoreTake(publish_mutex, portMAX_DELAY);
+    samples = stamp_samples(samples, count);
+    json_writer_t w;
+    json_writer_init(&w, batch_msg, sizeof(batch_msg));
+    json_obj_begin(&w, NULL);
+    json_write_uint(&w, "v", 1);
+    json_write_uint(&w, "n", count);
+    json_arr_begin(&w, "s");
+    for (size_t i = 0; i < count; i++) {
+        const nivometro_data_t* d = &samples[i];
+        json_obj_begin(&w, NULL);
+        json_write_uint(&w, "ts", d->timestamp_us);
+        json_write_fixed(&w, "us_cm", d->ultrasonic_distance_cm, 2);
+        json_write_fixed(&w, "us_q", d->ultrasonic_confidence, 2);
+        json_write_fixed(&w, "w_g", d->weight_grams, 2);
+        json_write_fixed(&w, "l_mm", d->laser_distance_mm, 0);
+        json_write_uint(&w, "st", d->sensor_status);
+        json_write_fixed(&w, "bat_v", d->battery_voltage, 2);
+        if (d->temperature_c != NIVOMETRO_TEMP_UNKNOWN) {
+            json_write_int(&w, "t_c", d->temperature_c);
+        }
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    int len = json_writer_finish(&w);
+    if (len < 0) {
+        xSemaphoreGive(publish_mutex);
+        ESP_LOGE(TAG, "Batch of %u samples does not fit in %d bytes", (unsigned)count, BATCH_MSG_SIZE);
+        return -1;
+    }
+
+    int msg_id = publish_tracked(COMM_TOPIC_BATCH, batch_msg, len);
+    xSemaphoreGive(publish_mutex);
+    ESP_LOGI(TAG, "Published batch of %u samples (%d bytes) to %s, msg_id=%d",
+             (unsigned)count, len, COMM_TOPIC_BATCH, msg_id);
+    return msg_id;
 }
 
-void communication_publish(const sensor_data_t* data) {
+int communication_publish_batch_binary(const nivometro_data_t* samples, size_t count) {
     // Protege contra llamadas inválidas
-    if (!mqtt_client || !data) return;
-
-    char ts[32], msg[128];
-    // Timestamp en utc
-    get_iso8601_utc(ts, sizeof(ts));
-
-    // Publicar valor del sensor de ultrasonidos
-    snprintf(msg, sizeof(msg), "{\"value\": %.2f, \"timestamp\": \"%s\"}", data->distance_cm, ts); 
-    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_ULTRASONIC, msg, 0, 1, 0);
-    ESP_LOGI(TAG, "Published to %s: %s", MQTT_TOPIC_ULTRASONIC, msg);
-
-    // Publicar valor del sensor de peso
-    snprintf(msg, sizeof(msg), "{\"value\": %.2f, \"timestamp\": \"%s\"}", data->weight_kg, ts);
-    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_WEIGHT, msg, 0, 1, 0);
-    ESP_LOGI(TAG, "Published to %s: %s", MQTT_TOPIC_WEIGHT, msg);
-
-    // Publicar valor del sensor de laser
-    snprintf(msg, sizeof(msg), "{\"value\": %.2f, \"timestamp\": \"%s\"}", data->laser_mm, ts);
-    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_LASER, msg, 0, 1, 0);
-    ESP_LOGI(TAG, "Published to %s: %s", MQTT_TOPIC_LASER, msg);
+    if (!mqtt_client || !samples || count == 0) return -1;
+    if (count > COMM_BATCH_MAX) count = COMM_BATCH_MAX;
+
+    // Comparte el buffer con el lote json, protegido por publish_mutex
+    xSemaphoreTake(publish_mutex, portMAX_DELAY);
+    samples = stamp_samples(samples, count);
+    int len = sample_codec_encode_v2(samples, count, (uint8_t*)batch_msg, sizeof(batch_msg));
+    if (len < 0) {
+        xSemaphoreGive(publish_mutex);
+        ESP_LOGE(TAG, "Could not encode batch of %u samples", (unsigned)count);
+        return -1;
+    }
+
+    int msg_id = publish_tracked(COMM_TOPIC_BATCH_BIN, batch_msg, len);
+    xSemaphoreGive(publish_mutex);
+    ESP_LOGI(TAG, "Published binary batch of %u samples (%d bytes) to %s, msg_id=%d",
+             (unsigned)count, len, COMM_TOPIC_BATCH_BIN, msg_id);
+    return msg_id;
 }
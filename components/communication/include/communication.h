@@ -1,17 +1,69 @@
 #pragma once    // Le indica al compilador que procese este fichero solo una vez por compilacion
 
 #include <esp_err.h>
-#include "sensnivometro_sensorsors.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "nivometro_sensors.h"
+
+#define COMM_TOPIC_BATCH      "nivometro/antartica/batch"   // Topic único para los lotes de muestras
+#define COMM_TOPIC_BATCH_BIN  "nivometro/antartica/batch/bin" // Lotes en binario (sample_codec)
+#define COMM_TOPIC_REPLAY     "nivometro/antartica/cmd/replay" // Petición de reenvío del histórico: payload = ts en µs (decimal)
+#define COMM_BATCH_MAX        16                            // Máximo de muestras por mensaje
+#define COMM_MAX_OUTSTANDING  16                            // Mensajes QoS1 sin PUBACK a la vez; más allá publish devuelve -1
+
+// Métricas de conexión wifi (acumuladas entre despertares en memoria rtc)
+typedef struct {
+    uint32_t last_connect_ms;                           // Duración de la última conexión (0 si no conectó)
+    bool last_fast;                                     // La última conexión usó la caché (canal, bssid, ip)
+    uint32_t fast_ok, fast_fail;                        // Conexiones dirigidas con caché
+    uint32_t full_ok, full_fail;                        // Conexiones con escaneo completo y dhcp
+} communication_connect_stats_t;
 
 // Arranca la interfaz Wi-Fi y el cliente MQTT
 // Registra los manejadores de evento (connected, disconnected) para gestionar el estado de la conexión.
-void communication_init(void);
+// Reutiliza canal, bssid e ip del último despertar; si no conecta en plazo hace escaneo completo.
+// Devuelve ESP_ERR_TIMEOUT si no hubo wifi en plazo (sigue reintentando en segundo plano).
+esp_err_t communication_init(void);
+
+// Copia las métricas de conexión wifi
+void communication_get_connect_stats(communication_connect_stats_t* out);
 
 // // Bloquea la ejecución hasta que tanto Wi-Fi como MQTT confirmen conexión exitosa
 void communication_wait_for_connection(void);
 
-//Publica los datos de los sensores en 3 topics diferentes: sensors/ultrasonic, sensors/weight y sensors/laser
-void communication_publish(const sensor_data_t* data);
+// Espera como mucho timeout_ms a que mqtt esté conectado; true si lo está
+bool communication_wait_connected(uint32_t timeout_ms);
+
+// Espera el PUBACK (MQTT_EVENT_PUBLISHED) del mensaje msg_id; true si llegó antes de timeout_ms
+bool communication_wait_published(int msg_id, uint32_t timeout_ms);
+
+// Mensajes publicados que aún esperan su PUBACK
+size_t communication_outstanding_count(void);
+
+// Espera a que todos los mensajes publicados estén confirmados o venza el plazo; true si se vació.
+// Usar antes del deep sleep: se duerme en cuanto se confirma la entrega, nunca antes
+bool communication_wait_all_published(uint32_t timeout_ms);
+
+// Duración de la última espera de communication_wait_all_published()
+uint32_t communication_last_drain_ms(void);
+
+// Recoge la última petición de reenvío recibida en COMM_TOPIC_REPLAY (la consume);
+// true y since_us (timestamp desde el que reenviar, en µs) si había una.
+// La petición no debe publicarse como retenida: se repetiría el reenvío en cada reconexión
+bool communication_take_replay_request(uint64_t* since_us);
+
+// Publica un payload ya formateado en el topic indicado (QoS1)
+// Devuelve el msg_id de mqtt o -1 si no se pudo publicar
+int communication_publish(const char* topic, const char* payload);
+
+// Publica N muestras completas en un solo mensaje QoS1 sobre COMM_TOPIC_BATCH
+// Devuelve el msg_id de mqtt o -1 si no se pudo publicar
+int communication_publish_batch(const nivometro_data_t* samples, size_t count);
+
+// Igual que communication_publish_batch pero codificado con sample_codec v2 sobre COMM_TOPIC_BATCH_BIN
+// (~9 bytes por muestra frente a 17 en v1 y ~120 en json)
+int communication_publish_batch_binary(const nivometro_data_t* samples, size_t count);
 
 
 
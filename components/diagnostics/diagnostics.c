@@ -2,12 +2,132 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
-#include <inttypes.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "time_sync.h"
+#include <string.h>
+
+#define DIAG_MAGIC      0x47414944u     // "DIAG"
+#define DIAG_NVS_KEY    "log"           // Un único blob de tamaño fijo: el espacio en nvs está acotado
+
+// Estado completo: lo que se guarda en nvs es esta misma estructura
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                      // sizeof(diag_state_t): un cambio de formato invalida el blob
+    uint32_t head;                      // Registros escritos desde el primer arranque (posición = head % DIAG_LOG_EVENTS)
+    uint32_t flushed;                   // head en el último volcado (o el más antiguo aún en el anillo)
+    uint32_t subsystems;                // Entradas usadas de counters
+    diagnostics_stats_t stats;
+    diagnostics_counters_t counters[DIAG_SUBSYSTEMS_MAX];
+    diagnostics_record_t ring[DIAG_LOG_EVENTS];
+} diag_state_t;
 
 static const char *TAG = "diagnostics";                             // Etiqueta de logs para este módulo
 static nvs_handle_t diag_nvs_handle;                                // Handle nvs para diagnósticos
+static portMUX_TYPE diag_lock = portMUX_INITIALIZER_UNLOCKED;       // Sección crítica corta del camino de error
+static SemaphoreHandle_t flush_mutex;                               // Serializa los volcados (usan snapshot)
+static diag_state_t snapshot;                                       // Copia que se escribe en nvs fuera de la sección crítica
+
+// Sobrevive al deep sleep: entre despertares no hace falta volcar a flash
+static RTC_DATA_ATTR diag_state_t state;
+
+static void copy_text(char *dst, size_t size, const char *src) {
+    size_t n = 0;
+    if (src) {
+        while (n < size && src[n]) {
+            dst[n] = src[n];
+            n++;
+        }
+    }
+    if (n < size) memset(dst + n, 0, size - n);
+}
+
+// Índice del subsistema; los tags suelen ser literales así que basta comparar pocos bytes
+static uint8_t subsystem_index(const char *name) {
+    uint32_t i;
+    if (!name) name = "?";
+    for (i = 0; i < state.subsystems; i++) {
+        if (strncmp(state.counters[i].name, name, DIAG_NAME_LEN) == 0) return i;
+    }
+    if (state.subsystems < DIAG_SUBSYSTEMS_MAX - 1) {
+        i = state.subsystems++;
+        copy_text(state.counters[i].name, DIAG_NAME_LEN, name);
+        return i;
+    }
+    // Tabla llena: todo lo demás cuenta en la última entrada
+    i = DIAG_SUBSYSTEMS_MAX - 1;
+    if (state.subsystems < DIAG_SUBSYSTEMS_MAX) {
+        state.subsystems = DIAG_SUBSYSTEMS_MAX;
+        copy_text(state.counters[i].name, DIAG_NAME_LEN, "other");
+    }
+    return i;
+}
+
+// Añade un registro al anillo en ram; desaloja el más antiguo si está lleno
+static void append(const char *name, uint8_t kind, int32_t code, const char *text) {
+    uint32_t now_s = (uint32_t)(time_sync_now_us() / 1000000ULL);
 
-void diagnostics_init(void)
+    taskENTER_CRITICAL(&diag_lock);
+    uint8_t sub = subsystem_index(name);
+    diagnostics_counters_t *c = &state.counters[sub];
+    if (kind == DIAG_KIND_ERROR) {
+        c->errors++;
+        c->last_err = code;
+        state.stats.errors++;
+    } else {
+        c->events++;
+        state.stats.events++;
+    }
+    if (state.head - state.flushed >= DIAG_LOG_EVENTS) {
+        state.flushed++;
+        state.stats.evicted++;
+    }
+    diagnostics_record_t *r = &state.ring[state.head % DIAG_LOG_EVENTS];
+    r->time_s = now_s;
+    r->code = code;
+    r->seq = (uint16_t)state.head;
+    r->subsystem = sub;
+    r->kind = kind;
+    copy_text(r->text, DIAG_TEXT_LEN, text);
+    state.head++;
+    taskEXIT_CRITICAL(&diag_lock);
+}
+
+static void reset_state(void) {
+    memset(&state, 0, sizeof(state));
+    state.magic = DIAG_MAGIC;
+    state.size = sizeof(state);
+}
+
+// Tras un arranque en frío o un reinicio la ram rtc no vale: se recupera el anillo de nvs
+static void load_state(void) {
+    size_t len = sizeof(snapshot);
+    esp_err_t err = nvs_get_blob(diag_nvs_handle, DIAG_NVS_KEY, &snapshot, &len);
+    if (err == ESP_OK && len == sizeof(snapshot) && snapshot.magic == DIAG_MAGIC && snapshot.size == sizeof(snapshot)) {
+        state = snapshot;
+        ESP_LOGI(TAG, "Recovered %lu errors / %lu events, %lu records in flash",
+                 (unsigned long)state.stats.errors, (unsigned long)state.stats.events,
+                 (unsigned long)(state.head < DIAG_LOG_EVENTS ? state.head : DIAG_LOG_EVENTS));
+        return;
+    }
+    reset_state();
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+        // Formato anterior (err_cnt, last_err y una clave evt_N por evento) o blob inválido
+        uint32_t legacy = 0;
+        nvs_get_u32(diag_nvs_handle, "evt_cnt", &legacy);
+        ESP_LOGW(TAG, "Discarding old diagnostics namespace (%lu event keys)", (unsigned long)legacy);
+    }
+    nvs_erase_all(diag_nvs_handle);
+    nvs_commit(diag_nvs_handle);
+}
+
+static void on_shutdown(void) {
+    diagnostics_flush(true);
+}
+
+esp_err_t diagnostics_init(void)
 {
     // Inicializa la partición nvs y abre el namespace diag
     esp_err_t err = nvs_flash_init();
@@ -18,47 +138,111 @@ void diagnostics_init(void)
     }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "nvs_flash_init failed: %s", esp_err_to_name(err));
-        return;
+        return err;
     }
 
+    flush_mutex = xSemaphoreCreateMutex();
+    if (!flush_mutex) return ESP_ERR_NO_MEM;
+
      // Abre (o crea) el namespace diag en nvs para guardar errores/eventos
     err = nvs_open("diag", NVS_READWRITE, &diag_nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "nvs_open diag failed: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Diagnostics initialized");
+        return err;
     }
+
+    if (state.magic != DIAG_MAGIC || state.size != sizeof(state)) {
+        load_state();
+    }
+    // Un reinicio por software no conserva la ram rtc: volcar lo pendiente antes
+    esp_register_shutdown_handler(on_shutdown);
+    ESP_LOGI(TAG, "Diagnostics initialized (%lu records pending)", (unsigned long)(state.head - state.flushed));
+    return ESP_OK;
 }
 
 void diagnostics_log_error(const char *subsystem, esp_err_t err, const char *msg)
 {
-    // Registra el error en consola y, si nvs está abierto, aumenta el contador y guarda el mensaje
+    // Registra el error en consola y en el anillo de ram; el volcado a nvs va por lotes
     ESP_LOGE(subsystem, "Error %s: %s", msg, esp_err_to_name(err));
-    if (diag_nvs_handle) {
-        uint32_t cnt = 0;
-        nvs_get_u32(diag_nvs_handle, "err_cnt", &cnt);
-        cnt++;
-        nvs_set_u32(diag_nvs_handle, "err_cnt", cnt);
-        nvs_set_str(diag_nvs_handle, "last_err", msg);
-        nvs_commit(diag_nvs_handle);
-    }
+    append(subsystem, DIAG_KIND_ERROR, err, msg);
 }
 
 void diagnostics_record_event(const char *event_name, const char *details)
 {
-    // Registra el evento en consola y, si nvs está abierto, lo guarda incrementando el límite
+    // Registra el evento en consola y en el anillo de ram
     ESP_LOGI(TAG, "Event %s: %s", event_name, details ? details : "");
+    append(event_name, DIAG_KIND_EVENT, 0, details);
+}
+
+esp_err_t diagnostics_flush(bool force)
+{
+    if (!diag_nvs_handle || !flush_mutex) return ESP_ERR_INVALID_STATE;
+    if (xSemaphoreTake(flush_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return ESP_ERR_TIMEOUT;
 
-    if (diag_nvs_handle) {
-        uint32_t idx = 0;
-        nvs_get_u32(diag_nvs_handle, "evt_cnt", &idx);
+    // Decidir y copiar dentro de la sección crítica; escribir fuera
+    uint32_t now_s = (uint32_t)(time_sync_now_us() / 1000000ULL);
+    taskENTER_CRITICAL(&diag_lock);
+    uint32_t pending = state.head - state.flushed;
+    bool due = pending > 0 && (force || pending >= DIAG_FLUSH_BATCH ||
+               now_s - state.ring[state.flushed % DIAG_LOG_EVENTS].time_s >= DIAG_FLUSH_MAX_AGE_S);
+    if (due) {
+        state.stats.flushes++;
+        snapshot = state;
+        snapshot.flushed = snapshot.head;
+    }
+    taskEXIT_CRITICAL(&diag_lock);
 
-        char key[16];
-        snprintf(key, sizeof(key), "evt_%" PRIu32, idx);
+    esp_err_t err = ESP_OK;
+    if (due) {
+        err = nvs_set_blob(diag_nvs_handle, DIAG_NVS_KEY, &snapshot, sizeof(snapshot));
+        if (err == ESP_OK) err = nvs_commit(diag_nvs_handle);
+        taskENTER_CRITICAL(&diag_lock);
+        if (err == ESP_OK) {
+            // Lo añadido durante la escritura sigue pendiente
+            if ((int32_t)(snapshot.head - state.flushed) > 0) state.flushed = snapshot.head;
+        } else {
+            state.stats.flushes--;
+        }
+        taskEXIT_CRITICAL(&diag_lock);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Flush failed: %s", esp_err_to_name(err));
+        } else {
+            ESP_LOGD(TAG, "Flushed %lu records", (unsigned long)pending);
+        }
+    }
+    xSemaphoreGive(flush_mutex);
+    return err;
+}
 
-        nvs_set_str(diag_nvs_handle, key, event_name);
-        idx++;
-        nvs_set_u32(diag_nvs_handle, "evt_cnt", idx);
-        nvs_commit(diag_nvs_handle);
+void diagnostics_get_stats(diagnostics_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&diag_lock);
+    *out = state.stats;
+    out->pending = state.head - state.flushed;
+    taskEXIT_CRITICAL(&diag_lock);
+}
+
+size_t diagnostics_get_counters(diagnostics_counters_t *out, size_t max)
+{
+    size_t n;
+    if (!out) return 0;
+    taskENTER_CRITICAL(&diag_lock);
+    n = state.subsystems < max ? state.subsystems : max;
+    memcpy(out, state.counters, n * sizeof(*out));
+    taskEXIT_CRITICAL(&diag_lock);
+    return n;
+}
+
+size_t diagnostics_get_records(diagnostics_record_t *out, size_t max)
+{
+    size_t n = 0;
+    if (!out) return 0;
+    taskENTER_CRITICAL(&diag_lock);
+    uint32_t count = state.head < DIAG_LOG_EVENTS ? state.head : DIAG_LOG_EVENTS;
+    for (uint32_t i = state.head - count; i != state.head && n < max; i++) {
+        out[n++] = state.ring[i % DIAG_LOG_EVENTS];
     }
+    taskEXIT_CRITICAL(&diag_lock);
+    return n;
 }
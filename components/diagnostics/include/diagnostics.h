@@ -1,10 +1,57 @@
 #pragma once                   // Le indica al compilador que procese este fichero solo una vez por compilacion
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
-void diagnostics_init(void);                                                        // Inicializa el sistema de logging
+#define DIAG_LOG_EVENTS          32        // Registros del anillo (ram y flash); al llenarse se desaloja el más antiguo
+#define DIAG_SUBSYSTEMS_MAX      8         // Subsistemas con contadores propios; el último recoge el resto
+#define DIAG_NAME_LEN            12        // Nombre de subsistema guardado (truncado)
+#define DIAG_TEXT_LEN            16        // Mensaje guardado por registro (truncado, sin terminador si se llena)
+#define DIAG_FLUSH_BATCH         8         // Registros pendientes que fuerzan el volcado a flash
+#define DIAG_FLUSH_MAX_AGE_S     3600      // Antigüedad máxima de un registro pendiente antes de volcarlo
 
-void diagnostics_log_error(const char *tag, esp_err_t err, const char *msg);        // Registra un error con su codigo y descripcion
+typedef enum {
+    DIAG_KIND_ERROR = 1,
+    DIAG_KIND_EVENT = 2
+} diagnostics_kind_t;
 
-void diagnostics_record_event(const char *event_name, const char *details);         // Guarda un evento significativo con más detalles
+// Registro binario compacto del anillo (28 bytes)
+typedef struct {
+    uint32_t time_s;             // Hora del sistema en segundos (UTC si time_sync es válido)
+    int32_t code;                // esp_err_t del error, 0 en eventos
+    uint16_t seq;                // Secuencia: un salto indica registros desalojados
+    uint8_t subsystem;           // Índice en la tabla de subsistemas
+    uint8_t kind;                // diagnostics_kind_t
+    char text[DIAG_TEXT_LEN];    // Mensaje del error o detalle del evento
+} diagnostics_record_t;
 
+typedef struct {
+    char name[DIAG_NAME_LEN];    // Tag del error o nombre del evento
+    uint32_t errors;
+    uint32_t events;
+    int32_t last_err;            // Último esp_err_t registrado
+} diagnostics_counters_t;
+
+typedef struct {
+    uint32_t errors;             // Errores desde el primer arranque
+    uint32_t events;             // Eventos desde el primer arranque
+    uint32_t pending;            // Registros en ram aún no volcados a flash
+    uint32_t evicted;            // Registros desalojados antes de llegar a flash
+    uint32_t flushes;            // Volcados a flash (un commit de nvs cada uno)
+} diagnostics_stats_t;
+
+esp_err_t diagnostics_init(void);                                                   // Inicializa el sistema de logging y recupera el anillo
+
+void diagnostics_log_error(const char *tag, esp_err_t err, const char *msg);        // Registra un error con su codigo y descripcion (solo ram)
+
+void diagnostics_record_event(const char *event_name, const char *details);         // Guarda un evento significativo con más detalles (solo ram)
+
+esp_err_t diagnostics_flush(bool force);                                            // Vuelca el anillo a nvs si hay un lote o un registro antiguo pendiente (o siempre con force)
+
+void diagnostics_get_stats(diagnostics_stats_t *out);                               // Copia los contadores globales
+
+size_t diagnostics_get_counters(diagnostics_counters_t *out, size_t max);           // Copia los contadores por subsistema; devuelve cuántos
+
+size_t diagnostics_get_records(diagnostics_record_t *out, size_t max);              // Copia los registros del anillo, del más antiguo al más reciente
@@ -0,0 +1,148 @@
+// filters.c
+#include "filters.h"
+#include <string.h>
+
+// Limita el tamaño de ventana al rango admitido
+static uint8_t filter_clamp_window(uint8_t window) {
+    if (window == 0) {
+        return 1;
+    }
+    return window > FILTER_WINDOW_MAX ? FILTER_WINDOW_MAX : window;
+}
+
+void filter_moving_avg_init(filter_moving_avg_t *f, uint8_t window) {
+    if (f == NULL) {
+        return;
+    }
+    
+    memset(f, 0, sizeof(*f));
+    f->size = filter_clamp_window(window);
+}
+
+float filter_moving_avg_update(filter_moving_avg_t *f, float sample) {
+    if (f == NULL) {
+        return sample;
+    }
+    
+    // Restar la muestra saliente si la ventana está llena
+    if (f->count == f->size) {
+        f->sum -= f->window[f->pos];
+    } else {
+        f->count++;
+    }
+    f->window[f->pos] = sample;
+    f->sum += sample;
+    f->pos = (f->pos + 1) % f->size;
+    
+    return f->sum / f->count;
+}
+
+void filter_median_init(filter_median_t *f, uint8_t window) {
+    if (f == NULL) {
+        return;
+    }
+    
+    memset(f, 0, sizeof(*f));
+    f->size = filter_clamp_window(window);
+}
+
+float filter_median_update(filter_median_t *f, float sample) {
+    if (f == NULL) {
+        return sample;
+    }
+    
+    int n = f->count;
+    
+    // Quitar del vector ordenado la muestra que sale de la ventana
+    if (f->count == f->size) {
+        float old = f->window[f->pos];
+        int i = 0;
+        while (i < n - 1 && f->sorted[i] != old) {
+            i++;
+        }
+        memmove(&f->sorted[i], &f->sorted[i + 1], (n - 1 - i) * sizeof(float));
+        n--;
+    } else {
+        f->count++;
+    }
+    f->window[f->pos] = sample;
+    f->pos = (f->pos + 1) % f->size;
+    
+    // Insertar la nueva muestra manteniendo el orden
+    int j = n - 1;
+    while (j >= 0 && f->sorted[j] > sample) {
+        f->sorted[j + 1] = f->sorted[j];
+        j--;
+    }
+    f->sorted[j + 1] = sample;
+    n++;
+    
+    if (n % 2) {
+        return f->sorted[n / 2];
+    }
+    return (f->sorted[n / 2 - 1] + f->sorted[n / 2]) / 2.0f;
+}
+
+void filter_kalman_init(filter_kalman_t *f, float process_noise, float measurement_noise) {
+    if (f == NULL) {
+        return;
+    }
+    
+    f->x = 0;
+    f->p = measurement_noise;
+    f->q = process_noise;
+    f->r = measurement_noise;
+    f->initialized = false;
+}
+
+float filter_kalman_update(filter_kalman_t *f, float measurement) {
+    if (f == NULL) {
+        return measurement;
+    }
+    
+    // La primera medida fija el estado inicial
+    if (!f->initialized) {
+        f->x = measurement;
+        f->p = f->r;
+        f->initialized = true;
+        return f->x;
+    }
+    
+    // Predicción (valor constante) y corrección
+    f->p += f->q;
+    float k = f->p / (f->p + f->r);
+    f->x += k * (measurement - f->x);
+    f->p *= (1.0f - k);
+    
+    return f->x;
+}
+
+void filter_pipeline_init(filter_pipeline_t *f, uint8_t median_window,
+                          float process_noise, float measurement_noise) {
+    if (f == NULL) {
+        return;
+    }
+    
+    filter_median_init(&f->median, median_window);
+    filter_kalman_init(&f->kalman, process_noise, measurement_noise);
+    f->output = 0;
+    f->samples = 0;
+}
+
+float filter_pipeline_update(filter_pipeline_t *f, float sample) {
+    if (f == NULL) {
+        return sample;
+    }
+    
+    f->output = filter_kalman_update(&f->kalman, filter_median_update(&f->median, sample));
+    f->samples++;
+    return f->output;
+}
+
+void filter_pipeline_reset(filter_pipeline_t *f) {
+    if (f == NULL) {
+        return;
+    }
+    
+    filter_pipeline_init(f, f->median.size, f->kalman.q, f->kalman.r);
+}
@@ -0,0 +1,115 @@
+// filters.h
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FILTER_WINDOW_MAX 16  // Tamaño máximo de ventana (memoria fija, sin malloc)
+
+// Media móvil sobre ventana fija
+typedef struct {
+    float window[FILTER_WINDOW_MAX];  // Muestras en orden de llegada (circular)
+    uint8_t size;                     // Tamaño de ventana configurado
+    uint8_t count;                    // Muestras válidas en la ventana
+    uint8_t pos;                      // Próxima posición a sobrescribir
+    float sum;                        // Suma acumulada de la ventana
+} filter_moving_avg_t;
+
+// Mediana incremental sobre ventana fija
+typedef struct {
+    float window[FILTER_WINDOW_MAX];  // Muestras en orden de llegada (circular)
+    float sorted[FILTER_WINDOW_MAX];  // Mismas muestras ordenadas
+    uint8_t size;                     // Tamaño de ventana configurado
+    uint8_t count;                    // Muestras válidas en la ventana
+    uint8_t pos;                      // Próxima posición a sobrescribir
+} filter_median_t;
+
+// Filtro de Kalman 1-D (modelo de valor constante)
+typedef struct {
+    float x;                          // Estimación actual
+    float p;                          // Varianza de la estimación
+    float q;                          // Ruido de proceso por muestra
+    float r;                          // Ruido de medida
+    bool initialized;                 // false hasta recibir la primera muestra
+} filter_kalman_t;
+
+// Etapa completa: mediana (elimina picos) seguida de Kalman (suaviza)
+typedef struct {
+    filter_median_t median;
+    filter_kalman_t kalman;
+    float output;                     // Última salida del pipeline
+    uint32_t samples;                 // Muestras procesadas desde el último reset
+} filter_pipeline_t;
+
+/**
+ * @brief Inicializa la media móvil
+ * @param f Puntero al filtro
+ * @param window Tamaño de ventana (1..FILTER_WINDOW_MAX)
+ */
+void filter_moving_avg_init(filter_moving_avg_t *f, uint8_t window);
+
+/**
+ * @brief Añade una muestra a la media móvil (O(1))
+ * @param f Puntero al filtro
+ * @param sample Nueva muestra
+ * @return Media de la ventana actual
+ */
+float filter_moving_avg_update(filter_moving_avg_t *f, float sample);
+
+/**
+ * @brief Inicializa la mediana incremental
+ * @param f Puntero al filtro
+ * @param window Tamaño de ventana (1..FILTER_WINDOW_MAX)
+ */
+void filter_median_init(filter_median_t *f, uint8_t window);
+
+/**
+ * @brief Añade una muestra a la mediana (O(ventana), sin reordenar todo)
+ * @param f Puntero al filtro
+ * @param sample Nueva muestra
+ * @return Mediana de la ventana actual
+ */
+float filter_median_update(filter_median_t *f, float sample);
+
+/**
+ * @brief Inicializa el filtro de Kalman 1-D
+ * @param f Puntero al filtro
+ * @param process_noise Varianza del ruido de proceso (q)
+ * @param measurement_noise Varianza del ruido de medida (r)
+ */
+void filter_kalman_init(filter_kalman_t *f, float process_noise, float measurement_noise);
+
+/**
+ * @brief Corrige la estimación con una nueva medida
+ * @param f Puntero al filtro
+ * @param measurement Nueva medida
+ * @return Estimación filtrada
+ */
+float filter_kalman_update(filter_kalman_t *f, float measurement);
+
+/**
+ * @brief Inicializa el pipeline mediana + Kalman
+ * @param f Puntero al pipeline
+ * @param median_window Ventana de la mediana
+ * @param process_noise Ruido de proceso del Kalman
+ * @param measurement_noise Ruido de medida del Kalman
+ */
+void filter_pipeline_init(filter_pipeline_t *f, uint8_t median_window,
+                          float process_noise, float measurement_noise);
+
+/**
+ * @brief Procesa una muestra en el pipeline
+ * @param f Puntero al pipeline
+ * @param sample Nueva muestra
+ * @return Salida filtrada
+ */
+float filter_pipeline_update(filter_pipeline_t *f, float sample);
+
+/**
+ * @brief Vacía las ventanas y reinicia el Kalman (p.ej. tras una tara)
+ * @param f Puntero al pipeline
+ */
+void filter_pipeline_reset(filter_pipeline_t *f);
+
+#endif // FILTERS_H
@@ -0,0 +1,323 @@
+// flash_log.c
+#include "flash_log.h"
+#include <string.h>
+
+#define SECTOR_MAGIC        0x474c564eUL    // "NVLG"
+#define SECTOR_HEADER_SIZE  16              // magic, base, record_size, crc (ocupa el hueco 0 del sector)
+#define MARK_OFFSET         6
+#define MARK_CONSUMED       0x0000
+
+// Registro tal como se guarda en flash (little endian en el esp32 y en host x86/arm);
+// en flash solo ocupa record_size bytes
+typedef struct {
+    uint32_t seq;
+    uint16_t len;
+    uint16_t mark;
+    uint32_t crc;
+    uint8_t payload[FLASH_LOG_PAYLOAD_MAX];
+} flash_log_record_t;
+
+_Static_assert(sizeof(flash_log_record_t) == FLASH_LOG_RECORD_MAX, "flash_log_record_t debe ocupar el hueco más grande");
+
+typedef struct {
+    uint32_t magic;
+    uint32_t base;
+    uint16_t record_size;
+    uint16_t reserved;
+    uint32_t crc;
+} flash_log_sector_header_t;
+
+_Static_assert(sizeof(flash_log_sector_header_t) == SECTOR_HEADER_SIZE, "cabecera de sector");
+_Static_assert(SECTOR_HEADER_SIZE <= FLASH_LOG_RECORD_MIN, "la cabecera de sector debe caber en el hueco 0");
+
+// crc32 (polinomio 0xedb88320) con tabla de 16 entradas: sin 1 KB de tabla en ram
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(const flash_log_record_t *r) {
+    uint32_t crc = crc32_update(0, &r->seq, sizeof(r->seq));
+    crc = crc32_update(crc, &r->len, sizeof(r->len));
+    return crc32_update(crc, r->payload, r->len <= FLASH_LOG_PAYLOAD_MAX ? r->len : 0);
+}
+
+size_t flash_log_payload_max(const flash_log_t *log) {
+    return log && log->record_size ? log->record_size - FLASH_LOG_RECORD_HEADER : 0;
+}
+
+static uint32_t header_crc(const flash_log_sector_header_t *h) {
+    return crc32_update(0, h, offsetof(flash_log_sector_header_t, crc));
+}
+
+static uint32_t sector_of(const flash_log_t *log, uint32_t seq) {
+    return (seq / log->per_sector) % log->sectors;
+}
+
+static uint32_t record_offset(const flash_log_t *log, uint32_t seq) {
+    return sector_of(log, seq) * log->io.sector_size + (1 + seq % log->per_sector) * log->record_size;
+}
+
+static esp_err_t read_at(flash_log_t *log, uint32_t offset, void *buf, size_t len) {
+    return log->io.read(log->io.ctx, offset, buf, len);
+}
+
+// Cabecera válida y coherente con la posición del sector
+static bool read_header(flash_log_t *log, uint32_t sector, uint32_t *base) {
+    flash_log_sector_header_t h;
+    log->stats.mount_reads++;
+    if (read_at(log, sector * log->io.sector_size, &h, sizeof(h)) != ESP_OK) {
+        return false;
+    }
+    if (h.magic != SECTOR_MAGIC || h.crc != header_crc(&h) || h.record_size != log->record_size ||
+        h.base % log->per_sector != 0 || sector_of(log, h.base) != sector) {
+        return false;
+    }
+    *base = h.base;
+    return true;
+}
+
+// Hueco con algo escrito (registro completo o a medias)
+static bool slot_programmed(flash_log_t *log, uint32_t seq) {
+    uint8_t head[12];
+    log->stats.mount_reads++;
+    if (read_at(log, record_offset(log, seq), head, sizeof(head)) != ESP_OK) {
+        return true;                    // Ante la duda no se reutiliza
+    }
+    for (size_t i = 0; i < sizeof(head); i++) {
+        if (head[i] != 0xff) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool slot_consumed(flash_log_t *log, uint32_t seq) {
+    uint16_t mark = 0xffff;
+    log->stats.mount_reads++;
+    read_at(log, record_offset(log, seq) + MARK_OFFSET, &mark, sizeof(mark));
+    return mark != 0xffff;
+}
+
+esp_err_t flash_log_mount(flash_log_t *log, const flash_log_io_t *io, uint32_t record_size) {
+    if (log == NULL || io == NULL || io->read == NULL || io->write == NULL || io->erase == NULL ||
+        record_size < FLASH_LOG_RECORD_MIN || record_size > FLASH_LOG_RECORD_MAX ||
+        (record_size & (record_size - 1)) != 0 ||
+        io->sector_size < 2 * record_size || io->size / io->sector_size < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memset(log, 0, sizeof(*log));
+    log->io = *io;
+    log->sectors = io->size / io->sector_size;
+    log->record_size = record_size;
+    log->per_sector = io->sector_size / record_size - 1;
+    
+    // Sector de cabeza: el de mayor secuencia base con cabecera válida
+    uint32_t head_sector = 0, head_base = 0;
+    bool found = false;
+    for (uint32_t s = 0; s < log->sectors; s++) {
+        uint32_t base;
+        if (read_header(log, s, &base) && (!found || base > head_base)) {
+            head_sector = s;
+            head_base = base;
+            found = true;
+        }
+    }
+    if (!found) {
+        return ESP_OK;                  // Región vacía (o sin formato): se empieza en la secuencia 0
+    }
+    
+    // Registros escritos en el sector de cabeza: forman un prefijo (búsqueda binaria)
+    uint32_t lo = 0, hi = log->per_sector;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (slot_programmed(log, head_base + mid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    log->head = head_base + lo;
+    log->open_base = head_base;
+    log->has_open = true;
+    
+    // Hacia atrás, sectores llenos consecutivos: el último que encaja es el más antiguo
+    log->oldest = head_base;
+    for (uint32_t k = 1; k < log->sectors && log->oldest >= log->per_sector; k++) {
+        uint32_t expected = log->oldest - log->per_sector;
+        uint32_t base;
+        if (!read_header(log, (head_sector + log->sectors - k) % log->sectors, &base) || base != expected) {
+            break;
+        }
+        log->oldest = expected;
+    }
+    
+    // Los consumidos también forman un prefijo del rango [oldest, head)
+    lo = log->oldest;
+    hi = log->head;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (slot_consumed(log, mid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    log->first_pending = lo;
+    return ESP_OK;
+}
+
+esp_err_t flash_log_format(flash_log_t *log) {
+    if (log == NULL || log->sectors == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = log->io.erase(log->io.ctx, 0, log->io.size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->stats.erases += log->sectors;
+    log->head = log->oldest = log->first_pending = 0;
+    log->has_open = false;
+    return ESP_OK;
+}
+
+// Abre el sector de la secuencia head: lo borra (pierde el más antiguo) y escribe su cabecera
+static esp_err_t open_sector(flash_log_t *log) {
+    uint32_t ring = log->sectors * log->per_sector;
+    uint32_t new_oldest = log->head + log->per_sector > ring ? log->head + log->per_sector - ring : 0;
+    
+    if (new_oldest > log->oldest) {
+        if (log->first_pending < new_oldest) {
+            log->stats.dropped += new_oldest - log->first_pending;
+            log->first_pending = new_oldest;
+        }
+        log->oldest = new_oldest;
+    }
+    
+    uint32_t sector = sector_of(log, log->head);
+    esp_err_t err = log->io.erase(log->io.ctx, sector * log->io.sector_size, log->io.sector_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->stats.erases++;
+    
+    flash_log_sector_header_t h = {
+        .magic = SECTOR_MAGIC, .base = log->head,
+        .record_size = (uint16_t)log->record_size, .reserved = 0xffff,
+    };
+    h.crc = header_crc(&h);
+    err = log->io.write(log->io.ctx, sector * log->io.sector_size, &h, sizeof(h));
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->open_base = log->head;
+    log->has_open = true;
+    return ESP_OK;
+}
+
+esp_err_t flash_log_append(flash_log_t *log, const void *payload, size_t len, uint32_t *seq) {
+    if (log == NULL || log->sectors == 0 || (payload == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > flash_log_payload_max(log)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (log->head % log->per_sector == 0 && !(log->has_open && log->open_base == log->head)) {
+        esp_err_t err = open_sector(log);
+        if (err != ESP_OK) {
+            log->stats.write_errors++;
+            return err;
+        }
+    }
+    
+    flash_log_record_t r;
+    memset(&r, 0xff, sizeof(r));
+    r.seq = log->head;
+    r.len = (uint16_t)len;
+    memcpy(r.payload, payload, len);
+    r.crc = record_crc(&r);
+    
+    // Solo se programan los bytes útiles; el resto del hueco queda borrado
+    esp_err_t err = log->io.write(log->io.ctx, record_offset(log, log->head), &r,
+                                  offsetof(flash_log_record_t, payload) + len);
+    if (seq) {
+        *seq = log->head;
+    }
+    log->head++;                        // Aunque falle: el hueco puede haber quedado a medias
+    if (err != ESP_OK) {
+        log->stats.write_errors++;
+        return err;
+    }
+    log->stats.appended++;
+    return ESP_OK;
+}
+
+esp_err_t flash_log_read(flash_log_t *log, uint32_t seq, void *payload, size_t *len) {
+    flash_log_record_t r;
+    if (log == NULL || payload == NULL || len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (seq < log->oldest || seq >= log->head) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    esp_err_t err = read_at(log, record_offset(log, seq), &r, log->record_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (r.seq != seq || r.len > flash_log_payload_max(log) || r.crc != record_crc(&r)) {
+        log->stats.corrupt++;
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (r.len > *len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(payload, r.payload, r.len);
+    *len = r.len;
+    return ESP_OK;
+}
+
+esp_err_t flash_log_consume(flash_log_t *log, uint32_t end_seq) {
+    static const uint16_t consumed = MARK_CONSUMED;
+    esp_err_t first_err = ESP_OK;
+    if (log == NULL || log->sectors == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (end_seq > log->head) {
+        end_seq = log->head;
+    }
+    
+    // Se marcan también los dañados, para que el prefijo de consumidos no tenga huecos
+    for (uint32_t seq = log->first_pending; seq < end_seq; seq++) {
+        esp_err_t err = log->io.write(log->io.ctx, record_offset(log, seq) + MARK_OFFSET,
+                                      &consumed, sizeof(consumed));
+        if (err != ESP_OK && first_err == ESP_OK) {
+            first_err = err;
+        }
+    }
+    if (end_seq > log->first_pending) {
+        log->first_pending = end_seq;
+    }
+    return first_err;
+}
+
+uint32_t flash_log_pending(const flash_log_t *log) {
+    return log ? log->head - log->first_pending : 0;
+}
+
+uint32_t flash_log_capacity(const flash_log_t *log) {
+    return log ? (log->sectors - 1) * log->per_sector : 0;
+}
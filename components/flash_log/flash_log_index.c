@@ -0,0 +1,190 @@
+// flash_log_index.c
+#include "flash_log_index.h"
+#include <string.h>
+
+#define ENTRY_UNKNOWN   0           // Sin rellenar u obsoleta
+#define ENTRY_EMPTY     1           // Sector sin registros legibles
+#define ENTRY_VALID     2
+
+// Clave del registro seq; false si no se puede leer o no tiene clave
+static bool read_key(flash_log_index_t *idx, uint32_t seq, uint64_t *key) {
+    uint8_t payload[FLASH_LOG_PAYLOAD_MAX];
+    size_t len = sizeof(payload);
+    idx->reads++;
+    return flash_log_read(idx->log, seq, payload, &len) == ESP_OK && idx->key_fn(payload, len, key);
+}
+
+// Sector lógico k (secuencias [k * per_sector, (k + 1) * per_sector)) acotado a [oldest, head)
+static void sector_bounds(const flash_log_t *log, uint32_t k, uint32_t *lo, uint32_t *hi) {
+    uint32_t base = k * log->per_sector;
+    *lo = base > log->oldest ? base : log->oldest;
+    *hi = base + log->per_sector < log->head ? base + log->per_sector : log->head;
+}
+
+// Entrada del sector lógico k, rellenada desde flash si hace falta
+static const flash_log_index_entry_t *entry_for(flash_log_index_t *idx, uint32_t k) {
+    flash_log_t *log = idx->log;
+    flash_log_index_entry_t *e = &idx->entries[k % log->sectors];
+    uint32_t base = k * log->per_sector;
+    uint32_t lo, hi;
+
+    sector_bounds(log, k, &lo, &hi);
+    // Válida si es de este sector, no empieza antes de oldest y el último registro sigue en rango
+    if (e->state != ENTRY_UNKNOWN && e->base == base && (e->state == ENTRY_EMPTY || e->first_seq >= lo)) {
+        return e;
+    }
+
+    memset(e, 0, sizeof(*e));
+    e->base = base;
+    e->state = ENTRY_EMPTY;
+    for (uint32_t seq = lo; seq < hi; seq++) {
+        if (read_key(idx, seq, &e->first_key)) {
+            e->first_seq = seq;
+            e->state = ENTRY_VALID;
+            break;
+        }
+    }
+    if (e->state == ENTRY_VALID) {
+        for (uint32_t seq = hi; seq > e->first_seq; seq--) {
+            if (read_key(idx, seq - 1, &e->last_key)) {
+                e->last_seq = seq - 1;
+                return e;
+            }
+        }
+        e->last_seq = e->first_seq;
+        e->last_key = e->first_key;
+    }
+    return e;
+}
+
+esp_err_t flash_log_index_init(flash_log_index_t *idx, flash_log_t *log, flash_log_key_fn key_fn,
+                               flash_log_index_entry_t *entries, size_t n_entries) {
+    if (idx == NULL || log == NULL || key_fn == NULL || entries == NULL || n_entries < log->sectors) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(idx, 0, sizeof(*idx));
+    idx->log = log;
+    idx->key_fn = key_fn;
+    idx->entries = entries;
+    memset(entries, 0, log->sectors * sizeof(*entries));
+    return ESP_OK;
+}
+
+void flash_log_index_note(flash_log_index_t *idx, uint32_t seq, uint64_t key) {
+    if (idx == NULL || idx->log == NULL) return;
+    flash_log_t *log = idx->log;
+    uint32_t base = seq - seq % log->per_sector;
+    flash_log_index_entry_t *e = &idx->entries[(seq / log->per_sector) % log->sectors];
+
+    if (e->base == base && e->state == ENTRY_VALID) {
+        e->last_seq = seq;
+        e->last_key = key;
+    } else if (e->base != base || e->state == ENTRY_EMPTY) {
+        // Primer registro de un sector recién abierto, o primero legible de un sector vacío;
+        // si no, lo anterior es desconocido y la entrada se rellena al consultarla
+        bool first = e->base != base ? seq == base : true;
+        e->base = base;
+        e->state = first ? ENTRY_VALID : ENTRY_UNKNOWN;
+        e->first_seq = e->last_seq = seq;
+        e->first_key = e->last_key = key;
+    }
+}
+
+esp_err_t flash_log_index_seek(flash_log_index_t *idx, uint64_t key, uint32_t *seq) {
+    if (idx == NULL || idx->log == NULL || seq == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    flash_log_t *log = idx->log;
+    if (log->head == log->oldest) {
+        *seq = log->head;
+        return ESP_OK;
+    }
+
+    // Último sector con algo legible cuya primera clave es menor que key
+    uint32_t k_first = log->oldest / log->per_sector;
+    uint32_t lo = k_first, hi = (log->head - 1) / log->per_sector + 1;
+    uint32_t cand = UINT32_MAX;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t j = mid;
+        const flash_log_index_entry_t *e = NULL;
+        for (; j < hi; j++) {                   // Los sectores sin nada legible no ordenan
+            e = entry_for(idx, j);
+            if (e->state == ENTRY_VALID) break;
+        }
+        if (j == hi) {
+            hi = mid;
+        } else if (e->first_key < key) {
+            cand = j;
+            lo = j + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (cand == UINT32_MAX) {
+        *seq = log->oldest;
+        return ESP_OK;
+    }
+
+    const flash_log_index_entry_t *e = entry_for(idx, cand);
+    if (e->last_key < key) {
+        // Todo el sector queda antes: el resultado es lo que sigue a su último registro legible
+        *seq = e->last_seq + 1;
+        return ESP_OK;
+    }
+
+    // Primera clave >= key en (first_seq, last_seq], que existe porque last_key >= key
+    uint32_t a = e->first_seq + 1, b = e->last_seq;
+    while (a < b) {
+        uint32_t mid = a + (b - a) / 2;
+        uint32_t s = mid;
+        uint64_t k;
+        while (s < b && !read_key(idx, s, &k)) {
+            s++;
+        }
+        if (s == b) {
+            b = mid;                            // Solo queda el último, que sí cumple
+        } else if (k < key) {
+            a = s + 1;
+        } else {
+            b = mid;
+        }
+    }
+    *seq = a;
+    return ESP_OK;
+}
+
+esp_err_t flash_log_index_oldest_pending(flash_log_index_t *idx, uint32_t *seq, uint64_t *key) {
+    if (idx == NULL || idx->log == NULL || seq == NULL || key == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    flash_log_t *log = idx->log;
+    if (log->first_pending >= log->head) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Sector a sector desde first_pending (lo localiza el montaje): la entrada da el primer registro
+    // legible y su clave sin leer flash; solo se lee si first_pending cae a mitad de ese sector
+    uint32_t k_end = (log->head - 1) / log->per_sector + 1;
+    for (uint32_t k = log->first_pending / log->per_sector; k < k_end; k++) {
+        const flash_log_index_entry_t *e = entry_for(idx, k);
+        if (e->state != ENTRY_VALID || e->last_seq < log->first_pending) {
+            continue;                           // Nada legible sin consumir en este sector
+        }
+        if (e->first_seq >= log->first_pending) {
+            *seq = e->first_seq;
+            *key = e->first_key;
+            return ESP_OK;
+        }
+        for (uint32_t s = log->first_pending; s < e->last_seq; s++) {
+            if (read_key(idx, s, key)) {
+                *seq = s;
+                return ESP_OK;
+            }
+        }
+        *seq = e->last_seq;
+        *key = e->last_key;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,31 @@
+// flash_log_partition.c
+#include "flash_log.h"
+#include "esp_partition.h"
+
+static esp_err_t partition_read(void *ctx, uint32_t offset, void *buf, size_t len) {
+    return esp_partition_read(ctx, offset, buf, len);
+}
+
+static esp_err_t partition_write(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    return esp_partition_write(ctx, offset, buf, len);
+}
+
+static esp_err_t partition_erase(void *ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range(ctx, offset, len);
+}
+
+esp_err_t flash_log_partition_io(const char *label, flash_log_io_t *io) {
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL || io == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    io->read = partition_read;
+    io->write = partition_write;
+    io->erase = partition_erase;
+    io->ctx = (void *)part;
+    io->sector_size = part->erase_size;
+    io->size = part->size - part->size % part->erase_size;
+    return ESP_OK;
+}
@@ -0,0 +1,143 @@
+// flash_log.h
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/*
+ * Registro circular de solo escritura al final sobre una región de flash NOR
+ *
+ * Cada sector empieza con una cabecera (magic, secuencia base, tamaño de registro, crc)
+ * y le siguen registros de tamaño fijo, elegido al montar, que nunca cruzan un sector:
+ *   [0]  u32  seq       número de secuencia (fija la posición: sector y hueco)
+ *   [4]  u16  len       bytes útiles de payload
+ *   [6]  u16  mark      0xffff = pendiente, 0x0000 = consumido (fuera del crc)
+ *   [8]  u32  crc       crc32 de seq, len y payload
+ *   [12] payload        hasta record_size - FLASH_LOG_RECORD_HEADER bytes
+ *
+ * La flash solo se borra al abrir un sector nuevo, que sobrescribe el más antiguo.
+ * Marcar como consumido solo pasa bits de 1 a 0, así que no necesita borrado, y los
+ * consumidos forman un prefijo: el montaje los localiza por búsqueda binaria.
+ *
+ * Montaje: una lectura de cabecera por sector y búsquedas binarias en el sector de
+ * cabeza y en el rango pendiente. Un registro a medio escribir por un corte de
+ * alimentación se salta (falla su crc) y la escritura sigue en el hueco siguiente.
+ * Los sectores escritos con otro tamaño de registro se ignoran (se reutilizan como vacíos).
+ */
+
+#define FLASH_LOG_RECORD_HEADER 12
+#define FLASH_LOG_RECORD_MIN    16      // La cabecera de sector ocupa el hueco 0
+#define FLASH_LOG_RECORD_MAX    256
+#define FLASH_LOG_PAYLOAD_MAX   (FLASH_LOG_RECORD_MAX - FLASH_LOG_RECORD_HEADER)
+
+// Acceso al medio: esp_partition en el esp32, imagen en fichero en host (tools/host)
+typedef struct {
+    esp_err_t (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, uint32_t offset, const void *buf, size_t len);   // Solo pasa bits de 1 a 0
+    esp_err_t (*erase)(void *ctx, uint32_t offset, size_t len);                    // Alineado a sector, deja 0xff
+    void *ctx;
+    uint32_t size;               // Bytes de la región (múltiplo de sector_size)
+    uint32_t sector_size;
+} flash_log_io_t;
+
+// Contadores desde el montaje
+typedef struct {
+    uint32_t appended;           // Registros escritos
+    uint32_t erases;             // Sectores borrados
+    uint32_t corrupt;            // Lecturas con crc o secuencia incorrectos
+    uint32_t dropped;            // Registros pendientes sobrescritos por falta de espacio
+    uint32_t write_errors;       // Escrituras fallidas (el hueco se salta)
+    uint32_t mount_reads;        // Lecturas hechas en el último montaje
+} flash_log_stats_t;
+
+// Estado del registro
+typedef struct {
+    flash_log_io_t io;
+    uint32_t sectors;
+    uint32_t record_size;        // Bytes por hueco (potencia de 2)
+    uint32_t per_sector;         // Registros por sector (sin la cabecera)
+    uint32_t head;               // Secuencia del próximo registro
+    uint32_t oldest;             // Secuencia más antigua que sigue en flash
+    uint32_t first_pending;      // Secuencia pendiente (sin consumir) más antigua
+    uint32_t open_base;          // Secuencia base del sector abierto
+    bool has_open;               // Hay sector abierto con cabecera válida
+    flash_log_stats_t stats;
+} flash_log_t;
+
+/**
+ * @brief Monta el registro recorriendo las cabeceras de sector
+ * @param log Puntero al registro
+ * @param io Medio (se copia)
+ * @param record_size Bytes por registro: potencia de 2 entre FLASH_LOG_RECORD_MIN y FLASH_LOG_RECORD_MAX
+ * @return ESP_OK, ESP_ERR_INVALID_ARG si la geometría no es válida o el error de lectura
+ */
+esp_err_t flash_log_mount(flash_log_t *log, const flash_log_io_t *io, uint32_t record_size);
+
+/**
+ * @brief Borra toda la región y deja el registro vacío
+ * @param log Puntero a un registro montado
+ * @return ESP_OK o el error de borrado
+ */
+esp_err_t flash_log_format(flash_log_t *log);
+
+/**
+ * @brief Añade un registro al final
+ * @param log Puntero al registro
+ * @param payload Datos
+ * @param len Bytes (<= flash_log_payload_max(log))
+ * @param seq Secuencia asignada (puede ser NULL)
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE o el error de escritura (el hueco queda gastado)
+ */
+esp_err_t flash_log_append(flash_log_t *log, const void *payload, size_t len, uint32_t *seq);
+
+/**
+ * @brief Lee un registro por secuencia
+ * @param log Puntero al registro
+ * @param seq Secuencia
+ * @param payload Destino (flash_log_payload_max(log) bytes como máximo)
+ * @param len Entrada: capacidad de payload; salida: bytes leídos
+ * @return ESP_OK, ESP_ERR_NOT_FOUND si ya no está en flash, ESP_ERR_INVALID_CRC si está dañado
+ */
+esp_err_t flash_log_read(flash_log_t *log, uint32_t seq, void *payload, size_t *len);
+
+/**
+ * @brief Marca como consumidos todos los registros anteriores a end_seq
+ * @param log Puntero al registro
+ * @param end_seq Primera secuencia que sigue pendiente
+ * @return ESP_OK o el primer error de escritura
+ */
+esp_err_t flash_log_consume(flash_log_t *log, uint32_t end_seq);
+
+/**
+ * @brief Registros pendientes de consumir
+ * @param log Puntero al registro
+ * @return head - first_pending
+ */
+uint32_t flash_log_pending(const flash_log_t *log);
+
+/**
+ * @brief Payload máximo de un registro
+ * @param log Puntero al registro montado
+ * @return record_size - FLASH_LOG_RECORD_HEADER
+ */
+size_t flash_log_payload_max(const flash_log_t *log);
+
+/**
+ * @brief Registros que caben en la región (el sector que se abre no cuenta)
+ * @param log Puntero al registro
+ * @return Capacidad útil garantizada
+ */
+uint32_t flash_log_capacity(const flash_log_t *log);
+
+/**
+ * @brief Medio sobre una partición de datos (esp_partition)
+ * @param label Etiqueta de la partición en partitions.csv
+ * @param io Medio resultante
+ * @return ESP_OK o ESP_ERR_NOT_FOUND
+ */
+esp_err_t flash_log_partition_io(const char *label, flash_log_io_t *io);
+
+#endif // FLASH_LOG_H
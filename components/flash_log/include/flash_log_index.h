@@ -0,0 +1,91 @@
+// flash_log_index.h
+#ifndef FLASH_LOG_INDEX_H
+#define FLASH_LOG_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "flash_log.h"
+
+/*
+ * Índice disperso por clave sobre un flash_log
+ *
+ * La clave (p. ej. el timestamp de la primera muestra de un bloque) la extrae del payload
+ * una función del llamante y no debe decrecer con la secuencia: las búsquedas son binarias.
+ * Un timestamp de reloj de pared no lo garantiza (una corrección sntp hacia atrás, o el reloj
+ * de vuelta en 1970 tras un corte de alimentación); alrededor de un retroceso
+ * flash_log_index_seek devuelve un registro con clave >= key, no necesariamente el primero.
+ * flash_log_index_oldest_pending va por secuencia y no depende del orden. El índice guarda una
+ * entrada por sector en ram: secuencia base, primer y último registro legibles y sus
+ * claves. Se mantiene al añadir (flash_log_index_note) y las entradas que faltan tras
+ * el montaje o que quedaron obsoletas al reciclarse un sector se rellenan al consultarlas.
+ *
+ * Una búsqueda es binaria sobre los sectores (dos lecturas por sector no cacheado) y
+ * después binaria dentro del sector: O(log n) lecturas de flash en frío y unas pocas
+ * con el índice caliente. Los registros ilegibles se saltan.
+ */
+
+// Extrae la clave de un registro; false si el payload no la contiene
+typedef bool (*flash_log_key_fn)(const void *payload, size_t len, uint64_t *key);
+
+// Entrada por sector
+typedef struct {
+    uint32_t base;               // Secuencia base del sector indexado
+    uint32_t first_seq;          // Primer registro legible
+    uint32_t last_seq;           // Último registro legible conocido
+    uint8_t state;               // Sin rellenar, sin registros legibles o válida
+    uint64_t first_key;
+    uint64_t last_key;
+} flash_log_index_entry_t;
+
+// Estado del índice
+typedef struct {
+    flash_log_t *log;
+    flash_log_key_fn key_fn;
+    flash_log_index_entry_t *entries;    // log->sectors entradas (memoria del llamante)
+    uint32_t reads;              // Registros leídos por el índice desde el inicio
+} flash_log_index_t;
+
+/**
+ * @brief Prepara un índice vacío sobre un registro montado
+ * @param idx Índice
+ * @param log Registro montado (debe seguir vivo mientras se use el índice)
+ * @param key_fn Extracción de la clave
+ * @param entries Memoria para las entradas
+ * @param n_entries Número de entradas (al menos log->sectors)
+ * @return ESP_OK o ESP_ERR_INVALID_ARG
+ */
+esp_err_t flash_log_index_init(flash_log_index_t *idx, flash_log_t *log, flash_log_key_fn key_fn,
+                               flash_log_index_entry_t *entries, size_t n_entries);
+
+/**
+ * @brief Registra un registro recién añadido
+ * @param idx Índice
+ * @param seq Secuencia devuelta por flash_log_append
+ * @param key Clave del registro
+ */
+void flash_log_index_note(flash_log_index_t *idx, uint32_t seq, uint64_t key);
+
+/**
+ * @brief Primer registro con clave >= key
+ * @param idx Índice
+ * @param key Clave buscada
+ * @param seq Secuencia encontrada; log->head si todas las claves son menores
+ * @return ESP_OK o ESP_ERR_INVALID_ARG
+ */
+esp_err_t flash_log_index_seek(flash_log_index_t *idx, uint64_t key, uint32_t *seq);
+
+/**
+ * @brief Registro pendiente (sin consumir) más antiguo que se puede leer
+ * Parte del first_pending que el montaje localiza por búsqueda binaria y toma el primer registro
+ * legible de las entradas por sector: sin lecturas de flash con el índice caliente, salvo que
+ * first_pending caiga a mitad de un sector (consumo parcial), donde se lee desde ahí.
+ * @param idx Índice
+ * @param seq Su secuencia
+ * @param key Su clave
+ * @return ESP_OK o ESP_ERR_NOT_FOUND si no hay pendientes legibles
+ */
+esp_err_t flash_log_index_oldest_pending(flash_log_index_t *idx, uint32_t *seq, uint64_t *key);
+
+#endif // FLASH_LOG_INDEX_H
@@ -1,8 +1,58 @@
 // hcsr04p.c
 #include "hcsr04p.h"
+#include <math.h>
+#include "esp_attr.h"
+#include "esp_rom_sys.h"
+#include "soc/gpio_reg.h"
 
 #define HCSR04P_TIMEOUT_US 25000  // 25ms timeout
-#define SOUND_SPEED_CM_US 0.0343  // Velocidad del sonido en cm/us
+#define SOUND_SPEED_CM_US 0.0343  // Velocidad del sonido en cm/us a 20 °C
+
+#define HCSR04P_PING_INTERVAL_MS 60   // Intervalo mínimo entre pings para que se apaguen los ecos
+#define HCSR04P_MAD_SCALE 1.4826f     // Escala la MAD a desviación típica equivalente
+#define HCSR04P_OUTLIER_K 3.0f        // Umbral de rechazo en desviaciones equivalentes
+#define HCSR04P_MIN_SPREAD_CM 0.5f    // Dispersión mínima para no rechazar por ruido de cuantización
+
+// Timeout total del modo asíncrono: espera del flanco de subida + duración máxima del echo
+#define HCSR04P_ASYNC_TIMEOUT_MS ((2 * HCSR04P_TIMEOUT_US) / 1000)
+
+// Emite el pulso de trigger (10us)
+static void hcsr04p_trigger(const hcsr04p_sensor_t *sensor) {
+    gpio_set_level(sensor->trigger_pin, 0);
+    esp_rom_delay_us(2);
+    gpio_set_level(sensor->trigger_pin, 1);
+    esp_rom_delay_us(10);
+    gpio_set_level(sensor->trigger_pin, 0);
+}
+
+// ISR del pin echo: marca el instante de cada flanco y avisa al terminar el pulso.
+// Todo lo que toca está en IRAM (el nivel se lee del registro, no con gpio_get_level) y
+// no hay aritmética en coma flotante: la distancia se calcula en la tarea
+static void IRAM_ATTR hcsr04p_echo_isr(void *arg) {
+    hcsr04p_sensor_t *sensor = (hcsr04p_sensor_t *)arg;
+    int64_t now = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+
+    if (REG_READ(sensor->echo_in_reg) & sensor->echo_mask) {
+        // Un segundo echo tardío tras la bajada no debe mover la subida ya registrada
+        if (sensor->echo_fall_us == 0) {
+            sensor->echo_rise_us = now;
+        }
+        return;
+    }
+
+    // Flanco de bajada sin subida previa: residuo de un echo anterior
+    if (sensor->echo_rise_us == 0 || sensor->echo_fall_us != 0) {
+        return;
+    }
+    sensor->echo_fall_us = now;
+
+    if (sensor->callback != NULL) {
+        sensor->callback(sensor->echo_rise_us, now, sensor->callback_arg);
+    }
+    xSemaphoreGiveFromISR(sensor->echo_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
 
 bool hcsr04p_init(hcsr04p_sensor_t *sensor, int trigger_pin, int echo_pin) {
     if (sensor == NULL) {
@@ -13,6 +63,20 @@ bool hcsr04p_init(hcsr04p_sensor_t *sensor, int trigger_pin, int echo_pin) {
     sensor->echo_pin = echo_pin;
     sensor->distance_cm = 0.0f;
     sensor->calibration_factor = 1.0f;
+    sensor->sound_speed_cm_us = SOUND_SPEED_CM_US;
+    sensor->async_enabled = false;
+    sensor->echo_rise_us = 0;
+    sensor->echo_fall_us = 0;
+    sensor->echo_done = NULL;
+    sensor->callback = NULL;
+    sensor->callback_arg = NULL;
+    if (echo_pin < 32) {
+        sensor->echo_in_reg = GPIO_IN_REG;
+        sensor->echo_mask = 1UL << echo_pin;
+    } else {
+        sensor->echo_in_reg = GPIO_IN1_REG;
+        sensor->echo_mask = 1UL << (echo_pin - 32);
+    }
 
     // Configurar pines
     gpio_config_t io_conf = {};
@@ -44,15 +108,19 @@ float hcsr04p_read_distance(hcsr04p_sensor_t *sensor) {
         return -1;
     }
     
+    // Con la ISR instalada la tarea duerme durante el vuelo del pulso
+    if (sensor->async_enabled) {
+        if (!hcsr04p_start_measurement(sensor, NULL, NULL)) {
+            return -1;
+        }
+        return hcsr04p_wait_distance(sensor, HCSR04P_ASYNC_TIMEOUT_MS);
+    }
+    
     int64_t echo_start, echo_end;
     float distance;
     
     // Enviar pulso de trigger (10us)
-    gpio_set_level(sensor->trigger_pin, 0);
-    esp_rom_delay_us(2);
-    gpio_set_level(sensor->trigger_pin, 1);
-    esp_rom_delay_us(10);
-    gpio_set_level(sensor->trigger_pin, 0);
+    hcsr04p_trigger(sensor);
     
     // Esperar a que el pin echo se active (nivel alto)
     int64_t start_time = esp_timer_get_time();
@@ -72,9 +140,7 @@ float hcsr04p_read_distance(hcsr04p_sensor_t *sensor) {
     echo_end = esp_timer_get_time();
     
     // Calcular la distancia
-    float echo_duration = (echo_end - echo_start);
-    distance = (echo_duration * SOUND_SPEED_CM_US) / 2.0;
-    distance *= sensor->calibration_factor;
+    distance = hcsr04p_echo_to_distance(sensor, echo_start, echo_end);
     
     sensor->distance_cm = distance;
     return distance;
@@ -84,4 +150,186 @@ void hcsr04p_set_calibration(hcsr04p_sensor_t *sensor, float factor) {
     if (sensor != NULL && factor > 0) {
         sensor->calibration_factor = factor;
     }
-}
\ No newline at end of file
+}
+
+float hcsr04p_echo_to_distance(const hcsr04p_sensor_t *sensor, int64_t echo_start_us, int64_t echo_end_us) {
+    int64_t echo_duration = echo_end_us - echo_start_us;
+    if (sensor == NULL || echo_duration <= 0 || echo_duration > HCSR04P_TIMEOUT_US) {
+        return -1;
+    }
+    
+    float distance = ((float)echo_duration * sensor->sound_speed_cm_us) / 2.0f;
+    return distance * sensor->calibration_factor;
+}
+
+bool hcsr04p_enable_async(hcsr04p_sensor_t *sensor) {
+    if (sensor == NULL) {
+        return false;
+    }
+    if (sensor->async_enabled) {
+        return true;
+    }
+    
+    if (sensor->echo_done == NULL) {
+        sensor->echo_done = xSemaphoreCreateBinary();
+        if (sensor->echo_done == NULL) {
+            return false;
+        }
+    }
+    
+    // El servicio de ISR puede estar ya instalado por otro driver
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return false;
+    }
+    
+    gpio_set_intr_type(sensor->echo_pin, GPIO_INTR_ANYEDGE);
+    if (gpio_isr_handler_add(sensor->echo_pin, hcsr04p_echo_isr, sensor) != ESP_OK) {
+        gpio_set_intr_type(sensor->echo_pin, GPIO_INTR_DISABLE);
+        return false;
+    }
+    
+    sensor->async_enabled = true;
+    return true;
+}
+
+void hcsr04p_disable_async(hcsr04p_sensor_t *sensor) {
+    if (sensor == NULL || !sensor->async_enabled) {
+        return;
+    }
+    
+    gpio_isr_handler_remove(sensor->echo_pin);
+    gpio_set_intr_type(sensor->echo_pin, GPIO_INTR_DISABLE);
+    sensor->async_enabled = false;
+}
+
+bool hcsr04p_start_measurement(hcsr04p_sensor_t *sensor, hcsr04p_callback_t callback, void *arg) {
+    if (sensor == NULL || !sensor->async_enabled) {
+        return false;
+    }
+    
+    // Descartar cualquier aviso pendiente de una medida anterior
+    xSemaphoreTake(sensor->echo_done, 0);
+    sensor->callback = callback;
+    sensor->callback_arg = arg;
+    sensor->echo_rise_us = 0;
+    sensor->echo_fall_us = 0;
+    
+    hcsr04p_trigger(sensor);
+    return true;
+}
+
+float hcsr04p_wait_distance(hcsr04p_sensor_t *sensor, uint32_t timeout_ms) {
+    if (sensor == NULL || !sensor->async_enabled) {
+        return -1;
+    }
+    
+    // +1 tick para que un timeout corto no se redondee a 0 con tick de 10ms
+    if (xSemaphoreTake(sensor->echo_done, pdMS_TO_TICKS(timeout_ms) + 1) != pdTRUE) {
+        return -1; // Timeout - sensor posiblemente desconectado o sin echo
+    }
+    
+    float distance = hcsr04p_echo_to_distance(sensor, sensor->echo_rise_us, sensor->echo_fall_us);
+    if (distance >= 0) {
+        sensor->distance_cm = distance;
+    }
+    return distance;
+}
+
+float hcsr04p_sound_speed_cm_us(float temperature_c) {
+    // c = 331.3 + 0.606 * T (m/s), convertido a cm/us
+    return (331.3f + 0.606f * temperature_c) * 1e-4f;
+}
+
+void hcsr04p_set_temperature(hcsr04p_sensor_t *sensor, float temperature_c) {
+    if (sensor != NULL && temperature_c > -80.0f && temperature_c < 80.0f) {
+        sensor->sound_speed_cm_us = hcsr04p_sound_speed_cm_us(temperature_c);
+    }
+}
+
+// Ordena in situ un vector pequeño (inserción)
+static void hcsr04p_sort(float *values, int count) {
+    for (int i = 1; i < count; i++) {
+        float v = values[i];
+        int j = i - 1;
+        while (j >= 0 && values[j] > v) {
+            values[j + 1] = values[j];
+            j--;
+        }
+        values[j + 1] = v;
+    }
+}
+
+// Mediana de un vector ya ordenado
+static float hcsr04p_median_sorted(const float *values, int count) {
+    if (count % 2) {
+        return values[count / 2];
+    }
+    return (values[count / 2 - 1] + values[count / 2]) / 2.0f;
+}
+
+bool hcsr04p_read_burst(hcsr04p_sensor_t *sensor, uint8_t pings, hcsr04p_burst_result_t *result) {
+    if (sensor == NULL || result == NULL || pings == 0) {
+        return false;
+    }
+    if (pings > HCSR04P_BURST_MAX_PINGS) {
+        pings = HCSR04P_BURST_MAX_PINGS;
+    }
+    
+    float samples[HCSR04P_BURST_MAX_PINGS];
+    float deviations[HCSR04P_BURST_MAX_PINGS];
+    int valid = 0;
+    
+    result->distance_cm = -1;
+    result->confidence = 0;
+    result->spread_cm = 0;
+    result->valid_pings = 0;
+    result->total_pings = pings;
+    
+    // Disparar la ráfaga respetando el intervalo mínimo entre pings
+    for (int i = 0; i < pings; i++) {
+        if (i > 0) {
+            vTaskDelay(pdMS_TO_TICKS(HCSR04P_PING_INTERVAL_MS));
+        }
+        float d = hcsr04p_read_distance(sensor);
+        if (d >= 0) {
+            samples[valid++] = d;
+        }
+    }
+    if (valid == 0) {
+        return false;
+    }
+    
+    // Mediana y desviación absoluta mediana de los pings válidos
+    hcsr04p_sort(samples, valid);
+    float median = hcsr04p_median_sorted(samples, valid);
+    for (int i = 0; i < valid; i++) {
+        deviations[i] = fabsf(samples[i] - median);
+    }
+    hcsr04p_sort(deviations, valid);
+    float spread = HCSR04P_MAD_SCALE * hcsr04p_median_sorted(deviations, valid);
+    
+    // Rechazar ecos espurios (copos de nieve) lejos de la mediana
+    float limit = HCSR04P_OUTLIER_K * (spread > HCSR04P_MIN_SPREAD_CM ? spread : HCSR04P_MIN_SPREAD_CM);
+    int accepted = 0;
+    for (int i = 0; i < valid; i++) {
+        if (fabsf(samples[i] - median) <= limit) {
+            samples[accepted++] = samples[i];   // Sigue ordenado
+        }
+    }
+    
+    result->distance_cm = hcsr04p_median_sorted(samples, accepted);
+    result->spread_cm = spread;
+    result->valid_pings = accepted;
+    
+    // Confianza: fracción aceptada, penalizada si la dispersión supera el 1% de la distancia
+    float confidence = (float)accepted / (float)pings;
+    float relative_spread = result->distance_cm > 0 ? spread / result->distance_cm : 1.0f;
+    if (relative_spread > 0.01f) {
+        confidence /= (1.0f + 100.0f * (relative_spread - 0.01f));
+    }
+    result->confidence = confidence;
+    
+    sensor->distance_cm = result->distance_cm;
+    return true;
+}
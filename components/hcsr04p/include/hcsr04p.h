@@ -6,15 +6,49 @@
 #include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_system.h"
 
+#define HCSR04P_BURST_MAX_PINGS 15  // Máximo de pings por ráfaga
+
+/**
+ * @brief Callback de fin de medida asíncrona
+ * @param echo_start_us Marca de tiempo del flanco de subida (us)
+ * @param echo_end_us Marca de tiempo del flanco de bajada (us)
+ * @param arg Argumento de usuario registrado en hcsr04p_start_measurement()
+ * @note Se ejecuta en contexto de interrupción (ISR en IRAM): debe estar en IRAM, ser breve,
+ *       no usar la FPU y usar solo APIs *FromISR. La conversión a distancia se hace después en
+ *       una tarea con hcsr04p_echo_to_distance()
+ */
+typedef void (*hcsr04p_callback_t)(int64_t echo_start_us, int64_t echo_end_us, void *arg);
+
+// Resultado de una ráfaga de pings
+typedef struct {
+    float distance_cm;          // Mediana de los pings aceptados o -1 si no hay ninguno
+    float confidence;           // 0..1: fracción de pings aceptados penalizada por la dispersión
+    float spread_cm;            // Desviación absoluta mediana (MAD) escalada de los pings válidos
+    uint8_t valid_pings;        // Pings aceptados tras el filtro de outliers
+    uint8_t total_pings;        // Pings disparados
+} hcsr04p_burst_result_t;
+
 typedef struct {
     int trigger_pin;
     int echo_pin;
     float distance_cm;
     float calibration_factor;
+    float sound_speed_cm_us;    // Velocidad del sonido corregida por temperatura
+
+    // Modo asíncrono (flancos del echo capturados por interrupción)
+    bool async_enabled;                 // true si la ISR del pin echo está instalada
+    uint32_t echo_in_reg;               // Registro de entrada del pin echo (lectura segura en la ISR)
+    uint32_t echo_mask;                 // Máscara del pin echo en su registro
+    volatile int64_t echo_rise_us;      // Marca de tiempo del flanco de subida
+    volatile int64_t echo_fall_us;      // Marca de tiempo del flanco de bajada
+    SemaphoreHandle_t echo_done;        // Se libera desde la ISR al completar el echo
+    hcsr04p_callback_t callback;        // Callback opcional de fin de medida
+    void *callback_arg;                 // Argumento del callback
 } hcsr04p_sensor_t;
 
 /**
@@ -40,4 +74,67 @@ float hcsr04p_read_distance(hcsr04p_sensor_t *sensor);
  */
 void hcsr04p_set_calibration(hcsr04p_sensor_t *sensor, float factor);
 
+/**
+ * @brief Corrige la velocidad del sonido con la temperatura del aire
+ * @param sensor Puntero a la estructura del sensor
+ * @param temperature_c Temperatura del aire en grados Celsius
+ */
+void hcsr04p_set_temperature(hcsr04p_sensor_t *sensor, float temperature_c);
+
+/**
+ * @brief Calcula la velocidad del sonido en el aire
+ * @param temperature_c Temperatura del aire en grados Celsius
+ * @return Velocidad del sonido en cm/us
+ */
+float hcsr04p_sound_speed_cm_us(float temperature_c);
+
+/**
+ * @brief Dispara una ráfaga de pings y devuelve una lectura robusta
+ * @param sensor Puntero a la estructura del sensor
+ * @param pings Número de pings (1..HCSR04P_BURST_MAX_PINGS)
+ * @param result Resultado: mediana tras rechazo de outliers (mediana/MAD) y confianza
+ * @return true si al menos un ping fue aceptado
+ */
+bool hcsr04p_read_burst(hcsr04p_sensor_t *sensor, uint8_t pings, hcsr04p_burst_result_t *result);
+
+/**
+ * @brief Convierte la duración del echo en distancia aplicando la calibración
+ * @param sensor Puntero a la estructura del sensor
+ * @param echo_start_us Marca de tiempo del flanco de subida (us)
+ * @param echo_end_us Marca de tiempo del flanco de bajada (us)
+ * @return Distancia en centímetros o -1 si las marcas no son válidas
+ */
+float hcsr04p_echo_to_distance(const hcsr04p_sensor_t *sensor, int64_t echo_start_us, int64_t echo_end_us);
+
+/**
+ * @brief Activa el modo asíncrono: los flancos del echo se capturan por interrupción
+ * @param sensor Puntero a la estructura del sensor
+ * @return true si la ISR quedó instalada
+ * @note Una vez activo, hcsr04p_read_distance() duerme la tarea en lugar de hacer polling
+ */
+bool hcsr04p_enable_async(hcsr04p_sensor_t *sensor);
+
+/**
+ * @brief Desactiva el modo asíncrono y vuelve al polling
+ * @param sensor Puntero a la estructura del sensor
+ */
+void hcsr04p_disable_async(hcsr04p_sensor_t *sensor);
+
+/**
+ * @brief Lanza una medida sin bloquear (requiere modo asíncrono)
+ * @param sensor Puntero a la estructura del sensor
+ * @param callback Callback invocado desde la ISR al terminar (puede ser NULL)
+ * @param arg Argumento del callback
+ * @return true si el pulso de trigger se emitió
+ */
+bool hcsr04p_start_measurement(hcsr04p_sensor_t *sensor, hcsr04p_callback_t callback, void *arg);
+
+/**
+ * @brief Espera el resultado de una medida lanzada con hcsr04p_start_measurement()
+ * @param sensor Puntero a la estructura del sensor
+ * @param timeout_ms Tiempo máximo de espera
+ * @return Distancia en centímetros o -1 si hay timeout o error
+ */
+float hcsr04p_wait_distance(hcsr04p_sensor_t *sensor, uint32_t timeout_ms);
+
 #endif // HCSR04P_H
\ No newline at end of file
@@ -1,10 +1,80 @@
 // hx711.c
 #include "hx711.h"
 #include "freertos/portmacro.h" // Asegurarse de incluir esto para el mutex
+#include "soc/gpio_reg.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
  
 // Añadir mutex estático para secciones críticas
 static portMUX_TYPE hx711_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
+#define HX711_RING_MASK        (HX711_RING_SIZE - 1)
+#define HX711_READY_TIMEOUT_MS 200          // > 1 periodo de conversión a 10 SPS
+#define HX711_ACQ_TASK_STACK   2048
+#define HX711_ACQ_TASK_PRI     (configMAX_PRIORITIES - 2)
+#define HX711_HALF_PERIOD_DIV  4            // ticks/us / 4 = 0.25us por semiperiodo de SCK
+
+// ISR de DOUT: se deshabilita a sí misma (DOUT conmuta durante la lectura) y despierta a la tarea
+static void IRAM_ATTR hx711_drdy_isr(void *arg) {
+    hx711_sensor_t *sensor = (hx711_sensor_t *)arg;
+    BaseType_t woken = pdFALSE;
+    
+    gpio_intr_disable(sensor->dout_pin);
+    vTaskNotifyGiveFromISR(sensor->acq_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Tarea de adquisición: lee cada conversión en cuanto está lista y la encola
+static void hx711_acq_task(void *arg) {
+    hx711_sensor_t *sensor = (hx711_sensor_t *)arg;
+    
+    while (sensor->continuous) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!sensor->continuous) {
+            break;
+        }
+        
+        int32_t value;
+        if (hx711_read_raw(sensor, &value)) {
+            uint32_t head = sensor->ring_head;
+            if (head - sensor->ring_tail < HX711_RING_SIZE) {
+                sensor->ring[head & HX711_RING_MASK] = value;
+                sensor->ring_head = head + 1;   // Publicar tras escribir el dato
+            } else {
+                sensor->ring_dropped++;
+            }
+        }
+        
+        // Rearmar; si la siguiente conversión ya está lista no habrá flanco
+        gpio_intr_enable(sensor->dout_pin);
+        if (hx711_is_ready(sensor)) {
+            xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+        }
+    }
+    
+    sensor->acq_task = NULL;
+    vTaskDelete(NULL);
+}
+
+// Obtiene la siguiente conversión válida: del buffer si hay adquisición continua o leyendo directamente
+static bool hx711_next_raw(hx711_sensor_t *sensor, int32_t *value) {
+    if (sensor->continuous) {
+        TickType_t start = xTaskGetTickCount();
+        while (hx711_drain(sensor, value, 1) == 0) {
+            if (xTaskGetTickCount() - start > pdMS_TO_TICKS(HX711_READY_TIMEOUT_MS)) {
+                return false;
+            }
+            vTaskDelay(1);
+        }
+        return true;
+    }
+    
+    if (!hx711_wait_ready(sensor, HX711_READY_TIMEOUT_MS)) {
+        return false;
+    }
+    return hx711_read_raw(sensor, value);
+}
+
 bool hx711_init(hx711_sensor_t *sensor, int dout_pin, int sck_pin, hx711_gain_t gain) {
     if (sensor == NULL) {
         return false;
@@ -15,6 +85,31 @@ bool hx711_init(hx711_sensor_t *sensor, int dout_pin, int sck_pin, hx711_gain_t
     sensor->offset = 0;
     sensor->scale = 1.0f;
     sensor->gain = gain;
+    sensor->continuous = false;
+    sensor->acq_task = NULL;
+    sensor->ring_head = 0;
+    sensor->ring_tail = 0;
+    sensor->ring_dropped = 0;
+    
+    // Registros y máscaras para la ruta rápida de lectura
+    if (sck_pin < 32) {
+        sensor->sck_set_reg = GPIO_OUT_W1TS_REG;
+        sensor->sck_clr_reg = GPIO_OUT_W1TC_REG;
+        sensor->sck_mask = 1UL << sck_pin;
+    } else {
+        sensor->sck_set_reg = GPIO_OUT1_W1TS_REG;
+        sensor->sck_clr_reg = GPIO_OUT1_W1TC_REG;
+        sensor->sck_mask = 1UL << (sck_pin - 32);
+    }
+    if (dout_pin < 32) {
+        sensor->dout_in_reg = GPIO_IN_REG;
+        sensor->dout_mask = 1UL << dout_pin;
+    } else {
+        sensor->dout_in_reg = GPIO_IN1_REG;
+        sensor->dout_mask = 1UL << (dout_pin - 32);
+    }
+    // Semiperiodo de SCK de ~0.25us (mínimo del HX711: 0.2us)
+    sensor->half_period_cycles = esp_rom_get_cpu_ticks_per_us() / HX711_HALF_PERIOD_DIV;
     
     // Configurar pines
     gpio_config_t io_conf = {};
@@ -54,30 +149,24 @@ bool hx711_init(hx711_sensor_t *sensor, int dout_pin, int sck_pin, hx711_gain_t
     return (timeout < 100); // Retorna true si el sensor está listo
 }
 
-int32_t hx711_read_raw(hx711_sensor_t *sensor) {
-
-    if (sensor == NULL || gpio_get_level(sensor->dout_pin) == 1) {
-        return 0; // No hay datos disponibles
-    }
-    
-    int32_t value = 0;
+// Ruta original: pulsos con el driver gpio y esp_rom_delay_us(1) por flanco.
+// Se conserva como referencia para hx711_benchmark_read().
+static uint32_t hx711_shift_in_gpio(hx711_sensor_t *sensor) {
     uint8_t data[3] = {0};
-    // Eliminar la variable no utilizada
-    // uint8_t filler = 0x00;
     
     // Deshabilitar interrupciones durante la lectura
-    taskENTER_CRITICAL(&hx711_spinlock);  // Añadir mutex aquí
+    taskENTER_CRITICAL(&hx711_spinlock);
     
-    // Leer 24 bits
+    // Leer 24 bits (MSB primero)
     for (uint8_t i = 0; i < 24; i++) {
         gpio_set_level(sensor->sck_pin, 1);
         esp_rom_delay_us(1); // Pequeño delay
         
         // Actualizar datos
         if (i < 8) {
-            data[2] = data[2] << 1;
+            data[0] = data[0] << 1;
             if (gpio_get_level(sensor->dout_pin)) {
-                data[2] |= 1;
+                data[0] |= 1;
             }
         } else if (i < 16) {
             data[1] = data[1] << 1;
@@ -85,9 +174,9 @@ int32_t hx711_read_raw(hx711_sensor_t *sensor) {
                 data[1] |= 1;
             }
         } else {
-            data[0] = data[0] << 1;
+            data[2] = data[2] << 1;
             if (gpio_get_level(sensor->dout_pin)) {
-                data[0] |= 1;
+                data[2] |= 1;
             }
         }
         
@@ -104,26 +193,104 @@ int32_t hx711_read_raw(hx711_sensor_t *sensor) {
     }
     
     // Habilitar interrupciones nuevamente
-    taskEXIT_CRITICAL(&hx711_spinlock);  // Añadir mutex aquí
+    taskEXIT_CRITICAL(&hx711_spinlock);
     
-    // Combinar bytes en un valor de 32 bits
-    value = ((int32_t)data[0] << 16) | ((int32_t)data[1] << 8) | (int32_t)data[2];
+    return ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | (uint32_t)data[2];
+}
+
+// Espera activa corta medida en ciclos de CPU (semiperiodo de SCK)
+static inline void IRAM_ATTR hx711_delay_cycles(uint32_t cycles) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    while (esp_cpu_get_cycle_count() - start < cycles) {
+    }
+}
+
+// Ruta rápida: acceso directo a los registros W1TS/W1TC/IN con máscaras precalculadas
+static uint32_t IRAM_ATTR hx711_shift_in_fast(hx711_sensor_t *sensor) {
+    const uint32_t set_reg = sensor->sck_set_reg;
+    const uint32_t clr_reg = sensor->sck_clr_reg;
+    const uint32_t sck_mask = sensor->sck_mask;
+    const uint32_t in_reg = sensor->dout_in_reg;
+    const uint32_t dout_mask = sensor->dout_mask;
+    const uint32_t half = sensor->half_period_cycles;
+    const uint8_t pulses = 24 + sensor->gain;
+    uint32_t value = 0;
     
-    // Si es un número negativo (bit más significativo es 1)
-    if (data[0] & 0x80) {
-        value |= 0xFF000000; // Completar con 1s para mantener signo negativo
+    taskENTER_CRITICAL(&hx711_spinlock);
+    for (uint8_t i = 0; i < pulses; i++) {
+        REG_WRITE(set_reg, sck_mask);
+        hx711_delay_cycles(half);
+        if (i < 24) {
+            value = (value << 1) | ((REG_READ(in_reg) & dout_mask) ? 1 : 0);
+        }
+        REG_WRITE(clr_reg, sck_mask);
+        hx711_delay_cycles(half);
     }
+    taskEXIT_CRITICAL(&hx711_spinlock);
     
     return value;
 }
 
-float hx711_read_units(hx711_sensor_t *sensor) {
+// Extiende el signo del valor de 24 bits en complemento a 2
+static int32_t hx711_sign_extend(uint32_t raw24) {
+    if (raw24 & 0x800000) {
+        raw24 |= 0xFF000000; // Completar con 1s para mantener signo negativo
+    }
+    return (int32_t)raw24;
+}
+
+bool hx711_read_raw(hx711_sensor_t *sensor, int32_t *raw) {
+    if (sensor == NULL || raw == NULL || gpio_get_level(sensor->dout_pin) == 1) {
+        return false; // No hay datos disponibles: no es un valor 0
+    }
+    
+    *raw = hx711_sign_extend(hx711_shift_in_fast(sensor));
+    return true;
+}
+
+bool hx711_is_ready(hx711_sensor_t *sensor) {
+    return sensor != NULL && gpio_get_level(sensor->dout_pin) == 0;
+}
+
+bool hx711_wait_ready(hx711_sensor_t *sensor, uint32_t timeout_ms) {
+    if (sensor == NULL) {
+        return false;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    while (!hx711_is_ready(sensor)) {
+        if (esp_timer_get_time() - start > (int64_t)timeout_ms * 1000) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+float hx711_raw_to_units(const hx711_sensor_t *sensor, int32_t raw) {
     if (sensor == NULL) {
         return 0;
     }
+    return (float)(raw - sensor->offset) / sensor->scale;
+}
+
+bool hx711_read_units(hx711_sensor_t *sensor, float *units) {
+    if (sensor == NULL || units == NULL) {
+        return false;
+    }
     
-    int32_t raw_value = hx711_read_raw(sensor);
-    return (float)(raw_value - sensor->offset) / sensor->scale;
+    int32_t raw_value;
+    bool ok;
+    if (sensor->continuous) {
+        // No bloqueante: última conversión recibida por la tarea de adquisición
+        ok = hx711_get_latest(sensor, &raw_value);
+    } else {
+        ok = hx711_read_raw(sensor, &raw_value);
+    }
+    if (ok) {
+        *units = hx711_raw_to_units(sensor, raw_value);
+    }
+    return ok;
 }
 
 void hx711_calibrate(hx711_sensor_t *sensor, float known_weight, int readings) {
@@ -134,15 +301,22 @@ void hx711_calibrate(hx711_sensor_t *sensor, float known_weight, int readings) {
     // Primero, hacer tara
     hx711_tare(sensor, readings);
     
-    // Tomar múltiples lecturas con el peso conocido
+    // Tomar múltiples lecturas con el peso conocido (solo conversiones listas)
     int64_t sum = 0;
+    int count = 0;
+    int32_t value;
     for (int i = 0; i < readings; i++) {
-        sum += hx711_read_raw(sensor);
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        if (hx711_next_raw(sensor, &value)) {
+            sum += value;
+            count++;
+        }
+    }
+    if (count == 0 || known_weight == 0) {
+        return;
     }
     
     // Calcular escala
-    int32_t avg_reading = sum / readings;
+    int32_t avg_reading = sum / count;
     sensor->scale = (float)(avg_reading - sensor->offset) / known_weight;
 }
 
@@ -151,15 +325,22 @@ void hx711_tare(hx711_sensor_t *sensor, int readings) {
         return;
     }
     
-    // Tomar múltiples lecturas sin peso
+    // Tomar múltiples lecturas sin peso (solo conversiones listas)
     int64_t sum = 0;
+    int count = 0;
+    int32_t value;
     for (int i = 0; i < readings; i++) {
-        sum += hx711_read_raw(sensor);
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        if (hx711_next_raw(sensor, &value)) {
+            sum += value;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
     }
     
     // Establecer offset
-    sensor->offset = sum / readings;
+    sensor->offset = sum / count;
 }
 
 void hx711_set_gain(hx711_sensor_t *sensor, hx711_gain_t gain) {
@@ -167,7 +348,8 @@ void hx711_set_gain(hx711_sensor_t *sensor, hx711_gain_t gain) {
         sensor->gain = gain;
         
         // Descartar una lectura para aplicar la nueva ganancia
-        hx711_read_raw(sensor);
+        int32_t discard;
+        hx711_read_raw(sensor, &discard);
     }
 }
 
@@ -184,4 +366,138 @@ void hx711_power_up(hx711_sensor_t *sensor) {
     if (sensor != NULL) {
         gpio_set_level(sensor->sck_pin, 0);
     }
-}
\ No newline at end of file
+}
+
+bool hx711_start_continuous(hx711_sensor_t *sensor) {
+    if (sensor == NULL) {
+        return false;
+    }
+    if (sensor->continuous) {
+        return true;
+    }
+    
+    sensor->ring_head = 0;
+    sensor->ring_tail = 0;
+    sensor->ring_dropped = 0;
+    sensor->continuous = true;
+    
+    if (xTaskCreate(hx711_acq_task, "hx711_acq", HX711_ACQ_TASK_STACK, sensor,
+                    HX711_ACQ_TASK_PRI, &sensor->acq_task) != pdPASS) {
+        sensor->continuous = false;
+        return false;
+    }
+    
+    // El servicio de ISR puede estar ya instalado por otro driver
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        hx711_stop_continuous(sensor);
+        return false;
+    }
+    
+    gpio_set_intr_type(sensor->dout_pin, GPIO_INTR_NEGEDGE);
+    if (gpio_isr_handler_add(sensor->dout_pin, hx711_drdy_isr, sensor) != ESP_OK) {
+        hx711_stop_continuous(sensor);
+        return false;
+    }
+    gpio_intr_enable(sensor->dout_pin);
+    
+    // Si ya hay una conversión lista no llegará el flanco
+    if (hx711_is_ready(sensor)) {
+        xTaskNotifyGive(sensor->acq_task);
+    }
+    return true;
+}
+
+void hx711_stop_continuous(hx711_sensor_t *sensor) {
+    if (sensor == NULL || !sensor->continuous) {
+        return;
+    }
+    
+    gpio_isr_handler_remove(sensor->dout_pin);
+    gpio_set_intr_type(sensor->dout_pin, GPIO_INTR_DISABLE);
+    sensor->continuous = false;
+    
+    // Despertar a la tarea para que termine
+    if (sensor->acq_task != NULL) {
+        xTaskNotifyGive(sensor->acq_task);
+    }
+}
+
+bool hx711_get_latest(hx711_sensor_t *sensor, int32_t *raw) {
+    if (sensor == NULL || raw == NULL) {
+        return false;
+    }
+    
+    uint32_t head = sensor->ring_head;
+    if (head == 0) {
+        return false;
+    }
+    *raw = sensor->ring[(head - 1) & HX711_RING_MASK];
+    return true;
+}
+
+uint32_t hx711_available(hx711_sensor_t *sensor) {
+    if (sensor == NULL) {
+        return 0;
+    }
+    return sensor->ring_head - sensor->ring_tail;
+}
+
+uint32_t hx711_drain(hx711_sensor_t *sensor, int32_t *out, uint32_t max) {
+    if (sensor == NULL || out == NULL) {
+        return 0;
+    }
+    
+    uint32_t tail = sensor->ring_tail;
+    uint32_t count = sensor->ring_head - tail;
+    if (count > max) {
+        count = max;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = sensor->ring[(tail + i) & HX711_RING_MASK];
+    }
+    sensor->ring_tail = tail + count;   // Liberar los huecos tras copiar
+    return count;
+}
+
+bool hx711_benchmark_read(hx711_sensor_t *sensor, int iterations, hx711_bench_result_t *result) {
+    if (sensor == NULL || result == NULL || iterations <= 0 || sensor->continuous) {
+        return false;
+    }
+    
+    uint64_t gpio_total = 0, fast_total = 0;
+    uint32_t gpio_max = 0, fast_max = 0;
+    const uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+    
+    // Alternar rutas sobre conversiones reales para medir en igualdad de condiciones
+    for (int i = 0; i < iterations; i++) {
+        if (!hx711_wait_ready(sensor, HX711_READY_TIMEOUT_MS)) {
+            return false;
+        }
+        uint32_t start = esp_cpu_get_cycle_count();
+        hx711_shift_in_gpio(sensor);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        gpio_total += cycles;
+        if (cycles > gpio_max) {
+            gpio_max = cycles;
+        }
+        
+        if (!hx711_wait_ready(sensor, HX711_READY_TIMEOUT_MS)) {
+            return false;
+        }
+        start = esp_cpu_get_cycle_count();
+        hx711_shift_in_fast(sensor);
+        cycles = esp_cpu_get_cycle_count() - start;
+        fast_total += cycles;
+        if (cycles > fast_max) {
+            fast_max = cycles;
+        }
+    }
+    
+    result->iterations = iterations;
+    result->gpio_avg_us = (float)gpio_total / iterations / ticks_per_us;
+    result->gpio_max_us = (float)gpio_max / ticks_per_us;
+    result->fast_avg_us = (float)fast_total / iterations / ticks_per_us;
+    result->fast_max_us = (float)fast_max / ticks_per_us;
+    return true;
+}
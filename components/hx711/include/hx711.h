@@ -10,6 +10,8 @@
 #include "esp_timer.h"
 #include "esp_system.h"
 
+#define HX711_RING_SIZE 64   // Muestras raw en el buffer circular (potencia de 2)
+
 // Opciones de ganancia
 typedef enum {
     HX711_GAIN_128 = 1,  // Canal A, ganancia 128
@@ -17,12 +19,37 @@ typedef enum {
     HX711_GAIN_32 = 2    // Canal B, ganancia 32
 } hx711_gain_t;
 
+// Duración de la sección crítica de lectura (ruta driver gpio vs ruta por registros)
+typedef struct {
+    int iterations;          // Lecturas medidas por ruta
+    float gpio_avg_us;       // Media con gpio_set_level/gpio_get_level + esp_rom_delay_us
+    float gpio_max_us;       // Máximo con la ruta del driver gpio
+    float fast_avg_us;       // Media con acceso directo a registros
+    float fast_max_us;       // Máximo con acceso directo a registros
+} hx711_bench_result_t;
+
 typedef struct {
     int dout_pin;            // Pin de datos (DOUT)
     int sck_pin;             // Pin de reloj (SCK)
     int32_t offset;          // Offset de tara
     float scale;             // Factor de escala para convertir a unidades de peso
     hx711_gain_t gain;       // Configuración de ganancia
+
+    // Adquisición continua por interrupción de DOUT (data ready)
+    volatile bool continuous;              // true mientras la tarea de adquisición está activa
+    TaskHandle_t acq_task;                 // Tarea que vacía cada conversión al buffer
+    int32_t ring[HX711_RING_SIZE];         // Buffer circular lock-free (1 productor, 1 consumidor)
+    volatile uint32_t ring_head;           // Índice de escritura (solo lo avanza la tarea de adquisición)
+    volatile uint32_t ring_tail;           // Índice de lectura (solo lo avanza el consumidor)
+    volatile uint32_t ring_dropped;        // Conversiones perdidas por buffer lleno
+
+    // Ruta rápida de lectura (registros precalculados en hx711_init)
+    uint32_t sck_set_reg;                  // Registro W1TS del pin SCK
+    uint32_t sck_clr_reg;                  // Registro W1TC del pin SCK
+    uint32_t sck_mask;                     // Máscara del pin SCK en su registro
+    uint32_t dout_in_reg;                  // Registro de entrada del pin DOUT
+    uint32_t dout_mask;                    // Máscara del pin DOUT en su registro
+    uint32_t half_period_cycles;           // Ciclos de CPU por semiperiodo de SCK
 } hx711_sensor_t;
 
 /**
@@ -36,18 +63,43 @@ typedef struct {
 bool hx711_init(hx711_sensor_t *sensor, int dout_pin, int sck_pin, hx711_gain_t gain);
 
 /**
- * @brief Lee el valor raw del sensor
+ * @brief Lee el valor raw del sensor (no espera a que haya conversión)
+ * @param sensor Puntero a la estructura del sensor
+ * @param raw Valor raw de salida (solo se escribe si hay conversión)
+ * @return false si no hay una conversión lista (DOUT alto) o el sensor es NULL
+ */
+bool hx711_read_raw(hx711_sensor_t *sensor, int32_t *raw);
+
+/**
+ * @brief Indica si hay una conversión lista (DOUT a nivel bajo)
+ * @param sensor Puntero a la estructura del sensor
+ * @return true si se puede leer sin esperar
+ */
+bool hx711_is_ready(hx711_sensor_t *sensor);
+
+/**
+ * @brief Espera a que haya una conversión lista
+ * @param sensor Puntero a la estructura del sensor
+ * @param timeout_ms Tiempo máximo de espera
+ * @return true si el sensor quedó listo dentro del plazo
+ */
+bool hx711_wait_ready(hx711_sensor_t *sensor, uint32_t timeout_ms);
+
+/**
+ * @brief Convierte un valor raw a unidades de peso con la tara y escala actuales
  * @param sensor Puntero a la estructura del sensor
- * @return Valor raw del sensor o 0 si hay error
+ * @param raw Valor raw del sensor
+ * @return Valor en unidades de peso
  */
-int32_t hx711_read_raw(hx711_sensor_t *sensor);
+float hx711_raw_to_units(const hx711_sensor_t *sensor, int32_t raw);
 
 /**
- * @brief Lee el valor en unidades de peso
+ * @brief Lee el valor en unidades de peso (no bloqueante)
  * @param sensor Puntero a la estructura del sensor
- * @return Valor en unidades de peso o 0 si hay error
+ * @param units Valor en unidades de peso (solo se escribe si hay dato)
+ * @return false si no hay conversión nueva (modo directo) o ninguna recibida (modo continuo)
  */
-float hx711_read_units(hx711_sensor_t *sensor);
+bool hx711_read_units(hx711_sensor_t *sensor, float *units);
 
 /**
  * @brief Calibra el sensor
@@ -83,4 +135,52 @@ void hx711_power_down(hx711_sensor_t *sensor);
  */
 void hx711_power_up(hx711_sensor_t *sensor);
 
+/**
+ * @brief Arranca la adquisición continua: la interrupción de DOUT despierta una tarea
+ *        que lee cada conversión y la guarda en el buffer circular
+ * @param sensor Puntero a la estructura del sensor
+ * @return true si la interrupción y la tarea quedaron activas
+ * @note Mientras esté activa no se debe llamar a hx711_read_raw() desde otras tareas
+ */
+bool hx711_start_continuous(hx711_sensor_t *sensor);
+
+/**
+ * @brief Detiene la adquisición continua
+ * @param sensor Puntero a la estructura del sensor
+ */
+void hx711_stop_continuous(hx711_sensor_t *sensor);
+
+/**
+ * @brief Devuelve la última conversión recibida sin consumirla (no bloqueante)
+ * @param sensor Puntero a la estructura del sensor
+ * @param raw Valor raw de salida
+ * @return true si hay al menos una conversión
+ */
+bool hx711_get_latest(hx711_sensor_t *sensor, int32_t *raw);
+
+/**
+ * @brief Número de conversiones pendientes en el buffer circular
+ * @param sensor Puntero a la estructura del sensor
+ * @return Conversiones disponibles para hx711_drain()
+ */
+uint32_t hx711_available(hx711_sensor_t *sensor);
+
+/**
+ * @brief Extrae hasta max conversiones del buffer, de la más antigua a la más nueva (no bloqueante)
+ * @param sensor Puntero a la estructura del sensor
+ * @param out Vector de salida
+ * @param max Capacidad del vector de salida
+ * @return Número de conversiones copiadas
+ */
+uint32_t hx711_drain(hx711_sensor_t *sensor, int32_t *out, uint32_t max);
+
+/**
+ * @brief Microbenchmark: mide cuánto dura la sección crítica de lectura en ambas rutas
+ * @param sensor Puntero a la estructura del sensor (sin adquisición continua activa)
+ * @param iterations Lecturas por ruta
+ * @param result Tiempos medio y máximo de cada ruta en microsegundos
+ * @return true si se completaron todas las lecturas
+ */
+bool hx711_benchmark_read(hx711_sensor_t *sensor, int iterations, hx711_bench_result_t *result);
+
 #endif // HX711_H
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "hcsr04p.h"
+#include "hx711.h"
+#include "vl53l0x.h"
+#include "filters.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Identificadores de sensor (mismo bit que en sensor_status)
+#define NIVOMETRO_SENSOR_ULTRASONIC  0x01    // HC-SR04P
+#define NIVOMETRO_SENSOR_SCALE       0x02    // HX711
+#define NIVOMETRO_SENSOR_LASER       0x04    // VL53L0X
+#define NIVOMETRO_SENSOR_ALL         0x07
+
+#define NIVOMETRO_NOMINAL_TEMP_C     20.0f   // Temperatura supuesta sin medida del aire (velocidad del sonido de fábrica)
+#define NIVOMETRO_TEMP_UNKNOWN       INT8_MIN  // temperature_c sin medida del aire: no se publica
+
+// Estructura de datos unificada del nivómetro
+typedef struct {
+    // Datos de sensores
+    float ultrasonic_distance_cm;    // HC-SR04P
+    float ultrasonic_confidence;     // Confianza 0..1 de la ráfaga de pings
+    float laser_distance_mm;         // VL53L0X  
+    float weight_grams;              // HX711
+    
+    // Metadatos
+    uint64_t timestamp_us;           // UTC; antes de sincronizar, desde 1970 (ver time_sync_correct_us())
+    uint8_t sensor_status;           // Bits: [2]=VL53L0X, [1]=HX711, [0]=HC-SR04P
+    float battery_voltage;
+    int8_t temperature_c;            // Temperatura del aire (NIVOMETRO_TEMP_UNKNOWN si no hay medida)
+    uint16_t acquisition_ms;         // Duración de la lectura de los sensores muestreados
+    uint8_t sampled_mask;            // Sensores leídos en este registro (el resto repite el último valor)
+} nivometro_data_t;
+
+// Configuración del nivómetro
+typedef struct {
+    // Pines HC-SR04P
+    int hcsr04p_trigger_pin;
+    int hcsr04p_echo_pin;
+    float hcsr04p_cal_factor;
+    uint8_t hcsr04p_burst_pings;     // Pings por lectura (0 o 1 = ping único)
+    
+    // Pines HX711
+    int hx711_dout_pin;
+    int hx711_sck_pin;
+    hx711_gain_t hx711_gain;
+    float hx711_known_weight;
+    
+    // I2C VL53L0X
+    i2c_port_t vl53l0x_i2c_port;
+    uint8_t vl53l0x_address;
+    vl53l0x_accuracy_t vl53l0x_accuracy;
+    float vl53l0x_cal_factor;
+    int vl53l0x_gpio1_pin;           // Interrupción data-ready (-1 = polling en modo único)
+    
+    // Adquisición
+    bool concurrent_acquisition;     // Solapar láser con ultrasonido y balanza
+} nivometro_config_t;
+
+// Estructura principal del nivómetro
+typedef struct {
+    hcsr04p_sensor_t ultrasonic;
+    hx711_sensor_t scale;
+    filter_pipeline_t weight_filter;     // Mediana + Kalman sobre cada conversión del HX711
+    vl53l0x_sensor_t laser;
+    nivometro_config_t config;
+    nivometro_data_t last;               // Último registro (base para lecturas parciales)
+    float air_temperature_c;             // Última temperatura del aire recibida
+    bool air_temperature_valid;          // Sin medida no hay compensación de la velocidad del sonido
+    bool initialized;
+} nivometro_t;
+
+// Funciones principales
+esp_err_t nivometro_init(nivometro_t *nivometro, const nivometro_config_t *config);
+esp_err_t nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *data);
+esp_err_t nivometro_read_sensors(nivometro_t *nivometro, uint8_t mask, nivometro_data_t *data);
+void nivometro_power_up_sensors(nivometro_t *nivometro, uint8_t mask);
+void nivometro_power_down_sensors(nivometro_t *nivometro, uint8_t mask);
+esp_err_t nivometro_calibrate_all(nivometro_t *nivometro);
+esp_err_t nivometro_calibrate_scale(nivometro_t *nivometro, float known_weight_g);
+esp_err_t nivometro_tare_scale(nivometro_t *nivometro);
+void nivometro_set_air_temperature(nivometro_t *nivometro, float temperature_c);   // Fuente externa de temperatura para el HC-SR04P
+void nivometro_power_down(nivometro_t *nivometro);
+void nivometro_power_up(nivometro_t *nivometro);
+
+// Funciones de utilidad
+const char* nivometro_get_sensor_status_string(uint8_t status);
+bool nivometro_is_sensor_working(uint8_t status, int sensor_index);
\ No newline at end of file
@@ -1,15 +1,54 @@
 #include "nivometro_sensors.h"
 #include "esp_timer.h"
+#include "time_sync.h"
+#include <math.h>
+#include <string.h>
 
 static const char *TAG = "NIVOMETRO";
 
+// Filtro de peso: ventana de mediana y ruidos del Kalman (gramos^2)
+#define WEIGHT_MEDIAN_WINDOW     5
+#define WEIGHT_PROCESS_NOISE     0.05f
+#define WEIGHT_MEASUREMENT_NOISE 4.0f
+#define WEIGHT_DRAIN_CHUNK       16
+#define WEIGHT_READY_TIMEOUT_MS  120         // Sin adquisición continua: > 1 conversión a 10 SPS
+
+// Pasa por el filtro todas las conversiones nuevas del HX711, una a una
+static bool nivometro_update_weight(nivometro_t *nivometro) {
+    hx711_sensor_t *scale = &nivometro->scale;
+    bool updated = false;
+    
+    if (scale->continuous) {
+        int32_t raw[WEIGHT_DRAIN_CHUNK];
+        uint32_t n;
+        while ((n = hx711_drain(scale, raw, WEIGHT_DRAIN_CHUNK)) > 0) {
+            for (uint32_t i = 0; i < n; i++) {
+                filter_pipeline_update(&nivometro->weight_filter, hx711_raw_to_units(scale, raw[i]));
+            }
+            updated = true;
+        }
+    } else {
+        // Sin interrupción: esperar a la conversión en curso para no dar por caído un HX711 sano
+        float units;
+        if (hx711_wait_ready(scale, WEIGHT_READY_TIMEOUT_MS) && hx711_read_units(scale, &units)) {
+            filter_pipeline_update(&nivometro->weight_filter, units);
+            updated = true;
+        }
+    }
+    
+    return updated;
+}
+
 esp_err_t nivometro_init(nivometro_t *nivometro, const nivometro_config_t *config) {
     if (!nivometro || !config) {
         return ESP_ERR_INVALID_ARG;
     }
     
     memcpy(&nivometro->config, config, sizeof(nivometro_config_t));
+    memset(&nivometro->last, 0, sizeof(nivometro->last));
     nivometro->initialized = false;
+    nivometro->air_temperature_c = NIVOMETRO_NOMINAL_TEMP_C;
+    nivometro->air_temperature_valid = false;
     
     ESP_LOGI(TAG, "Inicializando sensores del nivómetro...");
     
@@ -21,6 +60,10 @@ esp_err_t nivometro_init(nivometro_t *nivometro, const nivometro_config_t *confi
         return ESP_FAIL;
     }
     hcsr04p_set_calibration(&nivometro->ultrasonic, config->hcsr04p_cal_factor);
+    // Captura del echo por interrupción; si falla se mantiene el polling
+    if (!hcsr04p_enable_async(&nivometro->ultrasonic)) {
+        ESP_LOGW(TAG, "HC-SR04P sin ISR de echo, usando polling");
+    }
     ESP_LOGI(TAG, "✅ HC-SR04P inicializado");
     
     // Inicializar HX711
@@ -31,63 +74,175 @@ esp_err_t nivometro_init(nivometro_t *nivometro, const nivometro_config_t *confi
         ESP_LOGE(TAG, "Error inicializando HX711");
         return ESP_FAIL;
     }
+    // Adquisición continua por DRDY; si falla se lee bajo demanda
+    if (!hx711_start_continuous(&nivometro->scale)) {
+        ESP_LOGW(TAG, "HX711 sin interrupción DRDY, usando lectura directa");
+    }
+    filter_pipeline_init(&nivometro->weight_filter, WEIGHT_MEDIAN_WINDOW,
+                         WEIGHT_PROCESS_NOISE, WEIGHT_MEASUREMENT_NOISE);
     ESP_LOGI(TAG, "✅ HX711 inicializado");
     
     // Inicializar VL53L0X
-    if (!vl53l0x_init(&nivometro->laser,
-                      config->vl53l0x_i2c_port,
-                      config->vl53l0x_address)) {
+    if (!vl53l0x_init_with_accuracy(&nivometro->laser,
+                                    config->vl53l0x_i2c_port,
+                                    config->vl53l0x_address,
+                                    config->vl53l0x_accuracy)) {
         ESP_LOGE(TAG, "Error inicializando VL53L0X");
         return ESP_FAIL;
     }
-    vl53l0x_set_accuracy(&nivometro->laser, config->vl53l0x_accuracy);
     vl53l0x_set_calibration(&nivometro->laser, config->vl53l0x_cal_factor);
+    // Con GPIO1 cableado: medición continua y lectura despertada por interrupción
+    if (config->vl53l0x_gpio1_pin >= 0) {
+        if (vl53l0x_enable_interrupt(&nivometro->laser, config->vl53l0x_gpio1_pin) &&
+            vl53l0x_set_mode(&nivometro->laser, VL53L0X_MODE_CONTINUOUS)) {
+            ESP_LOGI(TAG, "VL53L0X en modo continuo con interrupción GPIO1");
+        } else {
+            ESP_LOGW(TAG, "VL53L0X sin interrupción GPIO1, usando modo único");
+        }
+    }
     ESP_LOGI(TAG, "✅ VL53L0X inicializado");
     
     nivometro->initialized = true;
     ESP_LOGI(TAG, "🎉 Nivómetro completamente inicializado");
+    // La placa no tiene sensor de temperatura del aire: hasta que alguien llame a
+    // nivometro_set_air_temperature() el HC-SR04P usa la velocidad del sonido a 20 °C
+    ESP_LOGW(TAG, "Sin temperatura del aire: compensación de la velocidad del sonido inactiva (%.0f °C nominal)",
+             NIVOMETRO_NOMINAL_TEMP_C);
     
     return ESP_OK;
 }
 
-esp_err_t nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *data) {
-    if (!nivometro || !data || !nivometro->initialized) {
-        return ESP_ERR_INVALID_ARG;
+// Lee el HC-SR04P (ráfaga con velocidad del sonido corregida por temperatura si hay medida del aire)
+static void nivometro_read_ultrasonic(nivometro_t *nivometro, nivometro_data_t *data) {
+    hcsr04p_set_temperature(&nivometro->ultrasonic, nivometro->air_temperature_c);
+    if (nivometro->config.hcsr04p_burst_pings > 1) {
+        hcsr04p_burst_result_t burst;
+        hcsr04p_read_burst(&nivometro->ultrasonic, nivometro->config.hcsr04p_burst_pings, &burst);
+        data->ultrasonic_distance_cm = burst.distance_cm;
+        data->ultrasonic_confidence = burst.confidence;
+    } else {
+        data->ultrasonic_distance_cm = hcsr04p_read_distance(&nivometro->ultrasonic);
+        data->ultrasonic_confidence = data->ultrasonic_distance_cm >= 0 ? 1.0f : 0.0f;
     }
-    
-    // Timestamp
-    data->timestamp_us = esp_timer_get_time();
-    data->sensor_status = 0;
-    
-    // Leer HC-SR04P
-    data->ultrasonic_distance_cm = hcsr04p_read_distance(&nivometro->ultrasonic);
     if (data->ultrasonic_distance_cm >= 0) {
         data->sensor_status |= 0x01; // Bit 0 = HC-SR04P OK
     }
-    
-    // Leer HX711
-    data->weight_grams = hx711_read_units(&nivometro->scale);
-    if (data->weight_grams != 0 || data->weight_grams > -1000) { // Verificación básica
+}
+
+// Lee el HX711 (salida del filtro, alimentado con cada conversión disponible).
+// Solo está OK si esta lectura trajo conversiones nuevas: con el HX711 desconectado el filtro
+// conserva su última salida, pero no debe seguir dándose por buena
+static void nivometro_read_weight(nivometro_t *nivometro, nivometro_data_t *data) {
+    bool updated = nivometro_update_weight(nivometro);
+    data->weight_grams = nivometro->weight_filter.output;
+    if (updated) {
         data->sensor_status |= 0x02; // Bit 1 = HX711 OK
     }
-    
-    // Leer VL53L0X
-    uint16_t laser_mm = vl53l0x_read_distance(&nivometro->laser);
+}
+
+// Guarda la distancia del VL53L0X
+static void nivometro_store_laser(nivometro_data_t *data, uint16_t laser_mm) {
     data->laser_distance_mm = (float)laser_mm;
     if (laser_mm > 0 && laser_mm < 8000) { // Rango válido del VL53L0X
         data->sensor_status |= 0x04; // Bit 2 = VL53L0X OK
     }
+}
+
+// Adquisición solapada: el láser integra mientras se leen el ultrasonido y la balanza, y la
+// lectura de su resultado se encola (backend i2c_master) para que el bus trabaje en paralelo
+static void nivometro_read_concurrent(nivometro_t *nivometro, uint8_t mask, nivometro_data_t *data) {
+    vl53l0x_sensor_t *laser = &nivometro->laser;
+    bool laser_started = false;
+    bool laser_queued = false;
+    int64_t laser_deadline_us = 0;
+    
+    // 1) Lanzar el láser primero: es la medida más larga (30-200 ms)
+    if (mask & NIVOMETRO_SENSOR_LASER) {
+        laser_deadline_us = esp_timer_get_time() +
+                            (int64_t)vl53l0x_measurement_deadline_ms(laser) * 1000;
+        laser_started = vl53l0x_start_ranging(laser);
+    }
+    
+    // 2) Mientras integra: ping(s) de ultrasonido
+    if (mask & NIVOMETRO_SENSOR_ULTRASONIC) {
+        nivometro_read_ultrasonic(nivometro, data);
+    }
+    
+    // 3) Si el láser ya terminó, encolar la lectura de su resultado antes de la balanza
+    if (laser_started) {
+        laser_queued = vl53l0x_wait_data_ready(laser, 0) && vl53l0x_read_range_async(laser, NULL, NULL);
+    }
+    if (mask & NIVOMETRO_SENSOR_SCALE) {
+        nivometro_read_weight(nivometro, data);
+    }
+    
+    // 4) Si no, esperar la medida con el tiempo que quede de su plazo; después recoger la lectura
+    if (mask & NIVOMETRO_SENSOR_LASER) {
+        uint16_t range_mm = 0;
+        if (laser_started && !laser_queued) {
+            int64_t remaining_us = laser_deadline_us - esp_timer_get_time();
+            uint32_t remaining_ms = remaining_us > 0 ? (uint32_t)(remaining_us / 1000) : 0;
+            laser_queued = vl53l0x_wait_data_ready(laser, remaining_ms) &&
+                           vl53l0x_read_range_async(laser, NULL, NULL);
+        }
+        if (laser_queued && vl53l0x_wait_range_async(laser, laser->timeout_ms, &range_mm)) {
+            range_mm = (uint16_t)((float)range_mm * laser->calibration_factor);
+        } else {
+            range_mm = 0;
+        }
+        nivometro_store_laser(data, range_mm);
+    }
+}
+
+esp_err_t nivometro_read_sensors(nivometro_t *nivometro, uint8_t mask, nivometro_data_t *data) {
+    if (!nivometro || !data || !nivometro->initialized) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Partir del último registro: los sensores no leídos conservan su valor y su estado
+    *data = nivometro->last;
+    mask &= NIVOMETRO_SENSOR_ALL;
+    
+    // Timestamp UTC real (base de tiempo conservada en rtc); la duración se mide con esp_timer
+    int64_t start_us = esp_timer_get_time();
+    data->timestamp_us = time_sync_now_us();
+    data->sensor_status &= ~mask;
+    data->sampled_mask = mask;
     
     // Datos adicionales (estimados por ahora)
     data->battery_voltage = 3.7f; // TODO: Implementar lectura real
-    data->temperature_c = 20;     // TODO: Implementar sensor temperatura
+    // Los 20 °C nominales solo sirven para el HC-SR04P: en el registro, sin medida no hay temperatura
+    data->temperature_c = nivometro->air_temperature_valid ?
+                          (int8_t)lroundf(nivometro->air_temperature_c) : NIVOMETRO_TEMP_UNKNOWN;
     
-    ESP_LOGD(TAG, "Sensores leídos - Ultrasonido: %.2f cm, Peso: %.2f g, Láser: %.0f mm", 
-             data->ultrasonic_distance_cm, data->weight_grams, data->laser_distance_mm);
+    if (nivometro->config.concurrent_acquisition) {
+        nivometro_read_concurrent(nivometro, mask, data);
+    } else {
+        if (mask & NIVOMETRO_SENSOR_ULTRASONIC) {
+            nivometro_read_ultrasonic(nivometro, data);
+        }
+        if (mask & NIVOMETRO_SENSOR_SCALE) {
+            nivometro_read_weight(nivometro, data);
+        }
+        if (mask & NIVOMETRO_SENSOR_LASER) {
+            nivometro_store_laser(data, vl53l0x_read_distance(&nivometro->laser));
+        }
+    }
+    
+    // Duración de la ventana de adquisición
+    data->acquisition_ms = (uint16_t)((esp_timer_get_time() - start_us) / 1000);
+    nivometro->last = *data;
+    
+    ESP_LOGD(TAG, "Sensores 0x%02x leídos en %u ms - Ultrasonido: %.2f cm, Peso: %.2f g, Láser: %.0f mm", 
+             mask, data->acquisition_ms, data->ultrasonic_distance_cm, data->weight_grams, data->laser_distance_mm);
     
     return ESP_OK;
 }
 
+esp_err_t nivometro_read_all_sensors(nivometro_t *nivometro, nivometro_data_t *data) {
+    return nivometro_read_sensors(nivometro, NIVOMETRO_SENSOR_ALL, data);
+}
+
 esp_err_t nivometro_calibrate_scale(nivometro_t *nivometro, float known_weight_g) {
     if (!nivometro || !nivometro->initialized) {
         return ESP_ERR_INVALID_ARG;
@@ -95,6 +250,7 @@ esp_err_t nivometro_calibrate_scale(nivometro_t *nivometro, float known_weight_g
     
     ESP_LOGI(TAG, "Calibrando balanza con peso conocido: %.2f g", known_weight_g);
     hx711_calibrate(&nivometro->scale, known_weight_g, 10);
+    filter_pipeline_reset(&nivometro->weight_filter);
     ESP_LOGI(TAG, "Calibración de balanza completada. Factor: %.2f", nivometro->scale.scale);
     
     return ESP_OK;
@@ -107,11 +263,42 @@ esp_err_t nivometro_tare_scale(nivometro_t *nivometro) {
     
     ESP_LOGI(TAG, "Realizando tara de la balanza...");
     hx711_tare(&nivometro->scale, 10);
+    filter_pipeline_reset(&nivometro->weight_filter);
     ESP_LOGI(TAG, "Tara completada. Offset: %ld", nivometro->scale.offset);
     
     return ESP_OK;
 }
 
+void nivometro_set_air_temperature(nivometro_t *nivometro, float temperature_c) {
+    if (!nivometro || !isfinite(temperature_c) || temperature_c <= -80.0f || temperature_c >= 80.0f) {
+        return;
+    }
+    nivometro->air_temperature_c = temperature_c;
+    nivometro->air_temperature_valid = true;
+}
+
+void nivometro_power_up_sensors(nivometro_t *nivometro, uint8_t mask) {
+    if (nivometro && nivometro->initialized) {
+        if (mask & NIVOMETRO_SENSOR_SCALE) {
+            hx711_power_up(&nivometro->scale);
+        }
+        if (mask & NIVOMETRO_SENSOR_LASER) {
+            vl53l0x_wake_up(&nivometro->laser);
+        }
+    }
+}
+
+void nivometro_power_down_sensors(nivometro_t *nivometro, uint8_t mask) {
+    if (nivometro && nivometro->initialized) {
+        if (mask & NIVOMETRO_SENSOR_SCALE) {
+            hx711_power_down(&nivometro->scale);
+        }
+        if (mask & NIVOMETRO_SENSOR_LASER) {
+            vl53l0x_sleep(&nivometro->laser);
+        }
+    }
+}
+
 void nivometro_power_down(nivometro_t *nivometro) {
     if (nivometro && nivometro->initialized) {
         hx711_power_down(&nivometro->scale);
@@ -1,7 +1,27 @@
 #pragma once                                 // Le indica al compilador que procese este fichero solo una vez por compilacion
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
 
-void power_manager_init(void);               // Inicializa la configuración y periféricos de gestión de energía
+#define POWER_UPLINK_EVERY_K_WAKES   10      // Por defecto la radio se enciende uno de cada K despertares
+
+// Coste de las sesiones de radio (acumulado en memoria rtc entre despertares)
+typedef struct {
+    uint32_t sessions;                       // Sesiones de subida realizadas
+    uint32_t samples;                        // Muestras entregadas en total
+    uint64_t radio_ms;                       // Tiempo total con la radio encendida
+    uint32_t last_radio_ms;                  // Duración de la última sesión
+    uint32_t last_samples;                   // Muestras entregadas en la última sesión
+} power_uplink_stats_t;
+
+esp_err_t power_manager_init(void);          // Inicializa la configuración y periféricos de gestión de energía
 bool power_manager_should_sleep(void);       // Comprueba si se cumplen las condiciones para entrar en bajo consumo  
 void power_manager_enter_deep_sleep(void);   // Configura y activa el deep sleep del microcontrolador
+
+// Política de radio: se muestrea en cada despertar pero solo se conecta cada K o ante un evento urgente
+bool power_manager_is_cold_boot(void);                                // Arranque sin venir de deep sleep
+void power_manager_set_uplink_interval(uint8_t k);                    // Cambia K (1 = conectar siempre)
+bool power_manager_uplink_due(bool urgent);                           // true si en este despertar toca encender la radio
+void power_manager_uplink_done(uint32_t radio_ms, uint32_t samples);  // Registra la sesión y reinicia la cuenta de despertares
+void power_manager_get_uplink_stats(power_uplink_stats_t* out);       // Copia las métricas de coste de radio
@@ -1,17 +1,30 @@
 #include "power_manager.h"
 #include "esp_sleep.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 
 static const char* TAG = "power_manager";               // Etiqueta de logs para este modulo
 
-void power_manager_init(void) {
+// Estado de la política de radio; sobrevive al deep sleep
+static RTC_DATA_ATTR uint8_t uplink_every_k = POWER_UPLINK_EVERY_K_WAKES;
+static RTC_DATA_ATTR uint32_t wakes_since_uplink = 0;
+static RTC_DATA_ATTR power_uplink_stats_t uplink_stats;
+static bool cold_boot = true;
+
+esp_err_t power_manager_init(void) {
     // Al arrancar, comprueba si viene de deep_sleep y lo registra
     esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    cold_boot = cause != ESP_SLEEP_WAKEUP_TIMER;
     if (cause == ESP_SLEEP_WAKEUP_TIMER) {
         ESP_LOGI(TAG, "Woke up from deep sleep (timer)");
     } else if (cause == ESP_SLEEP_WAKEUP_UNDEFINED) {
         ESP_LOGI(TAG, "Power on or reset");
     }
+    if (cold_boot) {
+        // Tras un arranque en frío se sube en el primer ciclo para confirmar que hay enlace
+        wakes_since_uplink = uplink_every_k;
+    }
+    return ESP_OK;
 }
 
 bool power_manager_should_sleep(void) {
@@ -31,4 +44,42 @@ void power_manager_enter_deep_sleep(void) {
     ESP_LOGI(TAG, "Entering deep sleep for %llu seconds...", WAKEUP_TIME_SEC);
     esp_sleep_enable_timer_wakeup(WAKEUP_TIME_SEC * 1000000ULL);
     esp_deep_sleep_start();
-}
\ No newline at end of file
+}
+
+bool power_manager_is_cold_boot(void) {
+    return cold_boot;
+}
+
+void power_manager_set_uplink_interval(uint8_t k) {
+    uplink_every_k = k ? k : 1;
+}
+
+bool power_manager_uplink_due(bool urgent) {
+    // Cuenta este despertar y decide si se enciende la radio
+    wakes_since_uplink++;
+    bool due = urgent || wakes_since_uplink >= uplink_every_k;
+    ESP_LOGI(TAG, "Wake %lu/%u since last uplink%s -> radio %s",
+             (unsigned long)wakes_since_uplink, uplink_every_k,
+             urgent ? " (urgent)" : "", due ? "on" : "off");
+    return due;
+}
+
+void power_manager_uplink_done(uint32_t radio_ms, uint32_t samples) {
+    wakes_since_uplink = 0;
+    uplink_stats.sessions++;
+    uplink_stats.samples += samples;
+    uplink_stats.radio_ms += radio_ms;
+    uplink_stats.last_radio_ms = radio_ms;
+    uplink_stats.last_samples = samples;
+
+    // Coste de conexión por muestra entregada: en la sesión y acumulado
+    ESP_LOGI(TAG, "Uplink: %lu samples in %lu ms (%lu ms/sample), total %lu ms/sample over %lu sessions",
+             (unsigned long)samples, (unsigned long)radio_ms,
+             (unsigned long)(samples ? radio_ms / samples : radio_ms),
+             (unsigned long)(uplink_stats.samples ? uplink_stats.radio_ms / uplink_stats.samples : 0),
+             (unsigned long)uplink_stats.sessions);
+}
+
+void power_manager_get_uplink_stats(power_uplink_stats_t* out) {
+    if (out) *out = uplink_stats;
+}
@@ -0,0 +1,137 @@
+// sample_bus.h
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/*
+ * Bus de muestras en memoria: anillo de un productor y varios consumidores
+ *
+ * El productor escribe cada registro directamente en un hueco del anillo
+ * (sample_bus_claim / sample_bus_publish) y cada consumidor lo lee en el mismo
+ * hueco con su propio cursor (sample_bus_peek / sample_bus_release), sin copias.
+ *
+ * El productor nunca se bloquea:
+ *   - si un consumidor se queda una vuelta atrás, su registro más antiguo sin leer
+ *     se sobrescribe y se suma a su contador overflow;
+ *   - si ese registro está prestado (peek sin release), el hueco no se toca y el
+ *     registro nuevo se descarta y se suma a producer_dropped.
+ */
+
+#define SAMPLE_BUS_MAX_CONSUMERS    8   // Consumidores por bus (un bit de evento por consumidor)
+
+// Contadores de un consumidor
+typedef struct {
+    uint32_t delivered;          // Registros leídos y liberados
+    uint32_t overflow;           // Registros perdidos por quedarse una vuelta atrás
+    uint32_t pending;            // Registros publicados aún sin leer
+} sample_bus_consumer_stats_t;
+
+// Estado de un consumidor
+typedef struct {
+    const char *name;            // Nombre para los logs
+    uint32_t cursor;             // Secuencia del próximo registro a leer
+    uint32_t held;               // Registros prestados por el último peek
+    uint32_t delivered;
+    uint32_t overflow;
+} sample_bus_consumer_t;
+
+// Bus de muestras (capacidad potencia de 2; las secuencias son monótonas módulo 2^32)
+typedef struct {
+    uint8_t *slots;              // capacity huecos de slot_size bytes contiguos
+    size_t slot_size;
+    uint32_t capacity;
+    uint32_t head;               // Secuencia del próximo registro a publicar
+    bool claimed;                // Hueco head entregado al productor y aún sin publicar
+    uint32_t published;          // Registros publicados
+    uint32_t producer_dropped;   // Registros descartados porque el hueco estaba prestado
+    uint8_t consumer_count;
+    sample_bus_consumer_t consumers[SAMPLE_BUS_MAX_CONSUMERS];
+    SemaphoreHandle_t lock;      // Protege cursores y head (secciones cortas, sin copias)
+    EventGroupHandle_t events;   // Bit i: hay registros nuevos para el consumidor i
+} sample_bus_t;
+
+/**
+ * @brief Inicializa el bus sobre un almacenamiento del llamante
+ * @param bus Puntero al bus
+ * @param storage capacity * slot_size bytes (p. ej. un array estático del tipo de registro)
+ * @param slot_size Tamaño de un registro
+ * @param capacity Número de huecos (potencia de 2, >= 2)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG o ESP_ERR_NO_MEM
+ */
+esp_err_t sample_bus_init(sample_bus_t *bus, void *storage, size_t slot_size, uint32_t capacity);
+
+/**
+ * @brief Registra un consumidor; solo recibe lo publicado a partir de ese momento
+ * @param bus Puntero al bus
+ * @param name Nombre para los logs
+ * @return Identificador del consumidor o -1 si no quedan
+ */
+int sample_bus_subscribe(sample_bus_t *bus, const char *name);
+
+/**
+ * @brief Reserva el hueco del próximo registro para escribirlo en sitio
+ * @param bus Puntero al bus
+ * @return Hueco a rellenar o NULL si hay que descartar la muestra (hueco prestado)
+ */
+void *sample_bus_claim(sample_bus_t *bus);
+
+/**
+ * @brief Publica el hueco reservado y despierta a los consumidores
+ * @param bus Puntero al bus
+ */
+void sample_bus_publish(sample_bus_t *bus);
+
+/**
+ * @brief Anula una reserva sin publicar (lectura fallida)
+ * @param bus Puntero al bus
+ */
+void sample_bus_cancel(sample_bus_t *bus);
+
+/**
+ * @brief Espera a que el consumidor tenga al menos min_count registros sin leer
+ * @param bus Puntero al bus
+ * @param id Consumidor
+ * @param min_count Registros necesarios (se limita a la capacidad)
+ * @param timeout_ms Espera máxima
+ * @return Registros sin leer al volver (puede ser menor que min_count si vence el plazo)
+ */
+size_t sample_bus_wait(sample_bus_t *bus, int id, size_t min_count, uint32_t timeout_ms);
+
+/**
+ * @brief Presta los registros más antiguos sin leer, contiguos en memoria
+ *
+ * El tramo no cruza el final del anillo: si hay más registros detrás, se obtienen
+ * con otro peek tras el release. Hasta el release el productor no sobrescribe el tramo.
+ *
+ * @param bus Puntero al bus
+ * @param id Consumidor
+ * @param out Primer registro del tramo
+ * @param max_count Registros como máximo
+ * @return Registros del tramo (0 si no hay ninguno)
+ */
+size_t sample_bus_peek(sample_bus_t *bus, int id, const void **out, size_t max_count);
+
+/**
+ * @brief Da por leídos los n primeros registros del último peek y devuelve el préstamo
+ * @param bus Puntero al bus
+ * @param id Consumidor
+ * @param n Registros consumidos (<= los devueltos por el peek)
+ */
+void sample_bus_release(sample_bus_t *bus, int id, size_t n);
+
+/**
+ * @brief Contadores de un consumidor
+ * @param bus Puntero al bus
+ * @param id Consumidor
+ * @param stats Destino de los contadores
+ */
+void sample_bus_get_stats(sample_bus_t *bus, int id, sample_bus_consumer_stats_t *stats);
+
+#endif // SAMPLE_BUS_H
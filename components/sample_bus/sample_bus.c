@@ -0,0 +1,199 @@
+// sample_bus.c
+#include "sample_bus.h"
+#include <string.h>
+#include "freertos/task.h"
+
+// Hueco del anillo que corresponde a una secuencia
+static void *slot_at(const sample_bus_t *bus, uint32_t seq) {
+    return bus->slots + (size_t)(seq & (bus->capacity - 1)) * bus->slot_size;
+}
+
+static sample_bus_consumer_t *consumer_at(sample_bus_t *bus, int id) {
+    if (bus == NULL || bus->lock == NULL || id < 0 || id >= bus->consumer_count) {
+        return NULL;
+    }
+    return &bus->consumers[id];
+}
+
+esp_err_t sample_bus_init(sample_bus_t *bus, void *storage, size_t slot_size, uint32_t capacity) {
+    if (bus == NULL || storage == NULL || slot_size == 0 ||
+        capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memset(bus, 0, sizeof(*bus));
+    bus->slots = storage;
+    bus->slot_size = slot_size;
+    bus->capacity = capacity;
+    bus->lock = xSemaphoreCreateMutex();
+    bus->events = xEventGroupCreate();
+    if (bus->lock == NULL || bus->events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+int sample_bus_subscribe(sample_bus_t *bus, const char *name) {
+    int id = -1;
+    if (bus == NULL || bus->lock == NULL) {
+        return -1;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    if (bus->consumer_count < SAMPLE_BUS_MAX_CONSUMERS) {
+        id = bus->consumer_count++;
+        sample_bus_consumer_t *c = &bus->consumers[id];
+        memset(c, 0, sizeof(*c));
+        c->name = name;
+        c->cursor = bus->head;
+    }
+    xSemaphoreGive(bus->lock);
+    return id;
+}
+
+void *sample_bus_claim(sample_bus_t *bus) {
+    void *slot = NULL;
+    if (bus == NULL || bus->lock == NULL) {
+        return NULL;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    
+    // El hueco de head guarda el registro head - capacity: no se toca si alguien lo tiene prestado
+    bool lent = false;
+    for (int i = 0; i < bus->consumer_count; i++) {
+        const sample_bus_consumer_t *c = &bus->consumers[i];
+        if (bus->head - c->cursor >= bus->capacity && c->held > 0) {
+            lent = true;
+        }
+    }
+    
+    if (lent) {
+        bus->producer_dropped++;
+    } else {
+        // Los consumidores que van una vuelta atrás pierden su registro más antiguo
+        for (int i = 0; i < bus->consumer_count; i++) {
+            sample_bus_consumer_t *c = &bus->consumers[i];
+            if (bus->head - c->cursor >= bus->capacity) {
+                c->cursor = bus->head - bus->capacity + 1;
+                c->overflow++;
+            }
+        }
+        bus->claimed = true;
+        slot = slot_at(bus, bus->head);
+    }
+    
+    xSemaphoreGive(bus->lock);
+    return slot;
+}
+
+void sample_bus_publish(sample_bus_t *bus) {
+    EventBits_t bits = 0;
+    if (bus == NULL || bus->lock == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    if (bus->claimed) {
+        bus->claimed = false;
+        bus->head++;
+        bus->published++;
+        bits = (EventBits_t)((1UL << bus->consumer_count) - 1);
+    }
+    xSemaphoreGive(bus->lock);
+    
+    if (bits) {
+        xEventGroupSetBits(bus->events, bits);
+    }
+}
+
+void sample_bus_cancel(sample_bus_t *bus) {
+    if (bus == NULL || bus->lock == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    bus->claimed = false;
+    xSemaphoreGive(bus->lock);
+}
+
+static size_t pending_of(sample_bus_t *bus, const sample_bus_consumer_t *c) {
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    size_t pending = bus->head - c->cursor;
+    xSemaphoreGive(bus->lock);
+    return pending;
+}
+
+size_t sample_bus_wait(sample_bus_t *bus, int id, size_t min_count, uint32_t timeout_ms) {
+    sample_bus_consumer_t *c = consumer_at(bus, id);
+    if (c == NULL) {
+        return 0;
+    }
+    if (min_count > bus->capacity) {
+        min_count = bus->capacity;
+    }
+    
+    EventBits_t bit = (EventBits_t)(1UL << id);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    
+    while (1) {
+        // Limpiar antes de comprobar: una publicación posterior vuelve a poner el bit
+        xEventGroupClearBits(bus->events, bit);
+        size_t pending = pending_of(bus, c);
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (pending >= min_count || elapsed >= timeout) {
+            return pending;
+        }
+        xEventGroupWaitBits(bus->events, bit, pdTRUE, pdFALSE, timeout - elapsed);
+    }
+}
+
+size_t sample_bus_peek(sample_bus_t *bus, int id, const void **out, size_t max_count) {
+    sample_bus_consumer_t *c = consumer_at(bus, id);
+    size_t n = 0;
+    if (c == NULL || out == NULL) {
+        return 0;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    uint32_t pending = bus->head - c->cursor;
+    uint32_t to_end = bus->capacity - (c->cursor & (bus->capacity - 1));
+    n = pending < to_end ? pending : to_end;
+    if (n > max_count) {
+        n = max_count;
+    }
+    c->held = n;
+    *out = slot_at(bus, c->cursor);
+    xSemaphoreGive(bus->lock);
+    return n;
+}
+
+void sample_bus_release(sample_bus_t *bus, int id, size_t n) {
+    sample_bus_consumer_t *c = consumer_at(bus, id);
+    if (c == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    if (n > c->held) {
+        n = c->held;
+    }
+    c->cursor += n;
+    c->delivered += n;
+    c->held = 0;
+    xSemaphoreGive(bus->lock);
+}
+
+void sample_bus_get_stats(sample_bus_t *bus, int id, sample_bus_consumer_stats_t *stats) {
+    sample_bus_consumer_t *c = consumer_at(bus, id);
+    if (c == NULL || stats == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    stats->delivered = c->delivered;
+    stats->overflow = c->overflow;
+    stats->pending = bus->head - c->cursor;
+    xSemaphoreGive(bus->lock);
+}
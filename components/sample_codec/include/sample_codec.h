@@ -0,0 +1,140 @@
+// sample_codec.h
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "nivometro_sensors.h"
+
+/*
+ * Codificación binaria de lotes de nivometro_data_t (esquema fijo versionado)
+ *
+ * Todo en little endian. Cabecera de 12 bytes:
+ *   [0]  'N'  [1] 'V'          magic
+ *   [2]  u8   esquema          SAMPLE_CODEC_SCHEMA_V1
+ *   [3]  u8   n                número de registros
+ *   [4]  u64  base_ts_us       timestamp del primer registro
+ *
+ * Registro v1 de 17 bytes:
+ *   [0]  u32  dt_ms            timestamp_us - base_ts_us, en ms
+ *   [4]  u16  us_ccm           distancia ultrasonido en centésimas de cm
+ *   [6]  u8   us_q             confianza ultrasonido en %
+ *   [7]  i32  w_cg             peso en centésimas de gramo
+ *   [11] u16  l_mm             distancia láser en mm
+ *   [13] u8   st               máscara de sensores operativos
+ *   [14] u16  bat_mv           batería en mV
+ *   [16] i8   t_c              temperatura en ºC (NIVOMETRO_TEMP_UNKNOWN = sin medida)
+ *
+ * Los valores fuera de rango se saturan al límite del campo.
+ *
+ * Esquema v2 (bloque comprimido, misma cabecera de 12 bytes y misma cuantización que v1)
+ * seguido de un flujo de bits, del bit más significativo al menos significativo:
+ *   por muestra: t  delta-of-delta de (timestamp_us - base_ts_us) / 1000, en ms
+ *                us_ccm, us_q, w_cg, l_mm, bat_mv, t_c  delta con la muestra anterior
+ *                st  '0' si repite, '1' + 6 bits (sensor_status | sampled_mask << 3)
+ *   Enteros con signo en zigzag y prefijo de longitud:
+ *     '0' = 0 | '10' + 6 bits | '110' + 12 bits | '1110' + 20 bits | '1111' + 64 bits
+ *   La primera muestra parte de todo a cero. Los bits sobrantes del último byte van a 0.
+ * En reposo (nivel y peso casi constantes) una muestra ocupa pocos bits.
+ */
+
+#define SAMPLE_CODEC_MAGIC_0        'N'
+#define SAMPLE_CODEC_MAGIC_1        'V'
+#define SAMPLE_CODEC_SCHEMA_V1      1
+#define SAMPLE_CODEC_HEADER_SIZE    12
+#define SAMPLE_CODEC_RECORD_SIZE    17
+#define SAMPLE_CODEC_MAX_RECORDS    255
+
+// Tamaño codificado de un lote de n registros
+#define SAMPLE_CODEC_SIZE(n)        (SAMPLE_CODEC_HEADER_SIZE + (n) * SAMPLE_CODEC_RECORD_SIZE)
+
+#define SAMPLE_CODEC_SCHEMA_V2      2
+#define SAMPLE_CODEC_V2_FIELDS      6       // us_ccm, us_q, w_cg, l_mm, bat_mv, t_c
+#define SAMPLE_CODEC_V2_MAX_BITS    ((1 + SAMPLE_CODEC_V2_FIELDS) * 68 + 7)
+
+// Tamaño máximo de un bloque v2 de n muestras (peor caso: todo en el prefijo de 64 bits)
+#define SAMPLE_CODEC_V2_SIZE_MAX(n) (SAMPLE_CODEC_HEADER_SIZE + ((n) * SAMPLE_CODEC_V2_MAX_BITS + 7) / 8)
+
+// Codificador incremental de un bloque v2 sobre un buffer del llamante
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t bits;                            // Bits escritos tras la cabecera
+    uint8_t count;
+    uint64_t base_ts_us;
+    int64_t prev_t_ms;
+    int64_t prev_dt_ms;
+    int32_t prev[SAMPLE_CODEC_V2_FIELDS];
+    uint8_t prev_st;
+} sample_codec_block_t;
+
+/**
+ * @brief Codifica un lote de muestras
+ * @param samples Muestras en orden temporal
+ * @param count Número de muestras (1..SAMPLE_CODEC_MAX_RECORDS)
+ * @param out Buffer de salida
+ * @param out_size Tamaño del buffer
+ * @return Bytes escritos o -1 si no cabe o los argumentos no son válidos
+ */
+int sample_codec_encode(const nivometro_data_t *samples, size_t count,
+                        uint8_t *out, size_t out_size);
+
+/**
+ * @brief Decodifica un lote v1 o v2
+ * @param in Mensaje codificado
+ * @param in_size Longitud del mensaje
+ * @param samples Destino de las muestras decodificadas
+ * @param max_samples Capacidad de samples
+ * @return Número de muestras decodificadas o -1 si el mensaje no es válido
+ */
+int sample_codec_decode(const uint8_t *in, size_t in_size,
+                        nivometro_data_t *samples, size_t max_samples);
+
+/**
+ * @brief Decodifica parte de un lote v1 o v2
+ * @param in Mensaje codificado
+ * @param in_size Longitud del mensaje
+ * @param skip Muestras iniciales que no se devuelven
+ * @param samples Destino de las muestras decodificadas
+ * @param max_samples Capacidad de samples (el resto del lote se ignora)
+ * @return Número de muestras decodificadas (0 si skip >= n) o -1 si el mensaje no es válido
+ */
+int sample_codec_decode_range(const uint8_t *in, size_t in_size, size_t skip,
+                              nivometro_data_t *samples, size_t max_samples);
+
+/**
+ * @brief Empieza un bloque v2 vacío
+ * @param b Codificador
+ * @param buf Buffer del bloque (al menos SAMPLE_CODEC_HEADER_SIZE + 1 bytes)
+ * @param size Tamaño del buffer
+ */
+void sample_codec_block_init(sample_codec_block_t *b, uint8_t *buf, size_t size);
+
+/**
+ * @brief Añade una muestra al bloque si cabe entera
+ * @param b Codificador
+ * @param sample Muestra (la primera fija base_ts_us)
+ * @return true si se añadió; false si no cabe o el bloque tiene SAMPLE_CODEC_MAX_RECORDS (queda igual)
+ */
+bool sample_codec_block_append(sample_codec_block_t *b, const nivometro_data_t *sample);
+
+/**
+ * @brief Bytes ocupados por el bloque (cabecera incluida)
+ * @param b Codificador
+ * @return Tamaño del mensaje codificado
+ */
+size_t sample_codec_block_size(const sample_codec_block_t *b);
+
+/**
+ * @brief Codifica un lote completo en v2
+ * @param samples Muestras en orden temporal
+ * @param count Número de muestras (1..SAMPLE_CODEC_MAX_RECORDS)
+ * @param out Buffer de salida (SAMPLE_CODEC_V2_SIZE_MAX(count) basta siempre)
+ * @param out_size Tamaño del buffer
+ * @return Bytes escritos o -1 si no caben todas
+ */
+int sample_codec_encode_v2(const nivometro_data_t *samples, size_t count,
+                           uint8_t *out, size_t out_size);
+
+#endif // SAMPLE_CODEC_H
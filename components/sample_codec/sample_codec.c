@@ -0,0 +1,345 @@
+// sample_codec.c
+#include "sample_codec.h"
+#include <string.h>
+#include <math.h>
+
+// Escritura/lectura little endian independiente del alineamiento
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+// Escala, redondea y satura al rango [lo, hi]
+static int64_t to_fixed(float value, float scale, int64_t lo, int64_t hi) {
+    if (isnan(value)) return lo;
+    float scaled = roundf(value * scale);
+    if (scaled <= (float)lo) return lo;
+    if (scaled >= (float)hi) return hi;
+    return (int64_t)scaled;
+}
+
+// Cuantización común a v1 y v2: us_ccm, us_q, w_cg, l_mm, bat_mv, t_c
+static void quantize(const nivometro_data_t *d, int32_t q[SAMPLE_CODEC_V2_FIELDS]) {
+    q[0] = (int32_t)to_fixed(d->ultrasonic_distance_cm, 100.0f, 0, UINT16_MAX);
+    q[1] = (int32_t)to_fixed(d->ultrasonic_confidence, 100.0f, 0, 100);
+    q[2] = (int32_t)to_fixed(d->weight_grams, 100.0f, INT32_MIN, INT32_MAX);
+    q[3] = (int32_t)to_fixed(d->laser_distance_mm, 1.0f, 0, UINT16_MAX);
+    q[4] = (int32_t)to_fixed(d->battery_voltage, 1000.0f, 0, UINT16_MAX);
+    q[5] = d->temperature_c;
+}
+
+static void dequantize(const int32_t q[SAMPLE_CODEC_V2_FIELDS], nivometro_data_t *d) {
+    d->ultrasonic_distance_cm = q[0] / 100.0f;
+    d->ultrasonic_confidence = q[1] / 100.0f;
+    d->weight_grams = q[2] / 100.0f;
+    d->laser_distance_mm = (float)q[3];
+    d->battery_voltage = q[4] / 1000.0f;
+    d->temperature_c = (int8_t)q[5];
+}
+
+int sample_codec_encode(const nivometro_data_t *samples, size_t count,
+                        uint8_t *out, size_t out_size) {
+    if (!samples || !out || count == 0 || count > SAMPLE_CODEC_MAX_RECORDS) return -1;
+    if (out_size < SAMPLE_CODEC_SIZE(count)) return -1;
+
+    uint64_t base_ts = samples[0].timestamp_us;
+    out[0] = SAMPLE_CODEC_MAGIC_0;
+    out[1] = SAMPLE_CODEC_MAGIC_1;
+    out[2] = SAMPLE_CODEC_SCHEMA_V1;
+    out[3] = (uint8_t)count;
+    put_u64(out + 4, base_ts);
+
+    uint8_t *p = out + SAMPLE_CODEC_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++, p += SAMPLE_CODEC_RECORD_SIZE) {
+        const nivometro_data_t *d = &samples[i];
+        // Muestras fuera de orden (reloj ajustado) quedan en el instante base
+        uint64_t dt_ms = d->timestamp_us > base_ts ? (d->timestamp_us - base_ts) / 1000 : 0;
+        if (dt_ms > UINT32_MAX) return -1;
+
+        int32_t q[SAMPLE_CODEC_V2_FIELDS];
+        quantize(d, q);
+        put_u32(p + 0, (uint32_t)dt_ms);
+        put_u16(p + 4, (uint16_t)q[0]);
+        p[6] = (uint8_t)q[1];
+        put_u32(p + 7, (uint32_t)q[2]);
+        put_u16(p + 11, (uint16_t)q[3]);
+        p[13] = d->sensor_status;
+        put_u16(p + 14, (uint16_t)q[4]);
+        p[16] = (uint8_t)q[5];
+    }
+    return (int)SAMPLE_CODEC_SIZE(count);
+}
+
+// Decodificación v1: registros fijos de SAMPLE_CODEC_RECORD_SIZE bytes
+static int decode_v1(const uint8_t *in, size_t in_size, size_t skip,
+                     nivometro_data_t *samples, size_t max_samples) {
+    size_t count = in[3];
+    if (in_size < SAMPLE_CODEC_SIZE(count)) return -1;
+
+    uint64_t base_ts = get_u64(in + 4);
+    const uint8_t *p = in + SAMPLE_CODEC_HEADER_SIZE + skip * SAMPLE_CODEC_RECORD_SIZE;
+    size_t n = 0;
+    for (size_t i = skip; i < count && n < max_samples; i++, p += SAMPLE_CODEC_RECORD_SIZE) {
+        nivometro_data_t *d = &samples[n++];
+        memset(d, 0, sizeof(*d));
+        d->timestamp_us = base_ts + (uint64_t)get_u32(p + 0) * 1000;
+        d->ultrasonic_distance_cm = get_u16(p + 4) / 100.0f;
+        d->ultrasonic_confidence = p[6] / 100.0f;
+        d->weight_grams = (int32_t)get_u32(p + 7) / 100.0f;
+        d->laser_distance_mm = get_u16(p + 11);
+        d->sensor_status = p[13];
+        d->battery_voltage = get_u16(p + 14) / 1000.0f;
+        d->temperature_c = (int8_t)p[16];
+    }
+    return (int)n;
+}
+
+/* ---- Esquema v2: flujo de bits ---- */
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap_bits;
+    size_t pos;
+    bool overflow;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t cap_bits;
+    size_t pos;
+    bool overflow;
+} bit_reader_t;
+
+// Escribe los n bits bajos de value (n <= 64); el buffer debe estar a cero desde pos
+static void put_bits(bit_writer_t *w, uint64_t value, unsigned n) {
+    if (w->overflow || w->pos + n > w->cap_bits) {
+        w->overflow = true;
+        return;
+    }
+    while (n > 0) {
+        unsigned free_bits = 8 - (w->pos & 7);
+        unsigned take = n < free_bits ? n : free_bits;
+        uint8_t chunk = (uint8_t)((value >> (n - take)) & ((1u << take) - 1));
+        w->buf[w->pos >> 3] |= (uint8_t)(chunk << (free_bits - take));
+        w->pos += take;
+        n -= take;
+    }
+}
+
+static uint64_t get_bits(bit_reader_t *r, unsigned n) {
+    uint64_t value = 0;
+    if (r->overflow || r->pos + n > r->cap_bits) {
+        r->overflow = true;
+        return 0;
+    }
+    while (n > 0) {
+        unsigned avail = 8 - (r->pos & 7);
+        unsigned take = n < avail ? n : avail;
+        uint8_t byte = r->buf[r->pos >> 3];
+        value = (value << take) | ((byte >> (avail - take)) & ((1u << take) - 1));
+        r->pos += take;
+        n -= take;
+    }
+    return value;
+}
+
+// Prefijos de longitud: '0' | '10' + 6 | '110' + 12 | '1110' + 20 | '1111' + 64
+static const uint8_t bucket_bits[] = { 6, 12, 20, 64 };
+
+static void put_varint(bit_writer_t *w, int64_t v) {
+    uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);     // zigzag
+    if (z == 0) {
+        put_bits(w, 0, 1);
+        return;
+    }
+    for (unsigned i = 0; i < sizeof(bucket_bits); i++) {
+        bool last = i == sizeof(bucket_bits) - 1;
+        if (last || z < (1ULL << bucket_bits[i])) {
+            // i + 1 unos seguidos de un cero, salvo en el último prefijo ('1111')
+            put_bits(w, last ? 0x0f : ((1u << (i + 2)) - 2), last ? 4 : i + 2);
+            put_bits(w, z, bucket_bits[i]);
+            return;
+        }
+    }
+}
+
+static int64_t get_varint(bit_reader_t *r) {
+    unsigned ones = 0;
+    while (ones < sizeof(bucket_bits) && get_bits(r, 1)) {
+        ones++;
+    }
+    if (ones == 0) {
+        return 0;
+    }
+    uint64_t z = get_bits(r, bucket_bits[ones - 1]);
+    return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+void sample_codec_block_init(sample_codec_block_t *b, uint8_t *buf, size_t size) {
+    if (!b) return;
+    memset(b, 0, sizeof(*b));
+    b->buf = buf;
+    b->size = size;
+    if (buf && size >= SAMPLE_CODEC_HEADER_SIZE) {
+        memset(buf, 0, size);
+        buf[0] = SAMPLE_CODEC_MAGIC_0;
+        buf[1] = SAMPLE_CODEC_MAGIC_1;
+        buf[2] = SAMPLE_CODEC_SCHEMA_V2;
+    }
+}
+
+bool sample_codec_block_append(sample_codec_block_t *b, const nivometro_data_t *sample) {
+    if (!b || !b->buf || !sample || b->size <= SAMPLE_CODEC_HEADER_SIZE ||
+        b->count >= SAMPLE_CODEC_MAX_RECORDS) {
+        return false;
+    }
+
+    if (b->count == 0) {
+        b->base_ts_us = sample->timestamp_us;
+        put_u64(b->buf + 4, b->base_ts_us);
+    }
+
+    bit_writer_t w = {
+        .buf = b->buf + SAMPLE_CODEC_HEADER_SIZE,
+        .cap_bits = (b->size - SAMPLE_CODEC_HEADER_SIZE) * 8,
+        .pos = b->bits,
+    };
+
+    // Marca de tiempo: delta-of-delta en ms (con signo si el reloj se ajustó hacia atrás)
+    int64_t t_ms = (int64_t)(sample->timestamp_us - b->base_ts_us) / 1000;
+    int64_t dt_ms = t_ms - b->prev_t_ms;
+    put_varint(&w, dt_ms - b->prev_dt_ms);
+
+    // Valores cuantizados: delta con la muestra anterior
+    int32_t q[SAMPLE_CODEC_V2_FIELDS];
+    quantize(sample, q);
+    for (int i = 0; i < SAMPLE_CODEC_V2_FIELDS; i++) {
+        put_varint(&w, (int64_t)q[i] - b->prev[i]);
+    }
+
+    // Estado: un bit si repite
+    uint8_t st = (uint8_t)((sample->sensor_status & 0x07) | ((sample->sampled_mask & 0x07) << 3));
+    if (b->count > 0 && st == b->prev_st) {
+        put_bits(&w, 0, 1);
+    } else {
+        put_bits(&w, 1, 1);
+        put_bits(&w, st, 6);
+    }
+
+    if (w.overflow) {
+        // No cabe: se borran los bits escritos a medias y el bloque queda como estaba
+        size_t first = b->bits >> 3;
+        size_t end = (w.pos + 7) >> 3;
+        if (b->bits & 7) {
+            w.buf[first] &= (uint8_t)(0xff << (8 - (b->bits & 7)));
+            first++;
+        }
+        if (end > first) {
+            memset(w.buf + first, 0, end - first);
+        }
+        return false;
+    }
+
+    b->bits = w.pos;
+    b->prev_t_ms = t_ms;
+    b->prev_dt_ms = dt_ms;
+    memcpy(b->prev, q, sizeof(q));
+    b->prev_st = st;
+    b->count++;
+    b->buf[3] = b->count;
+    return true;
+}
+
+size_t sample_codec_block_size(const sample_codec_block_t *b) {
+    return b ? SAMPLE_CODEC_HEADER_SIZE + (b->bits + 7) / 8 : 0;
+}
+
+int sample_codec_encode_v2(const nivometro_data_t *samples, size_t count,
+                           uint8_t *out, size_t out_size) {
+    sample_codec_block_t b;
+    if (!samples || !out || count == 0 || count > SAMPLE_CODEC_MAX_RECORDS) return -1;
+    if (out_size <= SAMPLE_CODEC_HEADER_SIZE) return -1;
+
+    sample_codec_block_init(&b, out, out_size);
+    for (size_t i = 0; i < count; i++) {
+        if (!sample_codec_block_append(&b, &samples[i])) return -1;
+    }
+    return (int)sample_codec_block_size(&b);
+}
+
+// Decodificación v2: el flujo es secuencial, las muestras saltadas se decodifican y se descartan
+static int decode_v2(const uint8_t *in, size_t in_size, size_t skip,
+                     nivometro_data_t *samples, size_t max_samples) {
+    size_t count = in[3];
+    size_t n = 0;
+
+    uint64_t base_ts = get_u64(in + 4);
+    bit_reader_t r = {
+        .buf = in + SAMPLE_CODEC_HEADER_SIZE,
+        .cap_bits = (in_size - SAMPLE_CODEC_HEADER_SIZE) * 8,
+    };
+    int64_t t_ms = 0, dt_ms = 0;
+    int32_t q[SAMPLE_CODEC_V2_FIELDS] = { 0 };
+    uint8_t st = 0;
+
+    for (size_t i = 0; i < count && n < max_samples; i++) {
+        dt_ms += get_varint(&r);
+        t_ms += dt_ms;
+        for (int f = 0; f < SAMPLE_CODEC_V2_FIELDS; f++) {
+            q[f] = (int32_t)(q[f] + get_varint(&r));
+        }
+        if (get_bits(&r, 1)) {
+            st = (uint8_t)get_bits(&r, 6);
+        }
+        if (r.overflow) return -1;
+        if (i < skip) continue;
+
+        nivometro_data_t *d = &samples[n++];
+        memset(d, 0, sizeof(*d));
+        d->timestamp_us = base_ts + (uint64_t)(t_ms * 1000);
+        dequantize(q, d);
+        d->sensor_status = st & 0x07;
+        d->sampled_mask = (st >> 3) & 0x07;
+    }
+    return (int)n;
+}
+
+int sample_codec_decode_range(const uint8_t *in, size_t in_size, size_t skip,
+                              nivometro_data_t *samples, size_t max_samples) {
+    if (!in || !samples || in_size < SAMPLE_CODEC_HEADER_SIZE) return -1;
+    if (in[0] != SAMPLE_CODEC_MAGIC_0 || in[1] != SAMPLE_CODEC_MAGIC_1) return -1;
+
+    switch (in[2]) {
+        case SAMPLE_CODEC_SCHEMA_V1: return decode_v1(in, in_size, skip, samples, max_samples);
+        case SAMPLE_CODEC_SCHEMA_V2: return decode_v2(in, in_size, skip, samples, max_samples);
+        default:                     return -1;
+    }
+}
+
+int sample_codec_decode(const uint8_t *in, size_t in_size,
+                        nivometro_data_t *samples, size_t max_samples) {
+    if (!in || in_size < SAMPLE_CODEC_HEADER_SIZE || in[3] > max_samples) return -1;
+    return sample_codec_decode_range(in, in_size, 0, samples, max_samples);
+}
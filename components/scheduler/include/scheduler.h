@@ -0,0 +1,75 @@
+// scheduler.h
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHEDULER_MAX_ENTRIES 8  // Máximo de sensores planificables (bits de la máscara)
+
+// Planificación de un sensor
+typedef struct {
+    uint32_t period_ms;      // Periodo de muestreo
+    uint32_t phase_ms;       // Desfase respecto al origen de tiempos
+    uint32_t lead_ms;        // Antelación con la que hay que alimentarlo antes de leer
+    int64_t next_due_ms;     // Próximo instante de lectura
+    bool enabled;            // Entrada registrada
+} scheduler_entry_t;
+
+// Planificador de muestreo con periodos independientes por sensor
+typedef struct {
+    scheduler_entry_t entries[SCHEDULER_MAX_ENTRIES];
+} scheduler_t;
+
+/**
+ * @brief Inicializa el planificador sin entradas
+ * @param sched Puntero al planificador
+ */
+void scheduler_init(scheduler_t *sched);
+
+/**
+ * @brief Registra un sensor
+ * @param sched Puntero al planificador
+ * @param id Identificador del sensor (bit id en las máscaras, < SCHEDULER_MAX_ENTRIES)
+ * @param period_ms Periodo de muestreo (> 0)
+ * @param phase_ms Desfase de la primera lectura respecto a now_ms
+ * @param lead_ms Tiempo de encendido previo a la lectura
+ * @param now_ms Instante actual
+ * @return true si se registró
+ */
+bool scheduler_register(scheduler_t *sched, uint8_t id, uint32_t period_ms,
+                        uint32_t phase_ms, uint32_t lead_ms, int64_t now_ms);
+
+/**
+ * @brief Sensores cuya lectura ya toca
+ * @param sched Puntero al planificador
+ * @param now_ms Instante actual
+ * @return Máscara de bits con los sensores a leer
+ */
+uint32_t scheduler_due_mask(const scheduler_t *sched, int64_t now_ms);
+
+/**
+ * @brief Sensores que deben estar alimentados (lectura dentro de su antelación)
+ * @param sched Puntero al planificador
+ * @param now_ms Instante actual
+ * @return Máscara de bits con los sensores a encender
+ */
+uint32_t scheduler_power_mask(const scheduler_t *sched, int64_t now_ms);
+
+/**
+ * @brief Marca como leídos los sensores y programa su siguiente lectura
+ * @param sched Puntero al planificador
+ * @param mask Sensores leídos
+ * @param now_ms Instante actual (los periodos perdidos se saltan, sin ráfagas de recuperación)
+ */
+void scheduler_mark_done(scheduler_t *sched, uint32_t mask, int64_t now_ms);
+
+/**
+ * @brief Próximo instante en el que hay que despertar (encendido o lectura)
+ * @param sched Puntero al planificador
+ * @param now_ms Instante actual
+ * @return Milisegundos hasta el próximo evento (0 si ya hay algo pendiente)
+ */
+uint32_t scheduler_ms_until_next(const scheduler_t *sched, int64_t now_ms);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,101 @@
+// scheduler.c
+#include "scheduler.h"
+#include <string.h>
+
+void scheduler_init(scheduler_t *sched) {
+    if (sched != NULL) {
+        memset(sched, 0, sizeof(*sched));
+    }
+}
+
+bool scheduler_register(scheduler_t *sched, uint8_t id, uint32_t period_ms,
+                        uint32_t phase_ms, uint32_t lead_ms, int64_t now_ms) {
+    if (sched == NULL || id >= SCHEDULER_MAX_ENTRIES || period_ms == 0) {
+        return false;
+    }
+    
+    scheduler_entry_t *e = &sched->entries[id];
+    e->period_ms = period_ms;
+    e->phase_ms = phase_ms;
+    e->lead_ms = lead_ms;
+    e->next_due_ms = now_ms + phase_ms;
+    e->enabled = true;
+    return true;
+}
+
+uint32_t scheduler_due_mask(const scheduler_t *sched, int64_t now_ms) {
+    uint32_t mask = 0;
+    if (sched == NULL) {
+        return 0;
+    }
+    
+    for (int i = 0; i < SCHEDULER_MAX_ENTRIES; i++) {
+        const scheduler_entry_t *e = &sched->entries[i];
+        if (e->enabled && e->next_due_ms <= now_ms) {
+            mask |= 1UL << i;
+        }
+    }
+    return mask;
+}
+
+uint32_t scheduler_power_mask(const scheduler_t *sched, int64_t now_ms) {
+    uint32_t mask = 0;
+    if (sched == NULL) {
+        return 0;
+    }
+    
+    for (int i = 0; i < SCHEDULER_MAX_ENTRIES; i++) {
+        const scheduler_entry_t *e = &sched->entries[i];
+        if (e->enabled && e->next_due_ms - e->lead_ms <= now_ms) {
+            mask |= 1UL << i;
+        }
+    }
+    return mask;
+}
+
+void scheduler_mark_done(scheduler_t *sched, uint32_t mask, int64_t now_ms) {
+    if (sched == NULL) {
+        return;
+    }
+    
+    for (int i = 0; i < SCHEDULER_MAX_ENTRIES; i++) {
+        scheduler_entry_t *e = &sched->entries[i];
+        if (!e->enabled || !(mask & (1UL << i))) {
+            continue;
+        }
+        
+        // Mantener la rejilla de fase y saltar los periodos ya vencidos
+        e->next_due_ms += e->period_ms;
+        if (e->next_due_ms <= now_ms) {
+            int64_t missed = (now_ms - e->next_due_ms) / e->period_ms + 1;
+            e->next_due_ms += missed * e->period_ms;
+        }
+    }
+}
+
+uint32_t scheduler_ms_until_next(const scheduler_t *sched, int64_t now_ms) {
+    int64_t next = INT64_MAX;
+    if (sched == NULL) {
+        return 0;
+    }
+    
+    for (int i = 0; i < SCHEDULER_MAX_ENTRIES; i++) {
+        const scheduler_entry_t *e = &sched->entries[i];
+        if (!e->enabled) {
+            continue;
+        }
+        // El primer evento es el encendido si aún no ha llegado, si no la lectura
+        int64_t wake = e->next_due_ms - e->lead_ms;
+        if (wake <= now_ms) {
+            wake = e->next_due_ms;
+        }
+        if (wake < next) {
+            next = wake;
+        }
+    }
+    
+    if (next == INT64_MAX) {
+        return UINT32_MAX;
+    }
+    return next > now_ms ? (uint32_t)(next - now_ms) : 0;
+}
@@ -1,10 +1,43 @@
 #pragma once                                             // Le indica al compilador que procese este fichero solo una vez por compilacion
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "nivometro_sensors.h"
 #include "esp_err.h"
 
-void storage_init(void);                                 // Inicializa el sistema de almacenamiento (nvs, etc)
-void storage_buffer_data(const sensor_data_t* data);     // Guarda temporalmente los datos de sensores para su posterior envío
+#define STORAGE_PARTITION_LABEL  "samples"               // Partición de datos del outbox (partitions.csv); al llenarse se descartan los más antiguos
+#define STORAGE_RECORD_SIZE      256                     // Registro de flash_log: un bloque comprimido de muestras (sample_codec v2)
 
+// Coste de escritura del outbox (en la zona de staging rtc; se reinicia en un arranque en frío)
+typedef struct {
+    uint32_t staged;             // Muestras añadidas al outbox
+    uint32_t flushes;            // Bloques escritos en flash
+    uint64_t bytes_written;      // Bytes programados en flash por esos bloques
+    uint32_t delivered;          // Muestras confirmadas por el broker
+    uint32_t unflushed;          // Entregadas desde rtc sin llegar a escribirse en flash
+    uint32_t restored;           // Arranques que recuperaron el bloque abierto de la zona de staging
+    uint32_t discarded;          // Bloques de staging que no encajaban con flash y se descartaron
+} storage_stats_t;
 
+esp_err_t storage_init(void);                            // Monta el registro circular de la partición y recupera el outbox
+void storage_buffer_data(const nivometro_data_t* data);  // Añade una muestra al bloque abierto en memoria rtc (va a flash al llenarse)
+void storage_flush(void);                                // Escribe en flash el bloque abierto (lo que no debe depender de la memoria rtc)
+void storage_get_stats(storage_stats_t* out);            // Copia los contadores de escritura en flash
 
+// Outbox persistente (flash_log en la partición de muestras): las muestras no entregadas sobreviven a reinicios y deep sleep
+size_t storage_outbox_count(void);                                        // Muestras pendientes de entregar
+size_t storage_outbox_peek(nivometro_data_t* out, size_t max, uint32_t* first);  // Copia las max más antiguas sin retirarlas; devuelve cuántas y el índice de la primera
+void storage_outbox_ack(uint32_t first, size_t n);                                // Retira las n muestras entregadas a partir del índice first
+uint32_t storage_outbox_dropped(void);                                    // Muestras descartadas (outbox lleno o ilegibles) desde el arranque
+bool storage_outbox_oldest(uint64_t* ts_us);                              // Timestamp de la muestra sin entregar más antigua (índice de flash_log); false si no hay
+
+// Histórico guardado (entregado o no) por tiempo, con un índice disperso por bloque: O(log n) lecturas de flash.
+// Los timestamps son los guardados: las muestras anteriores a la primera sincronización cuentan desde 1970
+typedef struct {
+    uint32_t seq;                // Registro de flash_log (head = bloque abierto en rtc)
+    uint32_t index;              // Índice global de la próxima muestra
+} storage_cursor_t;
+
+esp_err_t storage_seek(uint64_t since_us, storage_cursor_t* cur);                   // Sitúa el cursor en la primera muestra con timestamp >= since_us
+size_t storage_read_next(storage_cursor_t* cur, nivometro_data_t* out, size_t max); // Copia hasta max muestras desde el cursor y lo avanza; 0 al final
@@ -1,34 +1,533 @@
 #include "storage.h"
-#include "nvs_flash.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "flash_log.h"
+#include "flash_log_index.h"
+#include "sample_codec.h"
 #include "nivometro_sensors.h"  
 
 static const char* TAG = "storage";                     // Etiqueta de logs para este módulo
-static nvs_handle_t nvs_handle_local;                   // Handle nvs
-static uint32_t record_index = 0;                       // Incrementar el índice para cada registro
+static flash_log_t sample_log;                          // Registro circular en la partición de muestras
+static SemaphoreHandle_t outbox_mutex;                  // Serializa productor (muestras) y consumidor (reenvío)
 
-void storage_init(void) {
-    // Inicializa la partición nvs
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        nvs_flash_erase();                              // Borra la partición si está llena o hay versión distinta
-        nvs_flash_init();                               // Reintenta inicializarla
+// Cada registro del log guarda un bloque comprimido (sample_codec v2) precedido del índice
+// global de su primera muestra: [u32 first_index][bloque]. El índice sigue creciendo entre
+// reinicios (se recupera del último registro), así que un hueco entre registros consecutivos
+// son muestras perdidas (sector sobrescrito o registro dañado).
+#define RECORD_INDEX_SIZE  4
+#define BLOCK_BYTES        (STORAGE_RECORD_SIZE - FLASH_LOG_RECORD_HEADER - RECORD_INDEX_SIZE)
+
+// Zona de staging en memoria rtc lenta: el bloque abierto junta muestras de muchos despertares
+// y solo se escribe en flash al llenarse (un registro de STORAGE_RECORD_SIZE, una página NOR).
+// RTC_NOINIT_ATTR también sobrevive a reinicios por software o watchdog; tras un arranque en
+// frío su contenido es basura, y el crc lo detecta.
+#define STAGING_MAGIC      0x47545352UL                 // "RSTG"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                                      // sizeof(staging_t): cambia con el firmware
+    uint32_t open_first;                                // Índice de la primera muestra del bloque abierto
+    uint32_t next_index;                                // Incluye bloques entregados sin pasar por flash
+    uint32_t pending_index;                             // Entregado hasta aquí (también a mitad de bloque)
+    sample_codec_block_t block;
+    storage_stats_t stats;
+    uint8_t data[BLOCK_BYTES];
+    uint32_t crc;                                       // crc32 de todo lo anterior
+} staging_t;
+
+static RTC_NOINIT_ATTR staging_t staging;
+
+static uint32_t next_index;                             // Índice de la próxima muestra
+static uint32_t pending_index;                          // Muestra sin entregar más antigua
+static uint32_t lost_samples = 0;                       // Muestras perdidas (sobrescritas o ilegibles)
+static uint8_t record_buf[FLASH_LOG_PAYLOAD_MAX];       // Lectura de registros (bajo outbox_mutex)
+static flash_log_index_t time_index;                    // Índice disperso por timestamp de bloque
+static flash_log_index_entry_t *time_index_entries;     // Una entrada por sector de la partición
+// Cabecera del último registro pendiente leído: un registro no cambia tras escribirse, así que
+// mientras su secuencia coincida no hace falta volver a leerlo
+static uint32_t pending_rec_seq = UINT32_MAX;
+static uint32_t pending_rec_first, pending_rec_count;
+
+_Static_assert(RECORD_INDEX_SIZE + BLOCK_BYTES <= FLASH_LOG_PAYLOAD_MAX, "el bloque no cabe en un registro de flash_log");
+
+static void put_index(uint8_t *p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get_index(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Clave del índice temporal: base_ts_us de la cabecera del bloque. Puede retroceder (corrección
+// sntp de un reloj adelantado, o vuelta a 1970 tras perder la alimentación): el pendiente más
+// antiguo se busca por secuencia y no le afecta, pero flash_log_index_seek da un resultado
+// aproximado alrededor del retroceso
+static bool record_key(const void *payload, size_t len, uint64_t *key) {
+    const uint8_t *p = (const uint8_t*)payload + RECORD_INDEX_SIZE;
+    if (len < RECORD_INDEX_SIZE + SAMPLE_CODEC_HEADER_SIZE || p[2] != SAMPLE_CODEC_SCHEMA_V2) return false;
+    *key = (uint64_t)get_index(p + 4) | ((uint64_t)get_index(p + 8) << 32);
+    return true;
+}
+
+// Posición de la primera muestra del bloque con timestamp >= since_us (count si no hay)
+static uint32_t find_in_block(const uint8_t *block, size_t len, uint32_t count, uint64_t since_us) {
+    nivometro_data_t chunk[8];
+    for (uint32_t off = 0; off < count; off += 8) {
+        int got = sample_codec_decode_range(block, len, off, chunk, 8);
+        if (got <= 0) break;
+        for (int i = 0; i < got; i++) {
+            if (chunk[i].timestamp_us >= since_us) return off + i;
+        }
+    }
+    return count;
+}
+
+static uint32_t staging_crc(void) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&staging, offsetof(staging_t, crc));
+}
+
+// Actualiza el crc tras cada cambio (bajo outbox_mutex o en el arranque)
+static void seal_staging(void) {
+    staging.next_index = next_index;
+    staging.pending_index = pending_index;
+    staging.crc = staging_crc();
+}
+
+// Recupera el bloque abierto del despertar anterior si la zona de staging es válida y
+// encaja con lo que hay en flash
+static void restore_staging(void) {
+    if (staging.magic != STAGING_MAGIC || staging.size != sizeof(staging) || staging.crc != staging_crc()) {
+        memset(&staging, 0, sizeof(staging));
+        staging.magic = STAGING_MAGIC;
+        staging.size = sizeof(staging);
+        ESP_LOGI(TAG, "RTC staging not valid (cold boot), starting empty");
+        return;
+    }
+
+    // next_index de flash no ve los bloques entregados que nunca se escribieron
+    staging.block.buf = staging.data;
+    if (staging.block.count > 0 && next_index >= staging.open_first + staging.block.count) {
+        staging.block.count = 0;                        // Ya en flash: corte entre la escritura y el sellado
+    } else if (staging.block.count > 0 && next_index > staging.open_first) {
+        staging.block.count = 0;                        // No encaja con flash (partición cambiada)
+        staging.stats.discarded++;
+    } else if (staging.block.count > 0) {
+        next_index = staging.open_first + staging.block.count;
+        staging.stats.restored++;
+    } else if (staging.next_index > next_index) {
+        next_index = staging.next_index;
+    }
+    if (staging.pending_index > pending_index && staging.pending_index <= next_index) {
+        pending_index = staging.pending_index;
+    }
+}
+
+// Lee el registro seq en record_buf; false si no se puede decodificar
+static bool read_record(uint32_t seq, uint32_t *first, uint32_t *count, size_t *len) {
+    *len = sizeof(record_buf);
+    if (flash_log_read(&sample_log, seq, record_buf, len) != ESP_OK ||
+        *len < RECORD_INDEX_SIZE + SAMPLE_CODEC_HEADER_SIZE ||
+        record_buf[RECORD_INDEX_SIZE + 2] != SAMPLE_CODEC_SCHEMA_V2) {
+        return false;
     }
-    nvs_open("storage", NVS_READWRITE, &nvs_handle_local);
+    *first = get_index(record_buf);
+    *count = record_buf[RECORD_INDEX_SIZE + 3];
+    return true;
 }
 
-void storage_buffer_data(const sensor_data_t* d) {
-    char key[16];
-    // Genera una clave única tipo rec0, rec1 para cada estructura
-    snprintf(key, sizeof(key), "rec%lu", (unsigned long)record_index++);
+// Recuerda la cabecera del registro pendiente más antiguo
+static void remember_pending(uint32_t seq, uint32_t first, uint32_t count) {
+    pending_rec_seq = seq;
+    pending_rec_first = first;
+    pending_rec_count = count;
+}
+
+// Descarta los registros ilegibles de la cabeza del log y salta las muestras que ya no están
+// en flash; devuelve false si el log no tiene registros pendientes
+static bool skip_lost(void) {
+    while (flash_log_pending(&sample_log) > 0) {
+        uint32_t seq = sample_log.first_pending, first, count;
+        size_t len;
+        if (!read_record(seq, &first, &count, &len)) {
+            ESP_LOGW(TAG, "Unreadable record %lu, discarded", (unsigned long)seq);
+            flash_log_consume(&sample_log, seq + 1);
+            continue;
+        }
+        if (first > pending_index) {
+            lost_samples += first - pending_index;
+            pending_index = first;
+        }
+        remember_pending(seq, first, count);
+        return true;
+    }
+    // Sin registros pendientes, lo no entregado solo puede estar en el bloque abierto
+    if (staging.block.count > 0 && staging.open_first > pending_index) {
+        lost_samples += staging.open_first - pending_index;
+        pending_index = staging.open_first;
+    } else if (staging.block.count == 0 && next_index > pending_index) {
+        lost_samples += next_index - pending_index;
+        pending_index = next_index;
+    }
+    return false;
+}
+
+// Escribe el bloque abierto como un registro del log (bajo outbox_mutex o en el arranque)
+static void flush_open(void) {
+    uint32_t seq, dropped = sample_log.stats.dropped;
+    size_t size = sample_codec_block_size(&staging.block);
+    if (staging.block.count == 0) return;
+    if (pending_index >= next_index) {
+        staging.stats.unflushed += staging.block.count;  // Ya entregado desde rtc: no se escribe
+        staging.block.count = 0;
+        return;
+    }
 
-    // Almacena el struct completo en nvs
-    esp_err_t err = nvs_set_blob(nvs_handle_local, key, d, sizeof(sensor_data_t));
+    put_index(record_buf, staging.open_first);
+    memcpy(record_buf + RECORD_INDEX_SIZE, staging.data, size);
+    // Al llenarse, flash_log sobrescribe el sector más antiguo (cuenta en stats.dropped)
+    esp_err_t err = flash_log_append(&sample_log, record_buf, RECORD_INDEX_SIZE + size, &seq);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error writtng to NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Error writing block %lu (%u samples): %s", (unsigned long)seq,
+                 (unsigned)staging.block.count, esp_err_to_name(err));
     } else {
-        ESP_LOGI(TAG, "Register saved %s", key);
-        nvs_commit(nvs_handle_local);                  // Confirma la escritura en memoria
+        ESP_LOGD(TAG, "Block %lu saved: %u samples in %u bytes", (unsigned long)seq,
+                 (unsigned)staging.block.count, (unsigned)size);
+        flash_log_index_note(&time_index, seq, staging.block.base_ts_us);
+        staging.stats.flushes++;
+        staging.stats.bytes_written += FLASH_LOG_RECORD_HEADER + RECORD_INDEX_SIZE + size;
+    }
+    staging.block.count = 0;
+    if (sample_log.stats.dropped != dropped) {
+        skip_lost();
+    }
+}
+
+// Añade una muestra al bloque abierto; si no cabe, el bloque va a flash y se empieza otro
+static void buffer_locked(const nivometro_data_t* d) {
+    staging.stats.staged++;
+    if (staging.block.count > 0 && pending_index < next_index && sample_codec_block_append(&staging.block, d)) {
+        next_index++;
+        return;
+    }
+    flush_open();
+    sample_codec_block_init(&staging.block, staging.data, sizeof(staging.data));
+    staging.open_first = next_index;
+    if (sample_codec_block_append(&staging.block, d)) {
+        next_index++;
+    }
+}
+
+// Recupera los índices del último registro escrito y del primero pendiente
+static void recover_indexes(void) {
+    uint32_t first, count;
+    size_t len;
+
+    next_index = 0;
+    for (uint32_t seq = sample_log.head; seq > sample_log.oldest; seq--) {
+        if (read_record(seq - 1, &first, &count, &len)) {
+            next_index = first + count;
+            break;
+        }
+    }
+    pending_index = next_index;
+    if (flash_log_pending(&sample_log) > 0) {
+        for (uint32_t seq = sample_log.first_pending; seq != sample_log.head; seq++) {
+            if (read_record(seq, &first, &count, &len)) {
+                pending_index = first;
+                remember_pending(seq, first, count);
+                break;
+            }
+        }
+    }
+}
+
+// Outbox de versiones anteriores: un blob nvs "rec<i % 2000>" por muestra e índices ob_head/ob_tail
+#define LEGACY_NAMESPACE   "storage"
+#define LEGACY_OUTBOX_MAX  2000
+
+// Pasa al log las muestras pendientes del outbox antiguo en nvs y libera sus claves
+static void migrate_nvs_outbox(void) {
+    nvs_handle_t h;
+    uint32_t head, tail;
+    uint32_t moved = 0;
+
+    if (nvs_open(LEGACY_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_get_u32(h, "ob_head", &head) != ESP_OK || nvs_get_u32(h, "ob_tail", &tail) != ESP_OK) {
+        nvs_close(h);
+        return;
+    }
+
+    if (head - tail <= LEGACY_OUTBOX_MAX) {
+        for (uint32_t i = tail; i != head; i++) {
+            char key[16];
+            nivometro_data_t d;
+            size_t len = sizeof(d);
+            snprintf(key, sizeof(key), "rec%lu", (unsigned long)(i % LEGACY_OUTBOX_MAX));
+            if (nvs_get_blob(h, key, &d, &len) == ESP_OK && len == sizeof(d)) {
+                buffer_locked(&d);
+                moved++;
+            }
+        }
+        flush_open();
+    }
+    nvs_erase_all(h);
+    nvs_commit(h);
+    nvs_close(h);
+    ESP_LOGI(TAG, "Migrated %lu of %lu records from the nvs outbox", (unsigned long)moved,
+             (unsigned long)(head - tail));
+}
+
+esp_err_t storage_init(void) {
+    flash_log_io_t io;
+
+    // Partición de datos dedicada (partitions.csv): nada de nvs para la serie temporal
+    esp_err_t err = flash_log_partition_io(STORAGE_PARTITION_LABEL, &io);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Partition '%s' not found", STORAGE_PARTITION_LABEL);
+        return err;
+    }
+
+    outbox_mutex = xSemaphoreCreateMutex();
+    if (!outbox_mutex) return ESP_ERR_NO_MEM;
+
+    // Recuperar el outbox pendiente de un arranque anterior con un recorrido de cabeceras
+    int64_t t0 = esp_timer_get_time();
+    err = flash_log_mount(&sample_log, &io, STORAGE_RECORD_SIZE);
+    if (err != ESP_OK) return err;
+    if (!time_index_entries) {
+        time_index_entries = calloc(sample_log.sectors, sizeof(flash_log_index_entry_t));
+        if (!time_index_entries) return ESP_ERR_NO_MEM;
+    }
+    flash_log_index_init(&time_index, &sample_log, record_key, time_index_entries, sample_log.sectors);
+    recover_indexes();
+    restore_staging();
+    migrate_nvs_outbox();
+    seal_staging();
+    ESP_LOGI(TAG, "Outbox: %lu pending samples in %lu blocks + %u staged in rtc (capacity %lu blocks), mounted in %lu us with %lu reads",
+             (unsigned long)(next_index - pending_index), (unsigned long)flash_log_pending(&sample_log),
+             (unsigned)staging.block.count,
+             (unsigned long)flash_log_capacity(&sample_log),
+             (unsigned long)(esp_timer_get_time() - t0), (unsigned long)sample_log.stats.mount_reads);
+    uint64_t oldest_us;
+    if (storage_outbox_oldest(&oldest_us)) {
+        ESP_LOGI(TAG, "Oldest pending sample at %llu us", (unsigned long long)oldest_us);
+    }
+    return ESP_OK;
+}
+
+void storage_buffer_data(const nivometro_data_t* d) {
+    if (!d || !outbox_mutex) return;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    buffer_locked(d);
+    seal_staging();
+    xSemaphoreGive(outbox_mutex);
+}
+
+void storage_flush(void) {
+    if (!outbox_mutex) return;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    flush_open();
+    seal_staging();
+    xSemaphoreGive(outbox_mutex);
+}
+
+size_t storage_outbox_count(void) {
+    if (!outbox_mutex) return 0;
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    size_t count = next_index - pending_index;
+    xSemaphoreGive(outbox_mutex);
+    return count;
+}
+
+size_t storage_outbox_peek(nivometro_data_t* out, size_t max, uint32_t* first) {
+    size_t n = 0;
+    if (!out || !first || !outbox_mutex) return 0;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    skip_lost();
+    *first = pending_index;
+
+    // Bloques en flash y después el bloque abierto; siempre muestras consecutivas
+    uint32_t index = pending_index;
+    for (uint32_t seq = sample_log.first_pending; seq != sample_log.head && n < max; seq++) {
+        uint32_t rec_first, count;
+        size_t len;
+        if (!read_record(seq, &rec_first, &count, &len) || rec_first > index) {
+            break;                                      // Dañado o con hueco: lo trata skip_lost en la próxima
+        }
+        if (rec_first + count <= index) continue;       // Entregado del todo (ack parcial del siguiente)
+        int got = sample_codec_decode_range(record_buf + RECORD_INDEX_SIZE, len - RECORD_INDEX_SIZE,
+                                            index - rec_first, &out[n], max - n);
+        if (got <= 0) break;
+        n += got;
+        index += got;
+    }
+    if (n < max && staging.block.count > 0 && index >= staging.open_first && index < next_index) {
+        int got = sample_codec_decode_range(staging.data, sample_codec_block_size(&staging.block),
+                                            index - staging.open_first, &out[n], max - n);
+        if (got > 0) n += got;
+    }
+    seal_staging();                                     // skip_lost puede haber movido pending_index
+    xSemaphoreGive(outbox_mutex);
+    return n;
+}
+
+void storage_outbox_ack(uint32_t first, size_t n) {
+    if (!outbox_mutex) return;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    // Si mientras tanto se sobrescribieron bloques, pending_index ya puede estar más allá
+    uint32_t end = first + n;
+    if (end > next_index) end = next_index;
+    if (end > pending_index) {
+        staging.stats.delivered += end - pending_index;
+        pending_index = end;
+    }
+
+    // Se marcan en sitio (bits 1 -> 0, sin borrar) los bloques entregados del todo; uno
+    // entregado a medias sigue pendiente en flash y tras un reinicio se reenvía entero
+    uint32_t seq = sample_log.first_pending;
+    for (; seq != sample_log.head; seq++) {
+        uint32_t rec_first, count;
+        size_t len;
+        if (!read_record(seq, &rec_first, &count, &len) || rec_first + count > pending_index) break;
     }
+    esp_err_t err = flash_log_consume(&sample_log, seq);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error marking blocks up to %lu: %s", (unsigned long)seq, esp_err_to_name(err));
+    }
+    seal_staging();
+    xSemaphoreGive(outbox_mutex);
+}
+
+bool storage_outbox_oldest(uint64_t* ts_us) {
+    nivometro_data_t d;
+    uint32_t seq, first, count;
+    uint64_t key;
+    size_t len;
+    bool found = false;
+    if (!ts_us || !outbox_mutex) return false;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    // Registro pendiente legible más antiguo según el índice; su clave es el timestamp de su primera
+    // muestra. Su cabecera suele estar ya leída (skip_lost, arranque): con el índice caliente no se
+    // lee flash, salvo que el bloque se entregara a medias y haya que decodificarlo
+    bool in_log = flash_log_index_oldest_pending(&time_index, &seq, &key) == ESP_OK;
+    if (in_log && seq != pending_rec_seq) {
+        in_log = read_record(seq, &first, &count, &len);
+        if (in_log) remember_pending(seq, first, count);
+    }
+    if (in_log && pending_index < pending_rec_first + pending_rec_count) {
+        found = true;
+        if (pending_index > pending_rec_first) {
+            found = read_record(seq, &first, &count, &len) &&
+                    sample_codec_decode_range(record_buf + RECORD_INDEX_SIZE, len - RECORD_INDEX_SIZE,
+                                              pending_index - first, &d, 1) == 1;
+            if (found) key = d.timestamp_us;
+        }
+    } else if (staging.block.count > 0 && pending_index < next_index) {
+        // Nada pendiente en flash (lo normal en ciclo con deep sleep): el bloque abierto en rtc
+        uint32_t from = pending_index > staging.open_first ? pending_index : staging.open_first;
+        found = sample_codec_decode_range(staging.data, sample_codec_block_size(&staging.block),
+                                          from - staging.open_first, &d, 1) == 1;
+        if (found) key = d.timestamp_us;
+    }
+    xSemaphoreGive(outbox_mutex);
+    if (found) *ts_us = key;
+    return found;
+}
+
+esp_err_t storage_seek(uint64_t since_us, storage_cursor_t* cur) {
+    uint32_t seq, first, count;
+    size_t len;
+    if (!cur || !outbox_mutex) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    // Primer bloque que empieza en since_us o después; el anterior puede acabar después de since_us
+    esp_err_t err = flash_log_index_seek(&time_index, since_us, &seq);
+    if (err != ESP_OK) {
+        xSemaphoreGive(outbox_mutex);
+        return err;
+    }
+    cur->seq = seq;
+    cur->index = 0;                                     // read_next lo sube al primer índice del registro
+    if (seq > sample_log.oldest && read_record(seq - 1, &first, &count, &len)) {
+        uint32_t off = find_in_block(record_buf + RECORD_INDEX_SIZE, len - RECORD_INDEX_SIZE, count, since_us);
+        if (off < count) {
+            cur->seq = seq - 1;
+            cur->index = first + off;
+        }
+    }
+    if (cur->seq == sample_log.head) {
+        // Nada en flash: queda el bloque abierto en rtc
+        cur->index = next_index;
+        if (staging.block.count > 0) {
+            cur->index = staging.open_first + find_in_block(staging.data, sample_codec_block_size(&staging.block),
+                                                             staging.block.count, since_us);
+        }
+    }
+    xSemaphoreGive(outbox_mutex);
+    return ESP_OK;
+}
+
+size_t storage_read_next(storage_cursor_t* cur, nivometro_data_t* out, size_t max) {
+    size_t n = 0;
+    if (!cur || !out || !outbox_mutex) return 0;
+
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    while (n < max) {
+        uint32_t first, count;
+        size_t len;
+        if (cur->seq < sample_log.oldest) cur->seq = sample_log.oldest;     // Sobrescrito mientras tanto
+        if (cur->seq == sample_log.head) {
+            if (staging.block.count > 0 && cur->index < next_index) {
+                if (cur->index < staging.open_first) cur->index = staging.open_first;
+                int got = sample_codec_decode_range(staging.data, sample_codec_block_size(&staging.block),
+                                                    cur->index - staging.open_first, &out[n], max - n);
+                if (got > 0) {
+                    n += got;
+                    cur->index += got;
+                }
+            }
+            break;
+        }
+        if (!read_record(cur->seq, &first, &count, &len) || first + count <= cur->index) {
+            cur->seq++;                                 // Ilegible o ya leído
+            continue;
+        }
+        if (cur->index < first) cur->index = first;
+        int got = sample_codec_decode_range(record_buf + RECORD_INDEX_SIZE, len - RECORD_INDEX_SIZE,
+                                            cur->index - first, &out[n], max - n);
+        if (got <= 0) {
+            cur->seq++;
+            continue;
+        }
+        n += got;
+        cur->index += got;
+        if (cur->index >= first + count) cur->seq++;
+    }
+    xSemaphoreGive(outbox_mutex);
+    return n;
+}
+
+uint32_t storage_outbox_dropped(void) {
+    return lost_samples;
+}
+
+void storage_get_stats(storage_stats_t* out) {
+    if (!out || !outbox_mutex) return;
+    xSemaphoreTake(outbox_mutex, portMAX_DELAY);
+    *out = staging.stats;
+    xSemaphoreGive(outbox_mutex);
 }
@@ -1,3 +1,7 @@
 #pragma once                    // Le indica al compilador que procese este fichero solo una vez por compilacion
 
-void tasks_start_all(void);     // Crea y lanza todas las tareas de freertos (sensores, publicación, etc.)  
+#include "nivometro_sensors.h"
+
+// Crea y lanza la tarea del ciclo con deep sleep: muestrea en cada despertar, guarda en el outbox
+// y solo enciende la radio cada K despertares (power_manager) o ante un cambio urgente
+void tasks_start_all(nivometro_t* nivometro);
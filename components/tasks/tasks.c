@@ -4,67 +4,158 @@
 #include "communication.h"
 #include "power_manager.h"
 #include "utils.h"
+#include "change_detector.h"
+#include "diagnostics.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "esp_log.h"
+#include <math.h>
 #include <stdbool.h>
 
 static const char* TAG = "tasks";                       // Etiqueta de logs para este módulo
-static QueueHandle_t data_queue;                        // Cola para pasar datos del sensor a la tarea de publicación
-
-// Parámetros de la tarea de lectura de sensores
-#define SENSOR_TASK_STACK    2048
-#define SENSOR_TASK_PRI      (tskIDLE_PRIORITY + 2)
-#define SENSOR_PERIOD_MS     60000                      // Intervalo de lectura: 60 000 ms (1 min)
-
-// Parámetros de la tarea de publicación
-#define PUBLISH_TASK_STACK   4096
-#define PUBLISH_TASK_PRI     (tskIDLE_PRIORITY + 1)
-
-static void sensor_task(void* _) {
-    sensor_data_t d;
-    for (;;) {
-        d = sensors_read_all();                         // Leer ultrasonido, peso y láser
-        if (xQueueSend(data_queue, &d, 0) != pdTRUE) {
-            ESP_LOGW(TAG, "sensor_task: queue full, dropping sample");
+
+// Parámetros de la tarea del ciclo (lectura + subida + deep sleep)
+#define CYCLE_TASK_STACK     4096
+#define CYCLE_TASK_PRI       (tskIDLE_PRIORITY + 2)
+
+// Sesión de radio
+#define UPLINK_MQTT_TIMEOUT_MS   10000                  // Espera máxima del broker tras el wifi
+#define UPLINK_WINDOW_BATCHES    4                      // Lotes publicados antes de esperar sus PUBACK
+#define UPLINK_DRAIN_TIMEOUT_MS  5000                   // Espera máxima de confirmaciones antes de dormir
+#define UPLINK_SESSION_MAX_MS    60000                  // Duración máxima de la sesión; el resto queda para la siguiente
+
+// Umbrales que fuerzan la subida aunque no toque por K
+#define URGENT_DEPTH_DELTA_CM    5.0f                   // Cambio de distancia a la nieve desde lo último subido
+#define URGENT_BATTERY_V         3.3f                   // Batería baja
+
+static RTC_DATA_ATTR nivometro_data_t last_reported;    // Muestra más reciente entregada al broker
+static RTC_DATA_ATTR bool last_reported_valid = false;
+static RTC_DATA_ATTR change_detector_t detector;        // Informe por excepción: referencia y contadores entre despertares
+static RTC_DATA_ATTR bool detector_ready = false;
+
+static nivometro_t* nivometro_ref;                      // Nivómetro inicializado por app_main
+
+// Cambios que no deben esperar a la siguiente subida programada
+static bool is_urgent(const nivometro_data_t* d) {
+    if (!last_reported_valid) return false;
+    if (d->sensor_status != last_reported.sensor_status) return true;
+    if (d->battery_voltage < URGENT_BATTERY_V) return true;
+    return fabsf(d->ultrasonic_distance_cm - last_reported.ultrasonic_distance_cm) >= URGENT_DEPTH_DELTA_CM;
+}
+
+// Vacía el outbox hasta el plazo: publica una ventana de lotes seguidos, espera sus PUBACK
+// y retira del outbox el prefijo confirmado; devuelve las muestras entregadas
+static uint32_t drain_outbox(int64_t deadline_us) {
+    static nivometro_data_t window[UPLINK_WINDOW_BATCHES * COMM_BATCH_MAX];
+    int msg_ids[UPLINK_WINDOW_BATCHES];
+    uint32_t delivered = 0;
+
+    while (storage_outbox_count() > 0 && esp_timer_get_time() < deadline_us) {
+        uint32_t first;
+        size_t n = storage_outbox_peek(window, sizeof(window) / sizeof(window[0]), &first);
+        if (n == 0) break;
+
+        // Sin esperar cada PUBACK: un viaje de ida y vuelta por ventana en lugar de por lote
+        size_t batches = 0;
+        for (size_t off = 0; off < n && batches < UPLINK_WINDOW_BATCHES; off += COMM_BATCH_MAX) {
+            size_t len = n - off < COMM_BATCH_MAX ? n - off : COMM_BATCH_MAX;
+            msg_ids[batches] = communication_publish_batch_binary(&window[off], len);
+            if (msg_ids[batches] < 0) break;
+            batches++;
+        }
+
+        int64_t remaining_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        communication_wait_all_published(remaining_ms > 0 ? (uint32_t)remaining_ms : 0);
+
+        // Solo el prefijo confirmado sale del outbox, para conservar el orden
+        size_t acked = 0;
+        for (size_t i = 0; i < batches && communication_wait_published(msg_ids[i], 0); i++) {
+            acked += n - acked < COMM_BATCH_MAX ? n - acked : COMM_BATCH_MAX;
+        }
+        if (acked > 0) {
+            storage_outbox_ack(first, acked);
+            delivered += acked;
+            last_reported = window[acked - 1];
+            last_reported_valid = true;
+        }
+        if (acked < n) {
+            ESP_LOGW(TAG, "%u of %u samples unconfirmed, keeping them for next uplink",
+                     (unsigned)(n - acked), (unsigned)n);
+            break;
         }
-        ESP_LOGI(TAG, "Read: %.2f cm, %.2f kg, %.2f mm",
-                 d.distance_cm, d.weight_kg, d.laser_mm);
-        vTaskDelay(pdMS_TO_TICKS(SENSOR_PERIOD_MS));    // Espera el siguiente ciclo
     }
+    return delivered;
 }
 
-static void publish_task(void* _) {
-    sensor_data_t d;
-
-    for (;;) {
-        // Bloquea hasta recibir un dato de sensor
-        if (xQueueReceive(data_queue, &d, portMAX_DELAY) == pdTRUE) {
-            storage_buffer_data(&d);               // Guardar localmente en nvs
-            communication_wait_for_connection();   // Asegurar conexión wifi + mqtt
-            communication_publish(&d);             // Enviar los datos al broker
-            vTaskDelay(pdMS_TO_TICKS(200));        // Pausa tras publicar
-            ESP_LOGI(TAG, "Entering deep sleep for 30 seconds");
-            power_manager_enter_deep_sleep();      // Poner el esp32 en deep sleep
+static void cycle_task(void* _) {
+    nivometro_data_t d;
+    bool urgent = false;
+    bool battery_low = false;
+
+    if (!detector_ready) {
+        change_detector_init(&detector, NULL);
+        detector_ready = true;
+    }
+
+    // Muestrear siempre; al outbox solo lo que el detector de cambios deja pasar
+    esp_err_t read_err = nivometro_read_all_sensors(nivometro_ref, &d);
+    if (read_err != ESP_OK) {
+        diagnostics_log_error(TAG, read_err, "sensor read");
+    } else {
+        change_reason_t reason = change_detector_check(&detector, &d);
+        if (reason != CHANGE_SUPPRESSED) {
+            storage_buffer_data(&d);
         }
+        urgent = is_urgent(&d);
+        battery_low = d.battery_voltage < URGENT_BATTERY_V;
+        ESP_LOGI(TAG, "Read: %.2f cm, %.2f g, %.0f mm (%s, %lu/%lu suppressed)",
+                 d.ultrasonic_distance_cm, d.weight_grams, d.laser_distance_mm,
+                 change_detector_reason_string(reason),
+                 (unsigned long)detector.stats.suppressed, (unsigned long)detector.stats.seen);
     }
-}
 
+    // Encender la radio solo cada K despertares o ante un cambio urgente, y si hay algo que subir
+    bool due = power_manager_uplink_due(urgent);
+    if (due && storage_outbox_count() == 0) {
+        ESP_LOGI(TAG, "Outbox empty, radio stays off");
+    } else if (due) {
+        int64_t t0 = esp_timer_get_time();
+        uint32_t delivered = 0;
 
-void tasks_start_all(void) {
-    // Crear la cola con capacidad para 10 muestras de sensor_data_t
-    data_queue = xQueueCreate(10, sizeof(sensor_data_t));
-    if (!data_queue) {
-        ESP_LOGE(TAG, "tasks_start_all: failed to create queue");
-        return;
+        if (communication_init() == ESP_OK && communication_wait_connected(UPLINK_MQTT_TIMEOUT_MS)) {
+            delivered = drain_outbox(t0 + (int64_t)UPLINK_SESSION_MAX_MS * 1000);
+            // Compuerta antes de dormir: ningún mensaje QoS1 queda sin PUBACK salvo que venza el plazo
+            communication_wait_all_published(UPLINK_DRAIN_TIMEOUT_MS);
+            storage_stats_t st;
+            storage_get_stats(&st);
+            ESP_LOGI(TAG, "Delivered %lu samples, final drain %lu ms, flash %lu blocks / %.1f B per delivered sample",
+                     (unsigned long)delivered, (unsigned long)communication_last_drain_ms(), (unsigned long)st.flushes,
+                     st.delivered ? (double)st.bytes_written / st.delivered : 0.0);
+        } else {
+            ESP_LOGW(TAG, "No uplink this wake, %u samples stay in the outbox",
+                     (unsigned)storage_outbox_count());
+            diagnostics_log_error(TAG, ESP_ERR_TIMEOUT, "no uplink");
+        }
+        power_manager_uplink_done((uint32_t)((esp_timer_get_time() - t0) / 1000), delivered);
     }
 
-    // Lanzar la tarea de lectura de sensores
-    xTaskCreate(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL, SENSOR_TASK_PRI, NULL);
+    // El bloque abierto sigue en memoria rtc durante el deep sleep; con la batería baja
+    // un corte es probable y se pasa a flash
+    if (battery_low) storage_flush();
+    // Los diagnósticos también quedan en rtc; a nvs solo por lotes o con la batería baja
+    diagnostics_flush(battery_low);
+    power_manager_enter_deep_sleep();                  // Poner el esp32 en deep sleep
+    vTaskDelete(NULL);
+}
+
+
+void tasks_start_all(nivometro_t* nivometro) {
+    nivometro_ref = nivometro;
 
-    // Lanzar la tarea de publicación y gestión de energía
-    xTaskCreate(publish_task, "publish_task", PUBLISH_TASK_STACK, NULL, PUBLISH_TASK_PRI, NULL);
+    // Lanzar la tarea del ciclo de lectura, subida y gestión de energía
+    xTaskCreate(cycle_task, "cycle_task", CYCLE_TASK_STACK, NULL, CYCLE_TASK_PRI, NULL);
 
     ESP_LOGI(TAG, "tasks_start_all: all tasks started");
 }
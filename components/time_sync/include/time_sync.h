@@ -0,0 +1,77 @@
+// time_sync.h
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIME_SYNC_DEFAULT_INTERVAL_S   (6 * 3600)   // Resincronización por defecto
+#define TIME_SYNC_MIN_INTERVAL_S       3600         // Límites del intervalo adaptado a la deriva medida
+#define TIME_SYNC_MAX_INTERVAL_S       (24 * 3600)
+#define TIME_SYNC_MAX_DRIFT_MS         500          // Error máximo tolerado entre sincronizaciones
+#define TIME_SYNC_MIN_EPOCH_S          1704067200   // 2024-01-01: por debajo la hora no es real
+
+// Estado de la base de tiempo (en memoria rtc, sobrevive al deep sleep)
+typedef struct {
+    bool valid;                  // La hora del sistema es UTC real
+    int64_t last_sync_utc_us;    // Instante de la última sincronización
+    int32_t drift_ppm;           // Deriva medida del reloj rtc
+    int32_t last_error_ms;       // Corrección aplicada en la última sincronización
+    uint32_t interval_s;         // Intervalo de resincronización vigente
+    uint32_t syncs;              // Sincronizaciones completadas
+} time_sync_status_t;
+
+/**
+ * @brief Recupera la base de tiempo conservada en memoria rtc
+ * La hora del sistema sigue corriendo durante el deep sleep, así que tras un despertar
+ * ya es UTC sin esperar a la red. Tras un arranque en frío queda inválida hasta sincronizar.
+ */
+void time_sync_init(void);
+
+/**
+ * @brief Lanza una sincronización sntp en segundo plano si hace falta
+ * Hace falta si nunca se sincronizó o ha vencido el intervalo. No bloquea.
+ * @return true si se lanzó (o ya había una en curso)
+ */
+bool time_sync_start(void);
+
+/**
+ * @brief Espera acotada a que termine la sincronización en curso
+ * @param timeout_ms Espera máxima
+ * @return true si la hora es válida al volver
+ */
+bool time_sync_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Indica si la hora del sistema es UTC real
+ */
+bool time_sync_is_valid(void);
+
+/**
+ * @brief Hora UTC actual en microsegundos desde epoch
+ * Antes de la primera sincronización cuenta desde 1970 (ver time_sync_is_valid())
+ */
+uint64_t time_sync_now_us(void);
+
+/**
+ * @brief Indica si una marca de tiempo de time_sync_now_us() es UTC real
+ * Las tomadas antes de la primera sincronización tras un arranque en frío cuentan desde 1970.
+ */
+bool time_sync_timestamp_valid(uint64_t timestamp_us);
+
+/**
+ * @brief Lleva a UTC una marca de tiempo tomada antes de la primera sincronización
+ * Al sincronizar tras un arranque en frío se guarda el salto del reloj; sumándolo, las muestras
+ * sacadas antes (bus, lote u outbox) se publican con su hora real.
+ * @param timestamp_us Marca de tiempo de time_sync_now_us()
+ * @return La marca en UTC, o la original si ya lo era o todavía no se ha sincronizado
+ *         (comprobar con time_sync_timestamp_valid())
+ */
+uint64_t time_sync_correct_us(uint64_t timestamp_us);
+
+/**
+ * @brief Copia el estado de la base de tiempo
+ */
+void time_sync_get_status(time_sync_status_t *out);
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,166 @@
+// time_sync.c
+#include "time_sync.h"
+#include <stdlib.h>
+#include <sys/time.h>
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "TIME_SYNC";
+
+#define TIME_SYNC_MAGIC        0x54494D45                // "TIME"
+#define TIME_SYNC_SERVER       "pool.ntp.org"
+#define TIME_SYNC_MIN_DRIFT_WINDOW_US (600LL * 1000000)  // Ventana mínima para estimar deriva
+
+// Base de tiempo conservada durante el deep sleep
+typedef struct {
+    uint32_t magic;
+    time_sync_status_t status;
+    bool boot_offset_valid;                              // Se conoce el salto de la primera sincronización
+    int64_t boot_offset_us;                              // UTC - reloj sin sincronizar (desde 1970)
+} time_sync_rtc_t;
+
+static RTC_DATA_ATTR time_sync_rtc_t rtc_time;
+
+// Hora local en la última referencia (lanzamiento de sntp o sincronización anterior) y esp_timer
+// en ese instante: la predicción de la hora local al sincronizar, para medir el error
+static int64_t start_sys_us;
+static int64_t start_timer_us;
+static volatile bool sync_done = false;                  // Lo marca el callback; sntp se para fuera de él
+
+static int64_t system_time_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool sync_needed(void) {
+    if (!time_sync_is_valid()) return true;
+    int64_t since_sync = system_time_us() - rtc_time.status.last_sync_utc_us;
+    return since_sync < 0 || since_sync >= (int64_t)rtc_time.status.interval_s * 1000000;
+}
+
+// Llamada por lwip al fijar la hora: mide la corrección y adapta el intervalo a la deriva
+static void on_time_sync(struct timeval *tv) {
+    time_sync_status_t *st = &rtc_time.status;
+    int64_t actual_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    int64_t now_timer_us = esp_timer_get_time();
+    int64_t predicted_us = start_sys_us + (now_timer_us - start_timer_us);
+
+    // Primera sincronización con el reloj en 1970: guardar el salto para corregir las muestras previas
+    if (predicted_us < (int64_t)TIME_SYNC_MIN_EPOCH_S * 1000000) {
+        rtc_time.boot_offset_us = actual_us - predicted_us;
+        rtc_time.boot_offset_valid = true;
+    }
+
+    if (st->valid) {
+        int64_t error_us = actual_us - predicted_us;
+        int64_t window_us = actual_us - st->last_sync_utc_us;
+        st->last_error_ms = (int32_t)(error_us / 1000);
+
+        if (window_us >= TIME_SYNC_MIN_DRIFT_WINDOW_US) {
+            st->drift_ppm = (int32_t)(error_us * 1000000 / window_us);
+            // Intervalo tal que la deriva acumulada no supere TIME_SYNC_MAX_DRIFT_MS
+            uint32_t interval_s = TIME_SYNC_MAX_INTERVAL_S;
+            if (st->drift_ppm != 0) {
+                int64_t s = (int64_t)TIME_SYNC_MAX_DRIFT_MS * 1000 / abs(st->drift_ppm);
+                if (s < interval_s) interval_s = (uint32_t)s;
+            }
+            if (interval_s < TIME_SYNC_MIN_INTERVAL_S) interval_s = TIME_SYNC_MIN_INTERVAL_S;
+            st->interval_s = interval_s;
+        }
+    }
+
+    st->valid = true;
+    st->last_sync_utc_us = actual_us;
+    st->syncs++;
+    rtc_time.magic = TIME_SYNC_MAGIC;
+
+    // Con el sondeo sntp activo llegan más sincronizaciones: medir cada una frente a la anterior
+    start_sys_us = actual_us;
+    start_timer_us = now_timer_us;
+
+    ESP_LOGI(TAG, "Hora sincronizada: corrección %ld ms, deriva %ld ppm, próxima en %lu s",
+             (long)st->last_error_ms, (long)st->drift_ppm, (unsigned long)st->interval_s);
+
+    // El callback corre en la tarea tcpip: sntp se detiene desde time_sync_start()/time_sync_wait()
+    sync_done = true;
+}
+
+// No mantener el sondeo sntp activo tras sincronizar: la siguiente la pide time_sync_start()
+static void stop_if_done(void) {
+    if (sync_done && esp_sntp_enabled()) {
+        esp_sntp_stop();
+    }
+}
+
+void time_sync_init(void) {
+    if (rtc_time.magic != TIME_SYNC_MAGIC) {
+        // Arranque en frío: memoria rtc sin inicializar
+        rtc_time.magic = TIME_SYNC_MAGIC;
+        rtc_time.status = (time_sync_status_t){ .interval_s = TIME_SYNC_DEFAULT_INTERVAL_S };
+        rtc_time.boot_offset_valid = false;
+    }
+    // Tras una pérdida de alimentación el reloj vuelve a 1970 aunque la rtc diga lo contrario
+    // (y el salto de la sincronización anterior ya no vale para las muestras nuevas)
+    if (system_time_us() / 1000000 < TIME_SYNC_MIN_EPOCH_S) {
+        rtc_time.status.valid = false;
+        rtc_time.boot_offset_valid = false;
+    }
+    ESP_LOGI(TAG, "Base de tiempo %s, %lu sincronizaciones",
+             rtc_time.status.valid ? "válida" : "sin sincronizar",
+             (unsigned long)rtc_time.status.syncs);
+}
+
+bool time_sync_start(void) {
+    stop_if_done();
+    if (esp_sntp_enabled()) return true;
+    if (!sync_needed()) return false;
+
+    sync_done = false;
+    start_sys_us = system_time_us();
+    start_timer_us = esp_timer_get_time();
+
+    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, TIME_SYNC_SERVER);
+    sntp_set_time_sync_notification_cb(on_time_sync);
+    esp_sntp_init();
+    ESP_LOGI(TAG, "Sincronización sntp lanzada");
+    return true;
+}
+
+bool time_sync_wait(uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while (esp_sntp_enabled() && !sync_done && xTaskGetTickCount() - start < pdMS_TO_TICKS(timeout_ms)) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    stop_if_done();
+    return time_sync_is_valid();
+}
+
+bool time_sync_is_valid(void) {
+    return rtc_time.magic == TIME_SYNC_MAGIC && rtc_time.status.valid;
+}
+
+uint64_t time_sync_now_us(void) {
+    return (uint64_t)system_time_us();
+}
+
+bool time_sync_timestamp_valid(uint64_t timestamp_us) {
+    return timestamp_us >= (uint64_t)TIME_SYNC_MIN_EPOCH_S * 1000000;
+}
+
+uint64_t time_sync_correct_us(uint64_t timestamp_us) {
+    if (time_sync_timestamp_valid(timestamp_us) || rtc_time.magic != TIME_SYNC_MAGIC ||
+        !rtc_time.boot_offset_valid) {
+        return timestamp_us;
+    }
+    return timestamp_us + (uint64_t)rtc_time.boot_offset_us;
+}
+
+void time_sync_get_status(time_sync_status_t *out) {
+    if (out) *out = rtc_time.status;
+}
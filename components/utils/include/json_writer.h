@@ -0,0 +1,44 @@
+#pragma once                               // Le indica al compilador que procese este fichero solo una vez por compilacion
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Serializador json sin memoria dinámica ni formateo de float de libc.
+ * Escribe directamente en el buffer del llamante; los números decimales se
+ * escriben en coma fija con los decimales pedidos (redondeo al más cercano).
+ * Si el buffer se llena, el writer queda en overflow, deja de escribir y
+ * json_writer_finish() devuelve -1.
+ *
+ *   json_writer_t w;
+ *   json_writer_init(&w, buf, sizeof(buf));
+ *   json_obj_begin(&w, NULL);
+ *   json_write_fixed(&w, "distance_cm", 123.456f, 2);   // "distance_cm":123.46
+ *   json_obj_end(&w);
+ *   int len = json_writer_finish(&w);
+ */
+
+typedef struct {
+    char *buf;          // Buffer de salida
+    size_t size;        // Capacidad total (incluido el terminador)
+    size_t len;         // Bytes escritos
+    bool need_comma;    // El siguiente elemento va precedido de ','
+    bool overflow;      // Se intentó escribir más de lo que cabe
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size);     // Prepara el writer sobre buf
+int json_writer_finish(json_writer_t *w);                            // Termina en '\0'; devuelve longitud o -1 si hubo overflow
+
+// Contenedores; key = NULL dentro de arrays o para el objeto raíz
+void json_obj_begin(json_writer_t *w, const char *key);
+void json_obj_end(json_writer_t *w);
+void json_arr_begin(json_writer_t *w, const char *key);
+void json_arr_end(json_writer_t *w);
+
+// Valores; key = NULL para elementos de array
+void json_write_uint(json_writer_t *w, const char *key, uint64_t value);
+void json_write_int(json_writer_t *w, const char *key, int64_t value);
+void json_write_fixed(json_writer_t *w, const char *key, float value, uint8_t decimals);  // NaN/inf -> null, máx. 6 decimales
+void json_write_bool(json_writer_t *w, const char *key, bool value);
+void json_write_str(json_writer_t *w, const char *key, const char *value);               // Escapa '"', '\' y controles
@@ -0,0 +1,181 @@
+#include "json_writer.h"
+#include <math.h>
+
+#define JSON_FIXED_MAX_DECIMALS 6
+
+static const uint32_t pow10_table[JSON_FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+static void put_char(json_writer_t *w, char c)
+{
+    // Reserva siempre un byte para el terminador
+    if (w->len + 1 >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+static void put_raw(json_writer_t *w, const char *s)
+{
+    while (*s && !w->overflow) put_char(w, *s++);
+}
+
+static void put_uint(json_writer_t *w, uint64_t v)
+{
+    // Dígitos en orden inverso en un buffer local (uint64 cabe en 20)
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) put_char(w, tmp[--n]);
+}
+
+static void put_string(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    for (; *s && !w->overflow; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            put_char(w, '\\');
+            put_char(w, (char)c);
+        } else if (c < 0x20) {
+            put_raw(w, "\\u00");
+            put_char(w, hex[c >> 4]);
+            put_char(w, hex[c & 0x0F]);
+        } else {
+            put_char(w, (char)c);
+        }
+    }
+    put_char(w, '"');
+}
+
+// Separador y clave de cada elemento
+static void put_prefix(json_writer_t *w, const char *key)
+{
+    if (w->need_comma) put_char(w, ',');
+    if (key) {
+        put_string(w, key);
+        put_char(w, ':');
+    }
+    w->need_comma = true;
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = (buf == NULL || size == 0);
+    if (!w->overflow) buf[0] = '\0';
+}
+
+int json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow) {
+        if (w->buf && w->size) w->buf[0] = '\0';
+        return -1;
+    }
+    w->buf[w->len] = '\0';
+    return (int)w->len;
+}
+
+void json_obj_begin(json_writer_t *w, const char *key)
+{
+    put_prefix(w, key);
+    put_char(w, '{');
+    w->need_comma = false;
+}
+
+void json_obj_end(json_writer_t *w)
+{
+    put_char(w, '}');
+    w->need_comma = true;
+}
+
+void json_arr_begin(json_writer_t *w, const char *key)
+{
+    put_prefix(w, key);
+    put_char(w, '[');
+    w->need_comma = false;
+}
+
+void json_arr_end(json_writer_t *w)
+{
+    put_char(w, ']');
+    w->need_comma = true;
+}
+
+void json_write_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    put_prefix(w, key);
+    put_uint(w, value);
+}
+
+void json_write_int(json_writer_t *w, const char *key, int64_t value)
+{
+    put_prefix(w, key);
+    if (value < 0) {
+        put_char(w, '-');
+        put_uint(w, (uint64_t)0 - (uint64_t)value);
+    } else {
+        put_uint(w, (uint64_t)value);
+    }
+}
+
+void json_write_fixed(json_writer_t *w, const char *key, float value, uint8_t decimals)
+{
+    put_prefix(w, key);
+    if (!isfinite(value)) {
+        put_raw(w, "null");
+        return;
+    }
+    if (decimals > JSON_FIXED_MAX_DECIMALS) decimals = JSON_FIXED_MAX_DECIMALS;
+
+    // Parte entera y fraccionaria por separado, solo con float (el esp32 no tiene fpu de doble precisión):
+    // restar la parte entera truncada es exacto y la fracción escalada (< 10^6) cabe en la mantisa
+    float mag = fabsf(value);
+    if (mag >= 1.8e19f) {
+        put_raw(w, "null");
+        return;
+    }
+    uint32_t scale = pow10_table[decimals];
+    uint64_t int_part = (uint64_t)mag;
+    uint32_t frac_part = (uint32_t)roundf((mag - (float)int_part) * (float)scale);
+    if (frac_part >= scale) {
+        int_part++;
+        frac_part = 0;
+    }
+
+    if (value < 0 && (int_part || frac_part)) put_char(w, '-');
+    put_uint(w, int_part);
+    if (decimals) {
+        put_char(w, '.');
+        // Decimales con ceros a la izquierda
+        for (uint32_t div = scale / 10; div; div /= 10) {
+            put_char(w, (char)('0' + (frac_part / div) % 10));
+        }
+    }
+}
+
+void json_write_bool(json_writer_t *w, const char *key, bool value)
+{
+    put_prefix(w, key);
+    put_raw(w, value ? "true" : "false");
+}
+
+void json_write_str(json_writer_t *w, const char *key, const char *value)
+{
+    put_prefix(w, key);
+    if (!value) {
+        put_raw(w, "null");
+        return;
+    }
+    put_string(w, value);
+}
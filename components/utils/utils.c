@@ -1,5 +1,4 @@
 #include "utils.h"
-#include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -14,13 +13,15 @@ void timer_manager_delay_ms(uint32_t ms)
     vTaskDelay(pdMS_TO_TICKS(ms));
 }
 
-int data_formatter_format_json(const sensor_data_t *data, char *buf, size_t bufsize)
+int data_formatter_format_json(const nivometro_data_t *data, char *buf, size_t bufsize)
 {
     // Serializa los valores de sensores en un json dentro de buf
-    return snprintf(buf, bufsize,
-        "{\"distance_cm\":%.2f,\"weight_kg\":%.2f,\"laser_mm\":%.2f}",
-        data->distance_cm,
-        data->weight_kg,
-        data->laser_mm
-    );
+    json_writer_t w;
+    json_writer_init(&w, buf, bufsize);
+    json_obj_begin(&w, NULL);
+    json_write_fixed(&w, "distance_cm", data->ultrasonic_distance_cm, 2);
+    json_write_fixed(&w, "weight_kg", data->weight_grams / 1000.0f, 2);
+    json_write_fixed(&w, "laser_mm", data->laser_distance_mm, 2);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
 }
@@ -4,10 +4,29 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "esp_idf_version.h"
+// Backend I2C: API bus/dispositivo (driver/i2c_master.h) o driver legado.
+// i2c_master_get_bus_handle() llega en ESP-IDF 5.3: con versiones anteriores (el proyecto fija 5.2)
+// se usa el driver legado. Se puede forzar definiendo VL53L0X_I2C_MASTER_API; ambos drivers no
+// pueden convivir en el binario.
+#ifndef VL53L0X_I2C_MASTER_API
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#define VL53L0X_I2C_MASTER_API 1
+#else
+#define VL53L0X_I2C_MASTER_API 0
+#endif
+#endif
+
+#if VL53L0X_I2C_MASTER_API
+#include "driver/i2c_master.h"
+#else
 #include "driver/i2c.h"
+#endif
+#include "driver/gpio.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #define VL53L0X_DEFAULT_ADDRESS 0x29
 
@@ -27,6 +46,16 @@ typedef enum {
     VL53L0X_ACCURACY_FASTER = 4    // Precisión reducida, muy rápido
 } vl53l0x_accuracy_t;
 
+/**
+ * @brief Callback de fin de lectura asíncrona
+ * @param range_mm Distancia en milímetros (sin factor de calibración)
+ * @param ok false si la transacción falló
+ * @param arg Argumento de usuario
+ * @note Con el backend i2c_master se ejecuta en contexto de interrupción: debe ser IRAM_ATTR y
+ *       no usar la FPU
+ */
+typedef void (*vl53l0x_range_callback_t)(uint16_t range_mm, bool ok, void *arg);
+
 typedef struct {
     i2c_port_t i2c_port;       // Puerto I2C
     uint8_t address;           // Dirección I2C
@@ -34,6 +63,33 @@ typedef struct {
     float calibration_factor;  // Factor de calibración
     vl53l0x_mode_t mode;       // Modo de medición
     vl53l0x_accuracy_t accuracy; // Configuración de precisión
+    uint32_t timing_budget_us; // Presupuesto de tiempo por medida según la precisión
+    uint32_t inter_measurement_ms; // Periodo entre medidas en modo temporizado
+
+    // Interrupción GPIO1 (nueva medida disponible)
+    int gpio1_pin;             // Pin conectado a GPIO1 o -1 si no se usa
+    SemaphoreHandle_t data_ready; // Se libera desde la ISR al completar una medida
+    uint8_t last_range_status; // Estado de la última medida (RESULT_RANGE_STATUS >> 3)
+
+    // Tráfico I2C generado por el driver (para medir el coste de init/reconfiguración)
+    uint32_t i2c_transactions; // Transacciones completas en el bus
+    uint32_t i2c_bytes;        // Bytes transferidos (dirección de registro incluida)
+
+#if VL53L0X_I2C_MASTER_API
+    // Backend bus/dispositivo con transacciones asíncronas
+    i2c_master_bus_handle_t bus;      // Bus creado por la aplicación para i2c_port
+    i2c_master_dev_handle_t dev;      // Dispositivo VL53L0X en ese bus
+    bool async_bus;                   // true si el bus tiene cola de transacciones y callbacks
+#endif
+    volatile uint8_t async_state;     // Fase de la lectura asíncrona en curso
+    volatile bool async_ok;           // Resultado de la última lectura asíncrona
+    uint8_t async_reg;                // Registro de resultado (buffer estable durante la transacción)
+    uint8_t async_clear[2];           // Escritura de limpieza de interrupción
+    uint8_t async_result[12];         // Estado + distancia leídos en ráfaga
+    uint16_t async_range_mm;          // Distancia de la última lectura asíncrona
+    vl53l0x_range_callback_t async_cb; // Callback de usuario
+    void *async_cb_arg;               // Argumento del callback
+    SemaphoreHandle_t async_done;     // Se libera al terminar la lectura asíncrona
 } vl53l0x_sensor_t;
 
 /**
@@ -45,6 +101,18 @@ typedef struct {
  */
 bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address);
 
+/**
+ * @brief Inicializa el sensor VL53L0X aplicando directamente la precisión de trabajo
+ * @param sensor Puntero a la estructura del sensor
+ * @param i2c_port Puerto I2C
+ * @param address Dirección I2C del sensor
+ * @param accuracy Precisión a aplicar; si el sensor ya la tiene (despertar de deep sleep) no se reescribe
+ * @return true si la inicialización fue exitosa
+ * @note vl53l0x_init() equivale a esta función con VL53L0X_ACCURACY_BETTER
+ */
+bool vl53l0x_init_with_accuracy(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address,
+                                vl53l0x_accuracy_t accuracy);
+
 /**
  * @brief Lee la distancia del sensor
  * @param sensor Puntero a la estructura del sensor
@@ -52,6 +120,76 @@ bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address
  */
 uint16_t vl53l0x_read_distance(vl53l0x_sensor_t *sensor);
 
+/**
+ * @brief Configura la interrupción GPIO1 para despertar al lector con cada medida nueva
+ * @param sensor Puntero a la estructura del sensor
+ * @param gpio1_pin Pin del ESP32 conectado a la salida GPIO1 (activa a nivel bajo)
+ * @return true si el sensor y la ISR quedaron configurados
+ */
+bool vl53l0x_enable_interrupt(vl53l0x_sensor_t *sensor, int gpio1_pin);
+
+/**
+ * @brief Arranca la medición continua
+ * @param sensor Puntero a la estructura del sensor
+ * @param period_ms 0 = medidas consecutivas (back-to-back); >0 = modo temporizado con ese periodo
+ * @return true si la medición quedó en marcha
+ */
+bool vl53l0x_start_continuous(vl53l0x_sensor_t *sensor, uint32_t period_ms);
+
+/**
+ * @brief Espera la siguiente medida y la lee junto a su estado en una sola transacción
+ * @param sensor Puntero a la estructura del sensor
+ * @param timeout_ms Plazo máximo para esta lectura
+ * @param range_mm Distancia en milímetros (sin factor de calibración)
+ * @return true si hubo medida dentro del plazo
+ */
+bool vl53l0x_read_range_timeout(vl53l0x_sensor_t *sensor, uint32_t timeout_ms, uint16_t *range_mm);
+
+/**
+ * @brief Espera a que el sensor marque una medida completa, sin leerla
+ * @param sensor Puntero a la estructura del sensor
+ * @param timeout_ms Plazo máximo (0 = comprobar sin esperar)
+ * @return true si hay medida lista; leerla con vl53l0x_read_range_async()
+ * @note Con GPIO1 consume el aviso de la ISR; sin interrupción consulta el registro de estado
+ */
+bool vl53l0x_wait_data_ready(vl53l0x_sensor_t *sensor, uint32_t timeout_ms);
+
+/**
+ * @brief Inicia una medida sin esperar el resultado (modo único) o descarta la pendiente (continuo)
+ * @param sensor Puntero a la estructura del sensor
+ * @return true si la medida quedó en marcha
+ * @note Recoger el resultado con vl53l0x_read_range_timeout(), o sin bloquear en el bus con
+ *       vl53l0x_wait_data_ready() + vl53l0x_read_range_async()
+ */
+bool vl53l0x_start_ranging(vl53l0x_sensor_t *sensor);
+
+/**
+ * @brief Plazo máximo de una medida según el presupuesto de tiempo y el modo
+ * @param sensor Puntero a la estructura del sensor
+ * @return Plazo en milisegundos
+ */
+uint32_t vl53l0x_measurement_deadline_ms(const vl53l0x_sensor_t *sensor);
+
+/**
+ * @brief Lanza la lectura del resultado sin bloquear (estado + distancia + limpieza de interrupción)
+ * @param sensor Puntero a la estructura del sensor
+ * @param callback Callback al terminar (puede ser NULL)
+ * @param arg Argumento del callback
+ * @return true si la lectura quedó en cola
+ * @note Debe haber una medida lista (vl53l0x_wait_data_ready()). Con el backend legado
+ *       la lectura se hace en el momento y el callback se llama antes de retornar.
+ */
+bool vl53l0x_read_range_async(vl53l0x_sensor_t *sensor, vl53l0x_range_callback_t callback, void *arg);
+
+/**
+ * @brief Espera el final de una lectura lanzada con vl53l0x_read_range_async()
+ * @param sensor Puntero a la estructura del sensor
+ * @param timeout_ms Plazo máximo
+ * @param range_mm Distancia en milímetros (sin factor de calibración)
+ * @return true si la lectura terminó correctamente dentro del plazo
+ */
+bool vl53l0x_wait_range_async(vl53l0x_sensor_t *sensor, uint32_t timeout_ms, uint16_t *range_mm);
+
 /**
  * @brief Configura el modo de medición
  * @param sensor Puntero a la estructura del sensor
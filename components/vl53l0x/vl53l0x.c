@@ -1,5 +1,7 @@
 // vl53l0x.c
 #include "vl53l0x.h"
+#include <string.h>
+#include "esp_attr.h"
 
 // Registros importantes del VL53L0X
 #define REG_IDENTIFICATION_MODEL_ID    0xC0
@@ -18,45 +20,236 @@
 #define REG_RESULT_RANGE_STATUS       0x14
 #define REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW  0x47
 #define REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH  0x48
+#define REG_SYSTEM_INTERMEASUREMENT_PERIOD  0x04
+#define REG_OSC_CALIBRATE_VAL         0xF8
 
 // Constantes
 #define VL53L0X_EXPECTED_DEVICE_ID    0xEE
 #define VL53L0X_I2C_TIMEOUT_MS        100
+#define VL53L0X_I2C_FREQ_HZ           400000
+#define VL53L0X_RESULT_BURST_LEN      12      // RESULT_RANGE_STATUS .. distancia (0x14..0x1F)
+#define VL53L0X_DEADLINE_MARGIN_MS    20      // Margen sobre el presupuesto de medida
+#define VL53L0X_POLL_INTERVAL_MS      5
+#define VL53L0X_MAX_BLOCK_LEN         4       // Bytes máximos de un bloque de registros
+#define VL53L0X_ACCURACY_BLOCKS       3       // Bloques por tabla de precisión
+
+// ISR de GPIO1: avisa al lector de que hay una medida nueva
+static void IRAM_ATTR vl53l0x_gpio1_isr(void *arg) {
+    vl53l0x_sensor_t *sensor = (vl53l0x_sensor_t *)arg;
+    BaseType_t woken = pdFALSE;
+    
+    xSemaphoreGiveFromISR(sensor->data_ready, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Guion de configuración: bloque de registros consecutivos escrito en una sola transacción
+typedef struct {
+    uint8_t reg;                                // Primer registro del bloque
+    uint8_t len;                                // Bytes del bloque (autoincremento)
+    uint8_t data[VL53L0X_MAX_BLOCK_LEN];        // Valores a escribir
+} vl53l0x_reg_block_t;
+
+// Tabla de precisión: presupuesto de tiempo y registros que la definen
+typedef struct {
+    uint32_t timing_budget_us;
+    vl53l0x_reg_block_t blocks[VL53L0X_ACCURACY_BLOCKS];
+} vl53l0x_accuracy_script_t;
+
+// Límite de tasa de retorno: ~0.25 MCPS (presupuestos largos) o ~0.5 MCPS (cortos)
+#define RTN_LIMIT_LONG   {REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, 2, {0x0A, 0x00}}
+#define RTN_LIMIT_SHORT  {REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, 2, {0x14, 0x00}}
+// Fase válida del rango final: LOW=0x08, HIGH=0x78
+#define VALID_PHASE      {REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW, 2, {0x08, 0x78}}
+
+static const vl53l0x_accuracy_script_t vl53l0x_accuracy_scripts[] = {
+    [VL53L0X_ACCURACY_GOOD]   = { 30000, {{REG_MSRC_CONFIG_CONTROL, 1, {0x1D}}, RTN_LIMIT_SHORT, VALID_PHASE}},  // ~30ms
+    [VL53L0X_ACCURACY_BETTER] = { 70000, {{REG_MSRC_CONFIG_CONTROL, 1, {0x1E}}, RTN_LIMIT_LONG,  VALID_PHASE}},  // ~70ms
+    [VL53L0X_ACCURACY_BEST]   = {200000, {{REG_MSRC_CONFIG_CONTROL, 1, {0x1F}}, RTN_LIMIT_LONG,  VALID_PHASE}},  // ~200ms
+    [VL53L0X_ACCURACY_FAST]   = { 20000, {{REG_MSRC_CONFIG_CONTROL, 1, {0x1C}}, RTN_LIMIT_SHORT, VALID_PHASE}},  // ~20ms
+    [VL53L0X_ACCURACY_FASTER] = { 10000, {{REG_MSRC_CONFIG_CONTROL, 1, {0x18}}, RTN_LIMIT_SHORT, VALID_PHASE}},  // ~10ms
+};
+
+// Última precisión aplicada; sobrevive al deep sleep (el sensor sigue alimentado y conserva sus registros)
+static RTC_DATA_ATTR uint8_t rtc_applied_address = 0;
+static RTC_DATA_ATTR uint8_t rtc_applied_accuracy = 0xFF;
+
+// Fases de la lectura asíncrona
+enum {
+    VL53L0X_ASYNC_IDLE = 0,
+    VL53L0X_ASYNC_READ,        // Leyendo estado + distancia
+    VL53L0X_ASYNC_CLEAR,       // Limpiando la interrupción
+};
+
+// Decodifica la ráfaga de resultado en distancia y estado (también desde el callback de fin de
+// transacción, en contexto ISR: debe estar en IRAM)
+static void IRAM_ATTR vl53l0x_parse_result(vl53l0x_sensor_t *sensor, const uint8_t *result, uint16_t *range_mm) {
+    sensor->last_range_status = result[0] >> 3;
+    *range_mm = ((uint16_t)result[10] << 8) | result[11];
+}
+
+#if VL53L0X_I2C_MASTER_API
+
+// Fin de transacción en el bus (contexto ISR): avanza la lectura asíncrona
+static bool IRAM_ATTR vl53l0x_on_trans_done(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *edata, void *arg) {
+    vl53l0x_sensor_t *sensor = (vl53l0x_sensor_t *)arg;
+    BaseType_t woken = pdFALSE;
+    bool ok = edata->event == I2C_EVENT_DONE;
+    
+    if (sensor->async_state == VL53L0X_ASYNC_READ) {
+        sensor->async_ok = ok;
+        if (ok) {
+            vl53l0x_parse_result(sensor, sensor->async_result, &sensor->async_range_mm);
+        }
+        sensor->async_state = VL53L0X_ASYNC_CLEAR;
+    } else if (sensor->async_state == VL53L0X_ASYNC_CLEAR) {
+        sensor->async_state = VL53L0X_ASYNC_IDLE;
+        if (sensor->async_cb != NULL) {
+            sensor->async_cb(sensor->async_range_mm, sensor->async_ok, sensor->async_cb_arg);
+        }
+        xSemaphoreGiveFromISR(sensor->async_done, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+// Registra el sensor en el bus creado por la aplicación para su puerto
+static bool vl53l0x_bus_attach(vl53l0x_sensor_t *sensor) {
+    if (i2c_master_get_bus_handle(sensor->i2c_port, &sensor->bus) != ESP_OK) {
+        ESP_LOGE("VL53L0X", "No I2C master bus on port %d", (int)sensor->i2c_port);
+        return false;
+    }
+    
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = sensor->address,
+        .scl_speed_hz = VL53L0X_I2C_FREQ_HZ,
+    };
+    if (i2c_master_bus_add_device(sensor->bus, &dev_cfg, &sensor->dev) != ESP_OK) {
+        return false;
+    }
+    
+    // Solo hay callbacks si el bus se creó con cola de transacciones (modo asíncrono)
+    i2c_master_event_callbacks_t cbs = {
+        .on_trans_done = vl53l0x_on_trans_done,
+    };
+    sensor->async_bus = i2c_master_register_event_callbacks(sensor->dev, &cbs, sensor) == ESP_OK;
+    return true;
+}
+
+// En un bus asíncrono las transacciones solo se encolan: esperar a que terminen
+static esp_err_t vl53l0x_i2c_complete(vl53l0x_sensor_t *sensor, esp_err_t ret) {
+    if (ret == ESP_OK && sensor->async_bus) {
+        ret = i2c_master_bus_wait_all_done(sensor->bus, sensor->timeout_ms);
+    }
+    return ret;
+}
+
+#else
+
+// Timeout en ticks; nunca 0 (con tick de 10ms un timeout corto se redondeaba a 0)
+static TickType_t vl53l0x_timeout_ticks(const vl53l0x_sensor_t *sensor) {
+    TickType_t ticks = pdMS_TO_TICKS(sensor->timeout_ms);
+    return ticks > 0 ? ticks : 1;
+}
+
+#endif
+
+// Primitivas I2C: todo el tráfico del driver pasa por aquí y queda contado
+static esp_err_t vl53l0x_i2c_write(vl53l0x_sensor_t *sensor, const uint8_t *buf, size_t len) {
+    sensor->i2c_transactions++;
+    sensor->i2c_bytes += len;
+#if VL53L0X_I2C_MASTER_API
+    return vl53l0x_i2c_complete(sensor, i2c_master_transmit(sensor->dev, buf, len, sensor->timeout_ms));
+#else
+    return i2c_master_write_to_device(sensor->i2c_port, sensor->address, buf, len, 
+                                     vl53l0x_timeout_ticks(sensor));
+#endif
+}
+
+static esp_err_t vl53l0x_i2c_write_read(vl53l0x_sensor_t *sensor, uint8_t reg, uint8_t *data, size_t len) {
+    sensor->i2c_transactions++;
+    sensor->i2c_bytes += 1 + len;
+#if VL53L0X_I2C_MASTER_API
+    return vl53l0x_i2c_complete(sensor, i2c_master_transmit_receive(sensor->dev, &reg, 1, data, len,
+                                                                    sensor->timeout_ms));
+#else
+    return i2c_master_write_read_device(sensor->i2c_port, sensor->address, &reg, 1, 
+                                       data, len, vl53l0x_timeout_ticks(sensor));
+#endif
+}
 
 // Escritura/lectura I2C
 static esp_err_t vl53l0x_write_reg(vl53l0x_sensor_t *sensor, uint8_t reg, uint8_t data) {
     uint8_t write_buf[2] = {reg, data};
-    return i2c_master_write_to_device(sensor->i2c_port, sensor->address, write_buf, 2, 
-                                     sensor->timeout_ms / portTICK_PERIOD_MS);
+    return vl53l0x_i2c_write(sensor, write_buf, 2);
+}
+
+static esp_err_t vl53l0x_write_reg32(vl53l0x_sensor_t *sensor, uint8_t reg, uint32_t data) {
+    uint8_t write_buf[5] = {reg, (uint8_t)(data >> 24), (uint8_t)(data >> 16),
+                            (uint8_t)(data >> 8), (uint8_t)(data & 0xFF)};
+    return vl53l0x_i2c_write(sensor, write_buf, 5);
 }
 
-static esp_err_t vl53l0x_write_reg16(vl53l0x_sensor_t *sensor, uint8_t reg, uint16_t data) {
-    uint8_t write_buf[3] = {reg, (uint8_t)(data >> 8), (uint8_t)(data & 0xFF)};
-    return i2c_master_write_to_device(sensor->i2c_port, sensor->address, write_buf, 3, 
-                                     sensor->timeout_ms / portTICK_PERIOD_MS);
+static esp_err_t vl53l0x_write_multi(vl53l0x_sensor_t *sensor, uint8_t reg, const uint8_t *data, size_t len) {
+    uint8_t write_buf[1 + VL53L0X_MAX_BLOCK_LEN];
+    if (len > VL53L0X_MAX_BLOCK_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    write_buf[0] = reg;
+    memcpy(&write_buf[1], data, len);
+    return vl53l0x_i2c_write(sensor, write_buf, 1 + len);
 }
 
 static esp_err_t vl53l0x_read_reg(vl53l0x_sensor_t *sensor, uint8_t reg, uint8_t *data) {
-    return i2c_master_write_read_device(sensor->i2c_port, sensor->address, &reg, 1, 
-                                       data, 1, sensor->timeout_ms / portTICK_PERIOD_MS);
+    return vl53l0x_i2c_write_read(sensor, reg, data, 1);
+}
+
+static esp_err_t vl53l0x_read_multi(vl53l0x_sensor_t *sensor, uint8_t reg, uint8_t *data, size_t len) {
+    return vl53l0x_i2c_write_read(sensor, reg, data, len);
 }
 
 static esp_err_t vl53l0x_read_reg16(vl53l0x_sensor_t *sensor, uint8_t reg, uint16_t *data) {
     uint8_t read_buf[2];
-    esp_err_t ret = i2c_master_write_read_device(sensor->i2c_port, sensor->address, 
-                                               &reg, 1, read_buf, 2, 
-                                               sensor->timeout_ms / portTICK_PERIOD_MS);
+    esp_err_t ret = vl53l0x_i2c_write_read(sensor, reg, read_buf, 2);
     if (ret == ESP_OK) {
         *data = ((uint16_t)read_buf[0] << 8) | read_buf[1];
     }
     return ret;
 }
 
+// Aplica un guion de bloques: una transacción por bloque
+static esp_err_t vl53l0x_apply_blocks(vl53l0x_sensor_t *sensor, const vl53l0x_reg_block_t *blocks, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t ret = vl53l0x_write_multi(sensor, blocks[i].reg, blocks[i].data, blocks[i].len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+// Comprueba con una sola lectura si el dispositivo ya contiene el bloque
+static bool vl53l0x_block_matches(vl53l0x_sensor_t *sensor, const vl53l0x_reg_block_t *block) {
+    uint8_t current[VL53L0X_MAX_BLOCK_LEN];
+    if (vl53l0x_read_multi(sensor, block->reg, current, block->len) != ESP_OK) {
+        return false;
+    }
+    return memcmp(current, block->data, block->len) == 0;
+}
+
 bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address) {
+    return vl53l0x_init_with_accuracy(sensor, i2c_port, address, VL53L0X_ACCURACY_BETTER);
+}
+
+bool vl53l0x_init_with_accuracy(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address,
+                                vl53l0x_accuracy_t accuracy) {
     if (sensor == NULL) {
         ESP_LOGE("VL53L0X", "Sensor structure is NULL");
         return false;
     }
+    if ((unsigned)accuracy >= sizeof(vl53l0x_accuracy_scripts) / sizeof(vl53l0x_accuracy_scripts[0])) {
+        ESP_LOGE("VL53L0X", "Invalid accuracy %d", (int)accuracy);
+        return false;
+    }
     
     // Inicializar estructura
     sensor->i2c_port = i2c_port;
@@ -64,7 +257,31 @@ bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address
     sensor->timeout_ms = VL53L0X_I2C_TIMEOUT_MS;
     sensor->calibration_factor = 1.0f;
     sensor->mode = VL53L0X_MODE_SINGLE;
-    sensor->accuracy = VL53L0X_ACCURACY_BETTER;
+    sensor->accuracy = accuracy;
+    sensor->timing_budget_us = vl53l0x_accuracy_scripts[accuracy].timing_budget_us;
+    sensor->inter_measurement_ms = 100;
+    sensor->gpio1_pin = -1;
+    sensor->data_ready = NULL;
+    sensor->last_range_status = 0;
+    sensor->i2c_transactions = 0;
+    sensor->i2c_bytes = 0;
+    sensor->async_state = 0;
+    sensor->async_ok = false;
+    sensor->async_cb = NULL;
+    sensor->async_cb_arg = NULL;
+    sensor->async_done = xSemaphoreCreateBinary();
+    if (sensor->async_done == NULL) {
+        return false;
+    }
+    
+#if VL53L0X_I2C_MASTER_API
+    sensor->bus = NULL;
+    sensor->dev = NULL;
+    sensor->async_bus = false;
+    if (!vl53l0x_bus_attach(sensor)) {
+        return false;
+    }
+#endif
     
     // Verificar ID del dispositivo
     uint8_t device_id;
@@ -81,11 +298,15 @@ bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address
     
     // Secuencia de inicialización según datasheet
     // Habilitar HV, seleccionar 2.8V para EXTSUP
-    vl53l0x_write_reg(sensor, REG_VHV_CONFIG_PAD_SCL_SDA_EXTSUP_HV, 
-                     (vl53l0x_read_reg(sensor, REG_VHV_CONFIG_PAD_SCL_SDA_EXTSUP_HV, &device_id) & 0xFE) | 0x01);
+    // (solo se escribe si el bit no está ya activo, p.ej. al despertar de deep sleep)
+    uint8_t vhv;
+    if (vl53l0x_read_reg(sensor, REG_VHV_CONFIG_PAD_SCL_SDA_EXTSUP_HV, &vhv) == ESP_OK && !(vhv & 0x01)) {
+        vl53l0x_write_reg(sensor, REG_VHV_CONFIG_PAD_SCL_SDA_EXTSUP_HV, vhv | 0x01);
+    }
     
-    // Configuración inicial de timing y calibración
-    vl53l0x_set_accuracy(sensor, sensor->accuracy);
+    // Precisión de trabajo directamente: aplicar otra y cambiarla después haría que el registro
+    // en rtc nunca coincidiera y la tabla se reescribiera en cada despertar
+    vl53l0x_set_accuracy(sensor, accuracy);
     
     // Configurar modo por defecto (medición única)
     vl53l0x_set_mode(sensor, sensor->mode);
@@ -94,51 +315,243 @@ bool vl53l0x_init(vl53l0x_sensor_t *sensor, i2c_port_t i2c_port, uint8_t address
     return true;
 }
 
+// Plazo máximo de una medida: presupuesto de tiempo (y periodo en modo temporizado) más margen
+static uint32_t vl53l0x_deadline_ms(const vl53l0x_sensor_t *sensor) {
+    uint32_t deadline = sensor->timing_budget_us / 1000 + VL53L0X_DEADLINE_MARGIN_MS;
+    if (sensor->mode == VL53L0X_MODE_TIMED) {
+        deadline += sensor->inter_measurement_ms;
+    }
+    return deadline;
+}
+
+bool vl53l0x_wait_data_ready(vl53l0x_sensor_t *sensor, uint32_t timeout_ms) {
+    if (sensor == NULL) {
+        return false;
+    }
+    if (sensor->data_ready != NULL) {
+        // +1 tick para que un plazo corto no se redondee a 0 con tick de 10ms
+        return xSemaphoreTake(sensor->data_ready, pdMS_TO_TICKS(timeout_ms) + 1) == pdTRUE;
+    }
+    
+    uint8_t status;
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        if (vl53l0x_read_reg(sensor, REG_RESULT_INTERRUPT_STATUS, &status) != ESP_OK) {
+            return false;
+        }
+        if ((status & 0x07) != 0) {
+            return true;
+        }
+        if (xTaskGetTickCount() - start > pdMS_TO_TICKS(timeout_ms)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(VL53L0X_POLL_INTERVAL_MS) + 1);
+    }
+}
+
+// Lee la medida ya completa: estado y distancia en una única lectura con autoincremento
+static bool vl53l0x_read_result(vl53l0x_sensor_t *sensor, uint16_t *range_mm) {
+    uint8_t result[VL53L0X_RESULT_BURST_LEN];
+    if (vl53l0x_read_multi(sensor, REG_RESULT_RANGE_STATUS, result, sizeof(result)) != ESP_OK) {
+        return false;
+    }
+    vl53l0x_parse_result(sensor, result, range_mm);
+    
+    // Limpiar la interrupción para la siguiente medida
+    vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+    return true;
+}
+
+bool vl53l0x_read_range_timeout(vl53l0x_sensor_t *sensor, uint32_t timeout_ms, uint16_t *range_mm) {
+    if (sensor == NULL || range_mm == NULL) {
+        return false;
+    }
+    
+    if (!vl53l0x_wait_data_ready(sensor, timeout_ms)) {
+        return false;
+    }
+    return vl53l0x_read_result(sensor, range_mm);
+}
+
+uint32_t vl53l0x_measurement_deadline_ms(const vl53l0x_sensor_t *sensor) {
+    if (sensor == NULL) {
+        return 0;
+    }
+    return vl53l0x_deadline_ms(sensor);
+}
+
+bool vl53l0x_start_ranging(vl53l0x_sensor_t *sensor) {
+    if (sensor == NULL) {
+        return false;
+    }
+    
+    // En modo único, iniciar una medición
+    if (sensor->mode == VL53L0X_MODE_SINGLE) {
+        return vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x01) == ESP_OK;
+    }
+    
+    // En modo continuo/temporizado, descartar la medida pendiente para esperar una posterior
+    if (sensor->data_ready != NULL) {
+        xSemaphoreTake(sensor->data_ready, 0);
+    }
+    return vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CLEAR, 0x01) == ESP_OK;
+}
+
 uint16_t vl53l0x_read_distance(vl53l0x_sensor_t *sensor) {
     if (sensor == NULL) {
         return 0;
     }
     
-    esp_err_t ret;
-    uint8_t status;
     uint16_t range_mm = 0;
     
     // En modo único, iniciar una medición
     if (sensor->mode == VL53L0X_MODE_SINGLE) {
-        ret = vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x01);
-        if (ret != ESP_OK) {
-            return 0;
-        }
-        
-        // Esperar a que la medición se complete
-        do {
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            ret = vl53l0x_read_reg(sensor, REG_RESULT_INTERRUPT_STATUS, &status);
-            if (ret != ESP_OK) {
-                return 0;
-            }
-        } while ((status & 0x07) == 0);
-        
-        // Leer el resultado
-        ret = vl53l0x_read_reg16(sensor, REG_RESULT_RANGE_STATUS + 10, &range_mm);
-        if (ret != ESP_OK) {
-            return 0;
-        }
-        
-        // Limpiar la interrupción
-        vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
-    } else {
-        // En modo continuo o temporizado, simplemente leer el último valor
-        ret = vl53l0x_read_reg16(sensor, REG_RESULT_RANGE_STATUS + 10, &range_mm);
-        if (ret != ESP_OK) {
+        if (vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x01) != ESP_OK) {
             return 0;
         }
     }
     
+    // Esperar la medida (modo único) o la siguiente medida (continuo/temporizado) con plazo acotado
+    if (!vl53l0x_read_range_timeout(sensor, vl53l0x_deadline_ms(sensor), &range_mm)) {
+        return 0;
+    }
+    
     // Aplicar factor de calibración
     return (uint16_t)((float)range_mm * sensor->calibration_factor);
 }
 
+bool vl53l0x_read_range_async(vl53l0x_sensor_t *sensor, vl53l0x_range_callback_t callback, void *arg) {
+    if (sensor == NULL || sensor->async_state != VL53L0X_ASYNC_IDLE) {
+        return false;
+    }
+    
+    xSemaphoreTake(sensor->async_done, 0);
+    sensor->async_cb = callback;
+    sensor->async_cb_arg = arg;
+    sensor->async_ok = false;
+    
+#if VL53L0X_I2C_MASTER_API
+    if (sensor->async_bus) {
+        // Dos transacciones encoladas: lectura en ráfaga y limpieza de interrupción
+        sensor->async_reg = REG_RESULT_RANGE_STATUS;
+        sensor->async_clear[0] = REG_SYSTEM_INTERRUPT_CLEAR;
+        sensor->async_clear[1] = 0x01;
+        sensor->async_state = VL53L0X_ASYNC_READ;
+        sensor->i2c_transactions += 2;
+        sensor->i2c_bytes += 1 + sizeof(sensor->async_result) + sizeof(sensor->async_clear);
+        if (i2c_master_transmit_receive(sensor->dev, &sensor->async_reg, 1, sensor->async_result,
+                                        sizeof(sensor->async_result), sensor->timeout_ms) != ESP_OK ||
+            i2c_master_transmit(sensor->dev, sensor->async_clear, sizeof(sensor->async_clear),
+                                sensor->timeout_ms) != ESP_OK) {
+            sensor->async_state = VL53L0X_ASYNC_IDLE;
+            return false;
+        }
+        return true;
+    }
+#endif
+    
+    // Bus síncrono: leer ahora (la medida ya está lista) y completar inmediatamente
+    uint16_t range_mm = 0;
+    sensor->async_ok = vl53l0x_read_result(sensor, &range_mm);
+    sensor->async_range_mm = range_mm;
+    if (callback != NULL) {
+        callback(range_mm, sensor->async_ok, arg);
+    }
+    xSemaphoreGive(sensor->async_done);
+    return true;
+}
+
+bool vl53l0x_wait_range_async(vl53l0x_sensor_t *sensor, uint32_t timeout_ms, uint16_t *range_mm) {
+    if (sensor == NULL || range_mm == NULL) {
+        return false;
+    }
+    
+    // +1 tick para que un plazo corto no se redondee a 0 con tick de 10ms
+    if (xSemaphoreTake(sensor->async_done, pdMS_TO_TICKS(timeout_ms) + 1) != pdTRUE) {
+        return false;
+    }
+    *range_mm = sensor->async_range_mm;
+    return sensor->async_ok;
+}
+
+bool vl53l0x_enable_interrupt(vl53l0x_sensor_t *sensor, int gpio1_pin) {
+    if (sensor == NULL || gpio1_pin < 0) {
+        return false;
+    }
+    
+    // GPIO1: "nueva medida disponible", activa a nivel bajo
+    uint8_t mux;
+    if (vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CONFIG_GPIO, 0x04) != ESP_OK ||
+        vl53l0x_read_reg(sensor, REG_GPIO_HV_MUX_ACTIVE_HIGH, &mux) != ESP_OK ||
+        vl53l0x_write_reg(sensor, REG_GPIO_HV_MUX_ACTIVE_HIGH, mux & ~0x10) != ESP_OK ||
+        vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CLEAR, 0x01) != ESP_OK) {
+        return false;
+    }
+    
+    if (sensor->data_ready == NULL) {
+        sensor->data_ready = xSemaphoreCreateBinary();
+        if (sensor->data_ready == NULL) {
+            return false;
+        }
+    }
+    
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_NEGEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = (1ULL << gpio1_pin),
+        .pull_down_en = 0,
+        .pull_up_en = 1,            // GPIO1 es de drenador abierto
+    };
+    gpio_config(&io_conf);
+    
+    // El servicio de ISR puede estar ya instalado por otro driver
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return false;
+    }
+    if (gpio_isr_handler_add(gpio1_pin, vl53l0x_gpio1_isr, sensor) != ESP_OK) {
+        return false;
+    }
+    
+    sensor->gpio1_pin = gpio1_pin;
+    return true;
+}
+
+bool vl53l0x_start_continuous(vl53l0x_sensor_t *sensor, uint32_t period_ms) {
+    if (sensor == NULL) {
+        return false;
+    }
+    
+    // Descartar avisos de medidas anteriores
+    if (sensor->data_ready != NULL) {
+        xSemaphoreTake(sensor->data_ready, 0);
+    }
+    vl53l0x_write_reg(sensor, REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+    
+    if (period_ms == 0) {
+        // Medidas consecutivas (back-to-back)
+        if (vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x02) != ESP_OK) {
+            return false;
+        }
+        sensor->mode = VL53L0X_MODE_CONTINUOUS;
+        return true;
+    }
+    
+    // Modo temporizado: el periodo se expresa en ciclos del oscilador interno
+    uint16_t osc_calibrate = 0;
+    uint32_t period = period_ms;
+    if (vl53l0x_read_reg16(sensor, REG_OSC_CALIBRATE_VAL, &osc_calibrate) == ESP_OK && osc_calibrate != 0) {
+        period *= osc_calibrate;
+    }
+    if (vl53l0x_write_reg32(sensor, REG_SYSTEM_INTERMEASUREMENT_PERIOD, period) != ESP_OK ||
+        vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x04) != ESP_OK) {
+        return false;
+    }
+    sensor->inter_measurement_ms = period_ms;
+    sensor->mode = VL53L0X_MODE_TIMED;
+    return true;
+}
+
 bool vl53l0x_set_mode(vl53l0x_sensor_t *sensor, vl53l0x_mode_t mode) {
     if (sensor == NULL) {
         return false;
@@ -159,21 +572,12 @@ bool vl53l0x_set_mode(vl53l0x_sensor_t *sensor, vl53l0x_mode_t mode) {
             break;
             
         case VL53L0X_MODE_CONTINUOUS:
-            // Iniciar modo continuo
-            ret = vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x02);
-            if (ret != ESP_OK) {
-                return false;
-            }
-            break;
+            // Iniciar modo continuo (medidas consecutivas)
+            return vl53l0x_start_continuous(sensor, 0);
             
         case VL53L0X_MODE_TIMED:
-            // Configurar modo temporizado (por ejemplo, cada 100ms)
-            // Este modo necesita configuración adicional según la aplicación
-            ret = vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x03);
-            if (ret != ESP_OK) {
-                return false;
-            }
-            break;
+            // Modo temporizado con el periodo configurado (100ms por defecto)
+            return vl53l0x_start_continuous(sensor, sensor->inter_measurement_ms);
             
         default:
             return false;
@@ -188,61 +592,26 @@ bool vl53l0x_set_accuracy(vl53l0x_sensor_t *sensor, vl53l0x_accuracy_t accuracy)
         return false;
     }
     
-    uint8_t timing_config;
-    uint16_t timing_budget_us;
-    
-    // Configurar la precisión/velocidad
-    switch (accuracy) {
-        case VL53L0X_ACCURACY_GOOD:
-            // Precisión estándar (~30ms por medición)
-            timing_budget_us = 30000;
-            vl53l0x_write_reg(sensor, REG_MSRC_CONFIG_CONTROL, 0x1D);
-            break;
-            
-        case VL53L0X_ACCURACY_BETTER:
-            // Mejor precisión (~70ms por medición)
-            timing_budget_us = 70000;
-            vl53l0x_write_reg(sensor, REG_MSRC_CONFIG_CONTROL, 0x1E);
-            break;
-            
-        case VL53L0X_ACCURACY_BEST:
-            // La mejor precisión (~200ms por medición)
-            timing_budget_us = 200000;
-            vl53l0x_write_reg(sensor, REG_MSRC_CONFIG_CONTROL, 0x1F);
-            break;
-            
-        case VL53L0X_ACCURACY_FAST:
-            // Precisión reducida, pero más rápido (~20ms)
-            timing_budget_us = 20000;
-            vl53l0x_write_reg(sensor, REG_MSRC_CONFIG_CONTROL, 0x1C);
-            break;
-            
-        case VL53L0X_ACCURACY_FASTER:
-            // Precisión muy reducida, muy rápido (~10ms)
-            timing_budget_us = 10000;
-            vl53l0x_write_reg(sensor, REG_MSRC_CONFIG_CONTROL, 0x18);
-            break;
-            
-        default:
-            return false;
-    }
-    
-    // Establecer límite de tasa de retorno para mejorar la precisión
-    // en función del tiempo de medición
-    uint16_t return_limit;
-    if (timing_budget_us > 50000) {
-        return_limit = 0x0A00;  // ~0.25 MCPS
-    } else {
-        return_limit = 0x1400;  // ~0.5 MCPS
+    if ((unsigned)accuracy >= sizeof(vl53l0x_accuracy_scripts) / sizeof(vl53l0x_accuracy_scripts[0])) {
+        return false;
     }
     
-    vl53l0x_write_reg16(sensor, REG_FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, return_limit);
+    const vl53l0x_accuracy_script_t *script = &vl53l0x_accuracy_scripts[accuracy];
     
-    // Configurar parámetros de fase de rango final
-    vl53l0x_write_reg16(sensor, REG_FINAL_RANGE_CONFIG_VALID_PHASE_LOW, 0x08);
-    vl53l0x_write_reg16(sensor, REG_FINAL_RANGE_CONFIG_VALID_PHASE_HIGH, 0x78);
+    // Si el sensor ya tiene esta tabla (aplicada antes del deep sleep), basta una lectura de verificación
+    bool applied = rtc_applied_address == sensor->address && rtc_applied_accuracy == accuracy &&
+                   vl53l0x_block_matches(sensor, &script->blocks[0]);
+    if (!applied) {
+        if (vl53l0x_apply_blocks(sensor, script->blocks, VL53L0X_ACCURACY_BLOCKS) != ESP_OK) {
+            rtc_applied_accuracy = 0xFF;
+            return false;
+        }
+        rtc_applied_address = sensor->address;
+        rtc_applied_accuracy = accuracy;
+    }
     
     sensor->accuracy = accuracy;
+    sensor->timing_budget_us = script->timing_budget_us;
     return true;
 }
 
@@ -258,7 +627,15 @@ bool vl53l0x_wake_up(vl53l0x_sensor_t *sensor) {
     }
     
     // Escribir al registro de power para despertar el sensor
-    return vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x00) == ESP_OK;
+    if (vl53l0x_write_reg(sensor, REG_SYSRANGE_START, 0x00) != ESP_OK) {
+        return false;
+    }
+    
+    // Reanudar la medición continua/temporizada detenida por vl53l0x_sleep()
+    if (sensor->mode != VL53L0X_MODE_SINGLE) {
+        return vl53l0x_set_mode(sensor, sensor->mode);
+    }
+    return true;
 }
 
 bool vl53l0x_sleep(vl53l0x_sensor_t *sensor) {
@@ -24,11 +24,9 @@ void app_main(void) {
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
-#include "driver/i2c.h"
 
 // Componentes de Antonio Mata
 #include "communication.h"
@@ -36,22 +34,35 @@ void app_main(void) {
 #include "config.h"
 #include "diagnostics.h"
 #include "storage.h"
+#include "utils.h"
+#include "tasks.h"
 
 // Componentes específicos del nivómetro (antoniopalafox)
 #include "nivometro_sensors.h"
+#include "scheduler.h"
+#include "sample_bus.h"
+#include "change_detector.h"
+#include "time_sync.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 
 static const char *TAG = "NIVOMETRO_MAIN";
 
+// Tara de la balanza conservada durante el deep sleep (modo ciclo)
+static RTC_DATA_ATTR int32_t rtc_scale_offset;
+
 // Configuración I2C
 #define I2C_MASTER_SCL_IO           22
 #define I2C_MASTER_SDA_IO           21  
 #define I2C_MASTER_NUM              0
 #define I2C_MASTER_FREQ_HZ          400000
+#define I2C_MASTER_QUEUE_DEPTH      4       // Transacciones en cola (habilita el modo asíncrono)
 
 // Configuración sensores específicos nivómetro
 #define HCSR04P_TRIGGER_PIN         12
 #define HCSR04P_ECHO_PIN            13
 #define HCSR04P_CAL_FACTOR          1.02f
+#define HCSR04P_BURST_PINGS         5
 
 #define HX711_DOUT_PIN              26
 #define HX711_SCK_PIN               27
@@ -59,10 +70,31 @@ static const char *TAG = "NIVOMETRO_MAIN";
 
 #define VL53L0X_ADDRESS             0x29
 #define VL53L0X_CAL_FACTOR          1.05f
+#define VL53L0X_GPIO1_PIN           25      // Salida GPIO1 (data ready) del VL53L0X
+
+// Planificación por sensor: periodo, desfase y antelación de encendido (ms)
+#define ULTRASONIC_PERIOD_MS        10000   // La profundidad cambia rápido durante una tormenta
+#define ULTRASONIC_PHASE_MS         0
+#define ULTRASONIC_LEAD_MS          0
+#define SCALE_PERIOD_MS             60000   // El peso cambia lentamente
+#define SCALE_PHASE_MS              0
+#define SCALE_LEAD_MS               500     // Asentamiento del HX711 tras salir de power-down
+#define LASER_PERIOD_MS             10000
+#define LASER_PHASE_MS              0
+#define LASER_LEAD_MS               50      // Arranque del VL53L0X
+
+// Bus de muestras: sensor_task escribe en sitio y cada consumidor lee el mismo hueco
+#define SAMPLE_BUS_SLOTS            32      // Potencia de 2; ~5 min de muestras a 10 s
+#define DIAG_BUS_REPORT_MS          600000  // Informe periódico de contadores del bus
 
 // Variables globales
 static nivometro_t g_nivometro;
-static QueueHandle_t sensor_data_queue;
+static scheduler_t g_scheduler;
+static nivometro_data_t g_sample_slots[SAMPLE_BUS_SLOTS];
+static sample_bus_t g_sample_bus;
+static int g_comm_consumer = -1;                // communication_task: publicación y outbox
+static int g_diag_consumer = -1;                // diagnostics_task: eventos de estado de sensores
+static change_detector_t g_change_detector;     // Informe por excepción delante de la publicación
 
 // Tópicos MQTT específicos
 #define MQTT_TOPIC_ULTRASONIC       "nivometro/antartica/ultrasonic"
@@ -71,7 +103,40 @@ static QueueHandle_t sensor_data_queue;
 #define MQTT_TOPIC_STATUS           "nivometro/antartica/status"
 #define MQTT_TOPIC_DIAGNOSTICS      "nivometro/antartica/diagnostics"
 
+// Publicación por lotes: todas las muestras de la ventana en un mensaje sobre COMM_TOPIC_BATCH
+#define MQTT_BATCH_SAMPLES          10      // Muestras por mensaje (1 = un mensaje por topic y muestra)
+#define MQTT_BATCH_MAX_AGE_MS       300000  // Publicar aunque el lote no esté lleno tras 5 min
+#define MQTT_BATCH_BINARY           1       // 1 = sample_codec sobre COMM_TOPIC_BATCH_BIN, 0 = json
+
+// Modo de operación: 0 = continuo (tareas + radio siempre encendida),
+// 1 = ciclo con deep sleep (tasks.c: muestreo en cada despertar, radio cada POWER_UPLINK_EVERY_K_WAKES)
+#define NIVOMETRO_DUTY_CYCLE        0
+
+// Reenvío del outbox persistente (muestras guardadas sin conexión)
+#define OUTBOX_REPLAY_INTERVAL_MS   500     // Pausa entre lotes reenviados (ritmo controlado)
+#define OUTBOX_ACK_TIMEOUT_MS       10000   // Espera máxima del PUBACK de un lote reenviado
+#define OUTBOX_RETRY_DELAY_MS       30000   // Pausa tras un lote sin confirmar
+#define OUTBOX_IDLE_POLL_MS         10000   // Comprobación del outbox cuando está vacío
+#define LIVE_ACK_TIMEOUT_MS         10000   // Espera máxima del PUBACK de un envío en directo
+
 // Inicializar I2C
+#if VL53L0X_I2C_MASTER_API
+static esp_err_t i2c_master_init(void) {
+    // Bus con cola de transacciones: el VL53L0X lo localiza por número de puerto
+    i2c_master_bus_config_t conf = {
+        .i2c_port = I2C_MASTER_NUM,
+        .sda_io_num = I2C_MASTER_SDA_IO,
+        .scl_io_num = I2C_MASTER_SCL_IO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = I2C_MASTER_QUEUE_DEPTH,
+        .flags.enable_internal_pullup = true,
+    };
+    i2c_master_bus_handle_t bus;
+    
+    return i2c_new_master_bus(&conf, &bus);
+}
+#else
 static esp_err_t i2c_master_init(void) {
     i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
@@ -87,84 +152,391 @@ static esp_err_t i2c_master_init(void) {
     
     return i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
 }
+#endif
+
+// Milisegundos desde el arranque (base de tiempos del planificador)
+static int64_t now_ms(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+// Registra cada sensor con su propio periodo (id = bit del sensor en sensor_status)
+static void setup_scheduler(void) {
+    int64_t now = now_ms();
+    
+    scheduler_init(&g_scheduler);
+    scheduler_register(&g_scheduler, 0, ULTRASONIC_PERIOD_MS, ULTRASONIC_PHASE_MS, ULTRASONIC_LEAD_MS, now);
+    scheduler_register(&g_scheduler, 1, SCALE_PERIOD_MS, SCALE_PHASE_MS, SCALE_LEAD_MS, now);
+    scheduler_register(&g_scheduler, 2, LASER_PERIOD_MS, LASER_PHASE_MS, LASER_LEAD_MS, now);
+}
 
 // Tarea principal de lectura de sensores
 void sensor_task(void *pvParameters) {
-    nivometro_data_t sensor_data;
+    nivometro_data_t discarded;
+    uint8_t powered = NIVOMETRO_SENSOR_ALL;
     
     ESP_LOGI(TAG, "Iniciando tarea de lectura de sensores");
     
     while (1) {
-        // Leer todos los sensores
-        esp_err_t ret = nivometro_read_all_sensors(&g_nivometro, &sensor_data);
+        // Encender con antelación los sensores cuya lectura se acerca
+        uint8_t power = (uint8_t)scheduler_power_mask(&g_scheduler, now_ms());
+        nivometro_power_up_sensors(&g_nivometro, power & ~powered);
+        powered |= power;
         
-        if (ret == ESP_OK) {
-            // Enviar datos a la cola para procesamiento
-            if (xQueueSend(sensor_data_queue, &sensor_data, 0) != pdTRUE) {
-                ESP_LOGW(TAG, "Cola de datos llena, descartando lectura");
+        // Leer solo los sensores a los que les toca y fusionarlos en un registro
+        uint8_t due = (uint8_t)scheduler_due_mask(&g_scheduler, now_ms());
+        if (due) {
+            // Leer directamente en el hueco del bus; si está prestado la lectura se hace igual
+            // (mantiene el estado de filtros y el último registro) pero la muestra se descarta
+            nivometro_data_t *sensor_data = sample_bus_claim(&g_sample_bus);
+            bool on_bus = sensor_data != NULL;
+            if (!on_bus) {
+                sensor_data = &discarded;
+                ESP_LOGW(TAG, "Bus de muestras ocupado, descartando lectura (%lu descartadas)",
+                         (unsigned long)g_sample_bus.producer_dropped);
             }
             
-            // Log para debug
-            ESP_LOGI(TAG, "📊 Ultrasonido: %.2f cm | Peso: %.2f g | Láser: %.0f mm | Estado: %s",
-                     sensor_data.ultrasonic_distance_cm,
-                     sensor_data.weight_grams, 
-                     sensor_data.laser_distance_mm,
-                     nivometro_get_sensor_status_string(sensor_data.sensor_status));
-        } else {
-            ESP_LOGE(TAG, "Error leyendo sensores");
+            esp_err_t ret = nivometro_read_sensors(&g_nivometro, due, sensor_data);
+            scheduler_mark_done(&g_scheduler, due, now_ms());
+            
+            if (ret == ESP_OK) {
+                if (on_bus) {
+                    sample_bus_publish(&g_sample_bus);
+                }
+                
+                // Log para debug
+                ESP_LOGI(TAG, "📊 Ultrasonido: %.2f cm | Peso: %.2f g | Láser: %.0f mm | Leídos: 0x%02x | Estado: %s",
+                         sensor_data->ultrasonic_distance_cm,
+                         sensor_data->weight_grams, 
+                         sensor_data->laser_distance_mm,
+                         sensor_data->sampled_mask,
+                         nivometro_get_sensor_status_string(sensor_data->sensor_status));
+            } else {
+                if (on_bus) {
+                    sample_bus_cancel(&g_sample_bus);
+                }
+                ESP_LOGE(TAG, "Error leyendo sensores");
+            }
+            
+            // Apagar los sensores leídos que no vuelven a tocar pronto
+            uint8_t idle = powered & ~(uint8_t)scheduler_power_mask(&g_scheduler, now_ms());
+            nivometro_power_down_sensors(&g_nivometro, idle);
+            powered &= ~idle;
         }
         
-        // Esperar antes de la siguiente lectura
-        vTaskDelay(pdMS_TO_TICKS(1000)); // 1 segundo
+        // Dormir hasta el próximo encendido o lectura
+        uint32_t wait_ms = scheduler_ms_until_next(&g_scheduler, now_ms());
+        vTaskDelay(pdMS_TO_TICKS(wait_ms) > 0 ? pdMS_TO_TICKS(wait_ms) : 1);
+    }
+}
+
+// Espera el PUBACK de cada msg_id con un plazo común; false si alguno no se publicó,
+// el cliente lo descartó o no se confirmó a tiempo
+static bool wait_delivered(const int *msg_ids, size_t count) {
+    TickType_t start = xTaskGetTickCount();
+    
+    for (size_t i = 0; i < count; i++) {
+        uint32_t elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+        uint32_t left_ms = elapsed_ms < LIVE_ACK_TIMEOUT_MS ? LIVE_ACK_TIMEOUT_MS - elapsed_ms : 0;
+        if (!communication_wait_published(msg_ids[i], left_ms)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Publica una muestra repartida en los cuatro topics por sensor (modo sin lotes);
+// true solo si el broker confirma los cuatro mensajes
+static bool publish_sample_topics(const nivometro_data_t *sensor_data) {
+    char json_buffer[192];
+    json_writer_t w;
+    int msg_ids[4];
+    size_t sent = 0;
+    uint64_t timestamp_us = time_sync_correct_us(sensor_data->timestamp_us);   // UTC aunque se leyera sin hora
+    
+    // Crear JSON con datos del ultrasonido
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_obj_begin(&w, NULL);
+    json_write_fixed(&w, "distance_cm", sensor_data->ultrasonic_distance_cm, 2);
+    json_write_uint(&w, "timestamp", timestamp_us);
+    json_write_str(&w, "sensor", "hcsr04p");
+    json_write_bool(&w, "status", nivometro_is_sensor_working(sensor_data->sensor_status, 0));
+    json_obj_end(&w);
+    msg_ids[sent++] = json_writer_finish(&w) >= 0 ? communication_publish(MQTT_TOPIC_ULTRASONIC, json_buffer) : -1;
+    
+    // Crear JSON con datos del peso
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_obj_begin(&w, NULL);
+    json_write_fixed(&w, "weight_g", sensor_data->weight_grams, 2);
+    json_write_uint(&w, "timestamp", timestamp_us);
+    json_write_str(&w, "sensor", "hx711");
+    json_write_bool(&w, "status", nivometro_is_sensor_working(sensor_data->sensor_status, 1));
+    json_obj_end(&w);
+    msg_ids[sent++] = json_writer_finish(&w) >= 0 ? communication_publish(MQTT_TOPIC_WEIGHT, json_buffer) : -1;
+    
+    // Crear JSON con datos del láser
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_obj_begin(&w, NULL);
+    json_write_fixed(&w, "distance_mm", sensor_data->laser_distance_mm, 0);
+    json_write_uint(&w, "timestamp", timestamp_us);
+    json_write_str(&w, "sensor", "vl53l0x");
+    json_write_bool(&w, "status", nivometro_is_sensor_working(sensor_data->sensor_status, 2));
+    json_obj_end(&w);
+    msg_ids[sent++] = json_writer_finish(&w) >= 0 ? communication_publish(MQTT_TOPIC_LASER, json_buffer) : -1;
+    
+    // Datos de estado general
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_obj_begin(&w, NULL);
+    json_write_fixed(&w, "battery_v", sensor_data->battery_voltage, 2);
+    if (sensor_data->temperature_c != NIVOMETRO_TEMP_UNKNOWN) {
+        json_write_int(&w, "temp_c", sensor_data->temperature_c);
+    }
+    json_write_uint(&w, "sensor_mask", sensor_data->sensor_status);
+    json_write_uint(&w, "timestamp", timestamp_us);
+    json_obj_end(&w);
+    msg_ids[sent++] = json_writer_finish(&w) >= 0 ? communication_publish(MQTT_TOPIC_STATUS, json_buffer) : -1;
+    
+    return wait_delivered(msg_ids, sent);
+}
+
+// Publica un lote en el formato configurado; devuelve el msg_id o -1
+static int publish_batch(const nivometro_data_t *samples, size_t count) {
+    if (MQTT_BATCH_BINARY) {
+        return communication_publish_batch_binary(samples, count);
+    }
+    return communication_publish_batch(samples, count);
+}
+
+// Guarda en el outbox persistente las muestras que no se pudieron enviar
+static void store_for_later(const nivometro_data_t *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        storage_buffer_data(&samples[i]);
+    }
+    ESP_LOGW(TAG, "Sin confirmación MQTT: %u muestras al outbox (%u pendientes)",
+             (unsigned)count, (unsigned)storage_outbox_count());
+}
+
+// Reenvía el siguiente lote del histórico pedido por COMM_TOPIC_REPLAY; false al terminar.
+// El cursor solo avanza cuando el broker confirma el lote (InfluxDB sobrescribe los puntos repetidos)
+static bool replay_next(storage_cursor_t *cur, nivometro_data_t *batch) {
+    storage_cursor_t next = *cur;
+    size_t n = storage_read_next(&next, batch, MQTT_BATCH_SAMPLES);
+    if (n == 0) {
+        ESP_LOGI(TAG, "Reenvío del histórico completado");
+        return false;
+    }
+    
+    int msg_id = publish_batch(batch, n);
+    if (communication_wait_published(msg_id, OUTBOX_ACK_TIMEOUT_MS)) {
+        *cur = next;
+        vTaskDelay(pdMS_TO_TICKS(OUTBOX_REPLAY_INTERVAL_MS));
+    } else {
+        ESP_LOGW(TAG, "Reenvío: lote sin confirmar (msg_id=%d), reintento en %d ms",
+                 msg_id, OUTBOX_RETRY_DELAY_MS);
+        vTaskDelay(pdMS_TO_TICKS(OUTBOX_RETRY_DELAY_MS));
+    }
+    return true;
+}
+
+// Tarea de reenvío del outbox: vacía en orden las muestras guardadas cuando hay conexión y,
+// después, el histórico que se pida por COMM_TOPIC_REPLAY
+void outbox_task(void *pvParameters) {
+    static nivometro_data_t batch[MQTT_BATCH_SAMPLES];
+    storage_cursor_t replay_cur;
+    bool replaying = false;
+    
+    ESP_LOGI(TAG, "Iniciando tarea de reenvío del outbox");
+    
+    while (1) {
+        // Una petición nueva sustituye a la que esté en curso
+        uint64_t since_us;
+        if (communication_take_replay_request(&since_us) && storage_seek(since_us, &replay_cur) == ESP_OK) {
+            replaying = true;
+            ESP_LOGI(TAG, "Reenvío del histórico desde %llu us", (unsigned long long)since_us);
+        }
+        
+        bool pending = storage_outbox_count() > 0;
+        if ((!pending && !replaying) || !communication_wait_connected(OUTBOX_IDLE_POLL_MS)) {
+            vTaskDelay(pdMS_TO_TICKS(OUTBOX_IDLE_POLL_MS));
+            continue;
+        }
+        
+        // Lo no entregado va antes que el histórico pedido
+        if (!pending) {
+            replaying = replay_next(&replay_cur, batch);
+            continue;
+        }
+        
+        uint32_t first;
+        size_t n = storage_outbox_peek(batch, MQTT_BATCH_SAMPLES, &first);
+        if (n == 0) continue;
+        
+        // Solo se retiran del outbox cuando el broker confirma el lote (PUBACK QoS1)
+        int msg_id = publish_batch(batch, n);
+        if (communication_wait_published(msg_id, OUTBOX_ACK_TIMEOUT_MS)) {
+            storage_outbox_ack(first, n);
+            ESP_LOGI(TAG, "Outbox: %u muestras entregadas, %u pendientes",
+                     (unsigned)n, (unsigned)storage_outbox_count());
+            vTaskDelay(pdMS_TO_TICKS(OUTBOX_REPLAY_INTERVAL_MS));
+        } else {
+            ESP_LOGW(TAG, "Outbox: lote sin confirmar (msg_id=%d), reintento en %d ms",
+                     msg_id, OUTBOX_RETRY_DELAY_MS);
+            vTaskDelay(pdMS_TO_TICKS(OUTBOX_RETRY_DELAY_MS));
+        }
+    }
+}
+
+// Informa de las muestras que un consumidor perdió por quedarse una vuelta atrás en el bus
+static void report_bus_overflow(int consumer, const char *who, uint32_t *last_overflow) {
+    sample_bus_consumer_stats_t st;
+    
+    sample_bus_get_stats(&g_sample_bus, consumer, &st);
+    if (st.overflow != *last_overflow) {
+        ESP_LOGW(TAG, "%s: %lu muestras perdidas en el bus (%lu en total)", who,
+                 (unsigned long)(st.overflow - *last_overflow), (unsigned long)st.overflow);
+        *last_overflow = st.overflow;
+    }
+}
+
+// Publica muestras ya filtradas por el detector de cambios; las que el broker no confirma
+// (sin conexión, publicación rechazada o sin PUBACK) se guardan en el outbox
+static void deliver(const nivometro_data_t *samples, size_t n) {
+    if (MQTT_BATCH_SAMPLES <= 1) {
+        for (size_t i = 0; i < n; i++) {
+            if (!communication_wait_connected(0) || !publish_sample_topics(&samples[i])) {
+                store_for_later(&samples[i], 1);
+            }
+        }
+        return;
+    }
+    int msg_id = communication_wait_connected(0) ? publish_batch(samples, n) : -1;
+    if (!wait_delivered(&msg_id, 1)) {
+        store_for_later(samples, n);
     }
 }
 
 // Tarea de comunicación MQTT
 void communication_task(void *pvParameters) {
-    nivometro_data_t sensor_data;
-    char json_buffer[512];
+    static nivometro_data_t batch[MQTT_BATCH_SAMPLES];
+    size_t batch_count = 0;
+    TickType_t batch_started = 0;
+    uint32_t last_overflow = 0;
     
     ESP_LOGI(TAG, "Iniciando tarea de comunicación MQTT");
     
     while (1) {
-        // Esperar datos de sensores
-        if (xQueueReceive(sensor_data_queue, &sensor_data, portMAX_DELAY) == pdTRUE) {
-            
-            // Crear JSON con datos del ultrasonido
-            snprintf(json_buffer, sizeof(json_buffer),
-                    "{\"distance_cm\":%.2f,\"timestamp\":%llu,\"sensor\":\"hcsr04p\",\"status\":%s}",
-                    sensor_data.ultrasonic_distance_cm,
-                    sensor_data.timestamp_us,
-                    nivometro_is_sensor_working(sensor_data.sensor_status, 0) ? "true" : "false");
-            communication_publish(MQTT_TOPIC_ULTRASONIC, json_buffer);
-            
-            // Crear JSON con datos del peso
-            snprintf(json_buffer, sizeof(json_buffer),
-                    "{\"weight_g\":%.2f,\"timestamp\":%llu,\"sensor\":\"hx711\",\"status\":%s}",
-                    sensor_data.weight_grams,
-                    sensor_data.timestamp_us,
-                    nivometro_is_sensor_working(sensor_data.sensor_status, 1) ? "true" : "false");
-            communication_publish(MQTT_TOPIC_WEIGHT, json_buffer);
-            
-            // Crear JSON con datos del láser
-            snprintf(json_buffer, sizeof(json_buffer),
-                    "{\"distance_mm\":%.0f,\"timestamp\":%llu,\"sensor\":\"vl53l0x\",\"status\":%s}",
-                    sensor_data.laser_distance_mm,
-                    sensor_data.timestamp_us,
-                    nivometro_is_sensor_working(sensor_data.sensor_status, 2) ? "true" : "false");
-            communication_publish(MQTT_TOPIC_LASER, json_buffer);
-            
-            // Datos de estado general
-            snprintf(json_buffer, sizeof(json_buffer),
-                    "{\"battery_v\":%.2f,\"temp_c\":%d,\"sensor_mask\":%d,\"timestamp\":%llu}",
-                    sensor_data.battery_voltage,
-                    sensor_data.temperature_c,
-                    sensor_data.sensor_status,
-                    sensor_data.timestamp_us);
-            communication_publish(MQTT_TOPIC_STATUS, json_buffer);
+        // Esperar muestras nuevas (con plazo para no retener un lote incompleto indefinidamente)
+        uint32_t wait_ms = MQTT_BATCH_MAX_AGE_MS;
+        if (batch_count > 0) {
+            uint32_t age_ms = pdTICKS_TO_MS(xTaskGetTickCount() - batch_started);
+            wait_ms = age_ms < MQTT_BATCH_MAX_AGE_MS ? MQTT_BATCH_MAX_AGE_MS - age_ms : 0;
+        }
+        sample_bus_wait(&g_sample_bus, g_comm_consumer, 1, wait_ms);
+        
+        // Evaluar en sitio: solo las muestras que aportan información se copian al lote
+        const nivometro_data_t *span;
+        size_t n;
+        while ((n = sample_bus_peek(&g_sample_bus, g_comm_consumer, (const void **)&span, SAMPLE_BUS_SLOTS)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                change_reason_t reason = change_detector_check(&g_change_detector, &span[i]);
+                if (reason == CHANGE_SUPPRESSED) {
+                    continue;
+                }
+                if (reason == CHANGE_STATUS) {
+                    ESP_LOGI(TAG, "Cambio de estado de sensores: %s",
+                             nivometro_get_sensor_status_string(span[i].sensor_status));
+                }
+                if (batch_count == 0) {
+                    batch_started = xTaskGetTickCount();
+                }
+                batch[batch_count++] = span[i];
+                if (batch_count >= MQTT_BATCH_SAMPLES) {
+                    deliver(batch, batch_count);
+                    batch_count = 0;
+                }
+            }
+            sample_bus_release(&g_sample_bus, g_comm_consumer, n);
         }
         
-        vTaskDelay(pdMS_TO_TICKS(100)); // Small delay
+        // Un lote incompleto sale cuando su muestra más antigua es demasiado vieja
+        if (batch_count > 0 &&
+            xTaskGetTickCount() - batch_started >= pdMS_TO_TICKS(MQTT_BATCH_MAX_AGE_MS)) {
+            deliver(batch, batch_count);
+            batch_count = 0;
+        }
+        report_bus_overflow(g_comm_consumer, "comm_task", &last_overflow);
+    }
+}
+
+// Publica los contadores del informe por excepción y del bus en MQTT_TOPIC_DIAGNOSTICS
+static void publish_diagnostics(void) {
+    char json_buffer[320];
+    json_writer_t w;
+    const change_detector_stats_t *st = &g_change_detector.stats;
+    storage_stats_t ss;
+    diagnostics_stats_t ds;
+    
+    storage_get_stats(&ss);
+    diagnostics_get_stats(&ds);
+    json_writer_init(&w, json_buffer, sizeof(json_buffer));
+    json_obj_begin(&w, NULL);
+    json_write_uint(&w, "seen", st->seen);
+    json_write_uint(&w, "suppressed", st->suppressed);
+    json_write_uint(&w, "status", st->reasons[CHANGE_STATUS]);
+    json_write_uint(&w, "deadband", st->reasons[CHANGE_DEADBAND]);
+    json_write_uint(&w, "heartbeat", st->reasons[CHANGE_HEARTBEAT]);
+    json_write_uint(&w, "bus_dropped", g_sample_bus.producer_dropped);
+    json_write_uint(&w, "flash_blocks", ss.flushes);
+    json_write_uint(&w, "flash_bytes", ss.bytes_written);
+    json_write_uint(&w, "delivered", ss.delivered);
+    json_write_uint(&w, "errors", ds.errors);
+    json_write_uint(&w, "diag_evicted", ds.evicted);
+    json_write_uint(&w, "timestamp", time_sync_now_us());
+    json_obj_end(&w);
+    if (json_writer_finish(&w) >= 0 && communication_wait_connected(0)) {
+        communication_publish(MQTT_TOPIC_DIAGNOSTICS, json_buffer);
+    }
+}
+
+// Tarea de diagnóstico: registra los cambios de estado de los sensores y los contadores del bus
+void diagnostics_task(void *pvParameters) {
+    uint8_t last_status = NIVOMETRO_SENSOR_ALL;
+    uint32_t last_overflow = 0;
+    TickType_t last_report = xTaskGetTickCount();
+    
+    ESP_LOGI(TAG, "Iniciando tarea de diagnóstico");
+    
+    while (1) {
+        sample_bus_wait(&g_sample_bus, g_diag_consumer, 1, DIAG_BUS_REPORT_MS);
+        
+        const nivometro_data_t *span;
+        size_t n;
+        while ((n = sample_bus_peek(&g_sample_bus, g_diag_consumer, (const void **)&span, SAMPLE_BUS_SLOTS)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                if (span[i].sensor_status != last_status) {
+                    char details[64];
+                    snprintf(details, sizeof(details), "0x%02x -> 0x%02x (%s)", last_status,
+                             span[i].sensor_status, nivometro_get_sensor_status_string(span[i].sensor_status));
+                    diagnostics_record_event("sensor_status", details);
+                    last_status = span[i].sensor_status;
+                }
+            }
+            sample_bus_release(&g_sample_bus, g_diag_consumer, n);
+        }
+        report_bus_overflow(g_diag_consumer, "diag_task", &last_overflow);
+        diagnostics_flush(false);                      // Solo escribe en nvs con un lote o un registro antiguo pendiente
+        
+        if (xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(DIAG_BUS_REPORT_MS)) {
+            sample_bus_consumer_stats_t comm;
+            sample_bus_get_stats(&g_sample_bus, g_comm_consumer, &comm);
+            ESP_LOGI(TAG, "Bus de muestras: %lu publicadas, %lu descartadas, comm %lu pendientes / %lu perdidas",
+                     (unsigned long)g_sample_bus.published, (unsigned long)g_sample_bus.producer_dropped,
+                     (unsigned long)comm.pending, (unsigned long)comm.overflow);
+            ESP_LOGI(TAG, "Informe por excepción: %lu de %lu muestras suprimidas",
+                     (unsigned long)g_change_detector.stats.suppressed,
+                     (unsigned long)g_change_detector.stats.seen);
+            publish_diagnostics();
+            last_report = xTaskGetTickCount();
+        }
     }
 }
 
@@ -175,6 +547,7 @@ static esp_err_t setup_nivometro(void) {
         .hcsr04p_trigger_pin = HCSR04P_TRIGGER_PIN,
         .hcsr04p_echo_pin = HCSR04P_ECHO_PIN,
         .hcsr04p_cal_factor = HCSR04P_CAL_FACTOR,
+        .hcsr04p_burst_pings = HCSR04P_BURST_PINGS,
         
         // HX711
         .hx711_dout_pin = HX711_DOUT_PIN,
@@ -186,7 +559,11 @@ static esp_err_t setup_nivometro(void) {
         .vl53l0x_i2c_port = I2C_MASTER_NUM,
         .vl53l0x_address = VL53L0X_ADDRESS,
         .vl53l0x_accuracy = VL53L0X_ACCURACY_BETTER,
-        .vl53l0x_cal_factor = VL53L0X_CAL_FACTOR
+        .vl53l0x_cal_factor = VL53L0X_CAL_FACTOR,
+        .vl53l0x_gpio1_pin = VL53L0X_GPIO1_PIN,
+        
+        // Adquisición solapada de los tres sensores
+        .concurrent_acquisition = true
     };
     
     return nivometro_init(&g_nivometro, &config);
@@ -205,6 +582,9 @@ void app_main(void) {
     }
     ESP_ERROR_CHECK(ret);
     
+    // Base de tiempo UTC conservada en rtc (válida tras deep sleep sin esperar a sntp)
+    time_sync_init();
+    
     // Inicializar componentes base (Antonio Mata)
     ESP_ERROR_CHECK(system_config_init());
     ESP_ERROR_CHECK(power_manager_init());
@@ -218,31 +598,62 @@ void app_main(void) {
     // Configurar nivómetro con sensores específicos
     ESP_ERROR_CHECK(setup_nivometro());
     
-    // Inicializar comunicación
-    ESP_ERROR_CHECK(communication_init());
-    ESP_LOGI(TAG, "✅ Comunicación MQTT inicializada");
+    if (NIVOMETRO_DUTY_CYCLE) {
+        // Tara solo en el arranque en frío: al despertar se restaura la de la memoria rtc
+        if (power_manager_is_cold_boot()) {
+            nivometro_tare_scale(&g_nivometro);
+            rtc_scale_offset = g_nivometro.scale.offset;
+        } else {
+            g_nivometro.scale.offset = rtc_scale_offset;
+        }
+        // La radio la enciende tasks.c solo cuando toca
+        tasks_start_all(&g_nivometro);
+        return;
+    }
+    
+    // Inicializar comunicación (sin wifi en plazo se sigue; las muestras van al outbox)
+    ret = communication_init();
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "✅ Comunicación MQTT inicializada");
+    } else {
+        ESP_LOGW(TAG, "⚠️ Sin wifi al arrancar: %s", esp_err_to_name(ret));
+    }
     
-    // Crear cola para datos de sensores
-    sensor_data_queue = xQueueCreate(5, sizeof(nivometro_data_t));
-    if (!sensor_data_queue) {
-        ESP_LOGE(TAG, "Error creando cola de datos");
+    // Bus de muestras y sus consumidores (antes de arrancar el productor)
+    if (sample_bus_init(&g_sample_bus, g_sample_slots, sizeof(nivometro_data_t), SAMPLE_BUS_SLOTS) != ESP_OK) {
+        ESP_LOGE(TAG, "Error creando el bus de muestras");
         return;
     }
+    g_comm_consumer = sample_bus_subscribe(&g_sample_bus, "comm");
+    g_diag_consumer = sample_bus_subscribe(&g_sample_bus, "diag");
+    
+    // Solo se publican cambios fuera de banda, cambios de estado y un latido por hora
+    change_detector_init(&g_change_detector, NULL);
     
     // Calibración inicial de la balanza
     ESP_LOGI(TAG, "🔧 Realizando tara inicial...");
     nivometro_tare_scale(&g_nivometro);
     
+    // Planificar la lectura de cada sensor
+    setup_scheduler();
+    
     // Crear tareas
     xTaskCreate(sensor_task, "sensor_task", 8192, NULL, 5, NULL);
     xTaskCreate(communication_task, "comm_task", 8192, NULL, 4, NULL);
+    xTaskCreate(outbox_task, "outbox_task", 4096, NULL, 3, NULL);
+    xTaskCreate(diagnostics_task, "diag_task", 3072, NULL, 2, NULL);
     
     ESP_LOGI(TAG, "🚀 Sistema nivómetro iniciado correctamente");
-    ESP_LOGI(TAG, "📡 Enviando datos a tópicos MQTT:");
-    ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_ULTRASONIC);
-    ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_WEIGHT);
-    ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_LASER);
-    ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_STATUS);
+    if (MQTT_BATCH_SAMPLES > 1) {
+        ESP_LOGI(TAG, "📡 Enviando lotes de %d muestras a %s", MQTT_BATCH_SAMPLES,
+                 MQTT_BATCH_BINARY ? COMM_TOPIC_BATCH_BIN : COMM_TOPIC_BATCH);
+    } else {
+        ESP_LOGI(TAG, "📡 Enviando datos a tópicos MQTT:");
+        ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_ULTRASONIC);
+        ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_WEIGHT);
+        ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_LASER);
+        ESP_LOGI(TAG, "   - %s", MQTT_TOPIC_STATUS);
+    }
 }
 
 
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Puente MQTT: lotes binarios del nivómetro -> lotes json.
+
+Se suscribe a nivometro/antartica/batch/bin, decodifica los esquemas de
+components/sample_codec (v1 fijo, v2 comprimido) y republica el lote en nivometro/antartica/batch
+con el mismo json que genera communication_publish_batch(), de modo que
+Telegraf e InfluxDB reciben exactamente los mismos campos.
+
+Uso:
+    python3 nivometro_bin_bridge.py [--broker mosquitto] [--port 1883]
+    python3 nivometro_bin_bridge.py --decode lote.bin     # decodifica un fichero
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+TOPIC_BIN = "nivometro/antartica/batch/bin"
+TOPIC_JSON = "nivometro/antartica/batch"
+
+# Debe coincidir con sample_codec.h
+MAGIC = b"NV"
+SCHEMA_V1 = 1
+SCHEMA_V2 = 2
+HEADER = struct.Struct("<2sBBQ")          # magic, esquema, n, base_ts_us
+RECORD_V1 = struct.Struct("<IHBiHBHb")    # dt_ms, us_ccm, us_q, w_cg, l_mm, st, bat_mv, t_c
+V2_BUCKETS = (6, 12, 20, 64)               # Bits tras los prefijos '10', '110', '1110', '1111'
+TEMP_UNKNOWN = -128                        # NIVOMETRO_TEMP_UNKNOWN: sin medida del aire
+
+
+def sample(ts, us_ccm, us_q, w_cg, l_mm, st, bat_mv, t_c):
+    s = {
+        "ts": ts,
+        "us_cm": us_ccm / 100.0,
+        "us_q": us_q / 100.0,
+        "w_g": w_cg / 100.0,
+        "l_mm": l_mm,
+        "st": st,
+        "bat_v": bat_mv / 1000.0,
+    }
+    # Igual que communication_publish_batch(): sin medida no se envía t_c
+    if t_c != TEMP_UNKNOWN:
+        s["t_c"] = t_c
+    return s
+
+
+class BitReader:
+    """Flujo de bits del más significativo al menos significativo."""
+
+    def __init__(self, data):
+        self.value = int.from_bytes(data, "big")
+        self.left = len(data) * 8
+
+    def bits(self, n):
+        if n > self.left:
+            raise ValueError("lote truncado")
+        self.left -= n
+        return (self.value >> self.left) & ((1 << n) - 1)
+
+    def varint(self):
+        ones = 0
+        while ones < len(V2_BUCKETS) and self.bits(1):
+            ones += 1
+        if ones == 0:
+            return 0
+        z = self.bits(V2_BUCKETS[ones - 1])
+        return (z >> 1) ^ -(z & 1)
+
+
+def decode_v2(payload, count, base_ts):
+    reader = BitReader(payload[HEADER.size:])
+    t_ms = dt_ms = 0
+    q = [0] * 6                           # us_ccm, us_q, w_cg, l_mm, bat_mv, t_c
+    st = 0
+    samples = []
+    for _ in range(count):
+        dt_ms += reader.varint()
+        t_ms += dt_ms
+        q = [v + reader.varint() for v in q]
+        if reader.bits(1):
+            st = reader.bits(6)
+        us_ccm, us_q, w_cg, l_mm, bat_mv, t_c = q
+        samples.append(sample(base_ts + t_ms * 1000, us_ccm, us_q, w_cg, l_mm, st & 0x07, bat_mv, t_c))
+    return samples
+
+
+def decode_batch(payload):
+    """Devuelve la lista de muestras del lote o lanza ValueError."""
+    if len(payload) < HEADER.size:
+        raise ValueError("mensaje demasiado corto")
+    magic, schema, count, base_ts = HEADER.unpack_from(payload, 0)
+    if magic != MAGIC:
+        raise ValueError("magic incorrecto")
+    if schema == SCHEMA_V2:
+        return decode_v2(payload, count, base_ts)
+    if schema != SCHEMA_V1:
+        raise ValueError("esquema %d no soportado" % schema)
+    if len(payload) < HEADER.size + count * RECORD_V1.size:
+        raise ValueError("lote truncado")
+
+    samples = []
+    for i in range(count):
+        dt_ms, us_ccm, us_q, w_cg, l_mm, st, bat_mv, t_c = RECORD_V1.unpack_from(
+            payload, HEADER.size + i * RECORD_V1.size)
+        samples.append(sample(base_ts + dt_ms * 1000, us_ccm, us_q, w_cg, l_mm, st, bat_mv, t_c))
+    return samples
+
+
+def to_json(samples):
+    return json.dumps({"v": 1, "n": len(samples), "s": samples}, separators=(",", ":"))
+
+
+def run_bridge(broker, port):
+    import paho.mqtt.client as mqtt
+
+    def on_connect(client, userdata, flags, rc, *args):
+        print("Conectado a %s:%d, suscrito a %s" % (broker, port, TOPIC_BIN), flush=True)
+        client.subscribe(TOPIC_BIN, qos=1)
+
+    def on_message(client, userdata, msg):
+        try:
+            samples = decode_batch(msg.payload)
+        except ValueError as e:
+            print("Lote descartado (%d bytes): %s" % (len(msg.payload), e), file=sys.stderr, flush=True)
+            return
+        client.publish(TOPIC_JSON, to_json(samples), qos=1)
+
+    client = mqtt.Client(client_id="nivometro-bin-bridge")
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(broker, port, keepalive=60)
+    client.loop_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--broker", default="mosquitto")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--decode", metavar="FICHERO", help="decodifica un lote binario y lo imprime en json")
+    args = parser.parse_args()
+
+    if args.decode:
+        with open(args.decode, "rb") as f:
+            print(to_json(decode_batch(f.read())))
+        return
+    run_bridge(args.broker, args.port)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,244 @@
+// tools/flash_log_bench.c
+//
+// Pruebas y benchmark en host de flash_log sobre una imagen en fichero con semántica NOR
+// (tools/host/flash_log_file.c), con la geometría de la partición "samples".
+//
+// Pruebas, con registros de 64 y de 256 bytes: remontaje con y sin vuelta completa del
+// anillo, registros consumidos que sobreviven al remontaje, cortes de alimentación a mitad
+// de registro y de cabecera de sector, y cambio de tamaño de registro entre montajes. Benchmark: ritmo de escritura, bytes programados y borrados por registro,
+// y tiempo y lecturas de montaje con la partición llena.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Itools/host -Icomponents/flash_log/include tools/flash_log_bench.c tools/host/flash_log_file.c components/flash_log/flash_log.c -o /tmp/flash_log_bench
+//   /tmp/flash_log_bench [imagen]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flash_log.h"
+#include "flash_log_file.h"
+
+#define PARTITION_SIZE  0x80000     // Igual que "samples" en partitions.csv
+#define SECTOR_SIZE     4096
+#define PAYLOAD_SIZE    40          // sizeof(nivometro_data_t) en el esp32
+
+static const char *image = "/tmp/flash_log_bench.img";
+static uint32_t record_size;
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_payload(uint8_t *p, uint32_t seq)
+{
+    for (int i = 0; i < PAYLOAD_SIZE; i++) {
+        p[i] = (uint8_t)(seq * 31 + i);
+    }
+}
+
+// Imagen nueva y montada
+static void fresh(flash_file_t *ff, flash_log_t *log)
+{
+    flash_log_io_t io;
+    remove(image);
+    if (flash_file_open(ff, image, PARTITION_SIZE, SECTOR_SIZE, &io) != 0 ||
+        flash_log_mount(log, &io, record_size) != ESP_OK) {
+        printf("No se pudo crear %s\n", image);
+        exit(2);
+    }
+}
+
+// Cierra y vuelve a montar la misma imagen (como un reinicio)
+static void remount(flash_file_t *ff, flash_log_t *log)
+{
+    flash_log_io_t io;
+    flash_file_close(ff);
+    if (flash_file_open(ff, image, PARTITION_SIZE, SECTOR_SIZE, &io) != 0 ||
+        flash_log_mount(log, &io, record_size) != ESP_OK) {
+        printf("No se pudo remontar %s\n", image);
+        exit(2);
+    }
+}
+
+static void append_n(flash_log_t *log, uint32_t n)
+{
+    uint8_t p[PAYLOAD_SIZE];
+    for (uint32_t i = 0; i < n; i++) {
+        make_payload(p, log->head);
+        flash_log_append(log, p, sizeof(p), NULL);
+    }
+}
+
+// Todo [oldest, head) legible y con el contenido esperado, salvo las secuencias en skip
+static int verify_range(flash_log_t *log, uint32_t skip)
+{
+    uint8_t p[FLASH_LOG_PAYLOAD_MAX], want[PAYLOAD_SIZE];
+    int bad = 0;
+    for (uint32_t seq = log->oldest; seq < log->head; seq++) {
+        size_t len = sizeof(p);
+        esp_err_t err = flash_log_read(log, seq, p, &len);
+        if (seq == skip) {
+            bad += err != ESP_ERR_INVALID_CRC;
+            continue;
+        }
+        make_payload(want, seq);
+        bad += err != ESP_OK || len != PAYLOAD_SIZE || memcmp(p, want, len) != 0;
+    }
+    return bad;
+}
+
+static void test_remount(void)
+{
+    flash_file_t ff;
+    flash_log_t log;
+
+    printf("remontaje sin vuelta\n");
+    fresh(&ff, &log);
+    append_n(&log, 1000);
+    flash_log_consume(&log, 400);
+    remount(&ff, &log);
+    CHECK(log.head == 1000);
+    CHECK(log.oldest == 0);
+    CHECK(log.first_pending == 400);
+    CHECK(flash_log_pending(&log) == 600);
+    CHECK(verify_range(&log, UINT32_MAX) == 0);
+
+    printf("remontaje tras varias vueltas\n");
+    uint32_t cap = flash_log_capacity(&log);
+    append_n(&log, 3 * cap + 17);
+    uint32_t head = log.head, oldest = log.oldest, dropped = log.stats.dropped;
+    flash_log_consume(&log, head - 100);
+    remount(&ff, &log);
+    CHECK(log.head == head);
+    CHECK(log.oldest == oldest);
+    CHECK(head - oldest >= cap);
+    CHECK(log.first_pending == head - 100);
+    CHECK(dropped > 0);
+    CHECK(verify_range(&log, UINT32_MAX) == 0);
+
+    printf("remontaje con el sector de cabeza justo lleno\n");
+    append_n(&log, log.per_sector - log.head % log.per_sector);
+    head = log.head;
+    remount(&ff, &log);
+    CHECK(log.head == head);
+    append_n(&log, 1);
+    CHECK(log.head == head + 1);
+    remount(&ff, &log);
+    CHECK(log.head == head + 1);
+    CHECK(verify_range(&log, UINT32_MAX) == 0);
+    flash_file_close(&ff);
+}
+
+static void test_power_cut(void)
+{
+    flash_file_t ff;
+    flash_log_t log;
+    uint8_t p[PAYLOAD_SIZE];
+
+    printf("corte a mitad de registro\n");
+    fresh(&ff, &log);
+    append_n(&log, 100);
+    ff.cut_after = ff.bytes_written + 20;       // Se escriben 20 de los 52 bytes del registro 100
+    make_payload(p, log.head);
+    CHECK(flash_log_append(&log, p, sizeof(p), NULL) != ESP_OK);
+    ff.cut_after = 0;
+    remount(&ff, &log);
+    CHECK(log.head == 101);                     // El hueco a medias no se reutiliza
+    CHECK(verify_range(&log, 100) == 0);
+    append_n(&log, 50);
+    remount(&ff, &log);
+    CHECK(log.head == 151);
+    CHECK(verify_range(&log, 100) == 0);
+
+    printf("corte al escribir la cabecera de un sector nuevo\n");
+    append_n(&log, log.per_sector - log.head % log.per_sector);
+    uint32_t head = log.head;
+    ff.cut_after = ff.bytes_written + 6;
+    make_payload(p, log.head);
+    CHECK(flash_log_append(&log, p, sizeof(p), NULL) != ESP_OK);
+    ff.cut_after = 0;
+    remount(&ff, &log);
+    CHECK(log.head == head);                    // El sector a medias se vuelve a abrir
+    append_n(&log, 10);
+    remount(&ff, &log);
+    CHECK(log.head == head + 10);
+    CHECK(verify_range(&log, 100) == 0);
+    flash_file_close(&ff);
+}
+
+// Los sectores de otro tamaño de registro no se interpretan: la región se ve vacía
+static void test_record_size_change(void)
+{
+    flash_file_t ff;
+    flash_log_t log;
+    uint32_t saved = record_size;
+
+    printf("cambio de tamaño de registro\n");
+    fresh(&ff, &log);
+    append_n(&log, 3 * log.per_sector + 5);
+    record_size = saved == 64 ? 128 : 64;
+    remount(&ff, &log);
+    CHECK(log.head == 0 && flash_log_pending(&log) == 0);
+    append_n(&log, 10);
+    remount(&ff, &log);
+    CHECK(log.head == 10);
+    CHECK(verify_range(&log, UINT32_MAX) == 0);
+    record_size = saved;
+    flash_file_close(&ff);
+}
+
+static void bench(void)
+{
+    flash_file_t ff;
+    flash_log_t log;
+
+    fresh(&ff, &log);
+    uint32_t n = 2 * flash_log_capacity(&log);
+    double t0 = now_s();
+    append_n(&log, n);
+    double t_append = now_s() - t0;
+    printf("\nescritura: %u registros en %.3f s (%.0f registros/s en host)\n", n, t_append, n / t_append);
+    printf("  por registro: %.1f bytes programados, %.4f borrados de sector (%.1f bytes borrados)\n",
+           (double)ff.bytes_written / n, (double)ff.erases / n, (double)ff.erases * SECTOR_SIZE / n);
+
+    ff.reads = 0;
+    t0 = now_s();
+    remount(&ff, &log);
+    double t_mount = now_s() - t0;
+    printf("montaje con %u sectores llenos: %.3f ms, %u lecturas (%u en flash_log)\n",
+           log.sectors, t_mount * 1e3, ff.reads, log.stats.mount_reads);
+
+    t0 = now_s();
+    uint32_t pending = flash_log_pending(&log);
+    flash_log_consume(&log, log.head);
+    printf("consumo de %u registros: %.3f ms\n", pending, (now_s() - t0) * 1e3);
+    flash_file_close(&ff);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t sizes[] = { 64, 256 };
+    if (argc > 1) {
+        image = argv[1];
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        record_size = sizes[i];
+        printf("%sregistros de %u bytes\n", i ? "\n" : "", record_size);
+        test_remount();
+        test_power_cut();
+        test_record_size_change();
+        bench();
+    }
+    remove(image);
+    printf("\n%s\n", failures ? "FALLO" : "OK");
+    return failures != 0;
+}
@@ -0,0 +1,220 @@
+// tools/flash_log_index_bench.c
+//
+// Pruebas y benchmark en host de flash_log_index sobre un registro sintético de un millón
+// de registros (imagen en fichero con semántica NOR, tools/host/flash_log_file.c).
+//
+// Cada registro lleva como clave un timestamp que no decrece (dos registros por minuto
+// con la misma clave). El anillo da la vuelta, así que el índice trabaja sobre un rango
+// [oldest, head) que no empieza en 0, y se dañan registros sueltos y un sector entero.
+//
+// Pruebas: búsquedas aleatorias contra el resultado esperado calculado a mano, con el
+// índice frío (tras remontar) y caliente o mantenido al añadir, y registro
+// pendiente más antiguo tras consumir. Benchmark: lecturas de flash por búsqueda.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Itools/host -Icomponents/flash_log/include tools/flash_log_index_bench.c tools/host/flash_log_file.c components/flash_log/flash_log.c components/flash_log/flash_log_index.c -lm -o /tmp/flash_log_index_bench
+//   /tmp/flash_log_index_bench [imagen]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flash_log.h"
+#include "flash_log_index.h"
+#include "flash_log_file.h"
+
+#define RECORD_SIZE     64
+#define SECTOR_SIZE     4096
+#define SECTORS         17000       // ~1.07 millones de registros de capacidad
+#define APPENDED        1200000     // Da la vuelta al anillo
+#define QUERIES         20000
+#define KEY_BASE        1700000000000000ULL
+#define KEY_STEP        60000000ULL // Dos registros por minuto con la misma clave
+
+static const char *image = "/tmp/flash_log_index_bench.img";
+static uint8_t *corrupt;            // Registros dañados a propósito (por secuencia)
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t key_of(uint32_t seq)
+{
+    return KEY_BASE + (uint64_t)(seq / 2) * KEY_STEP;
+}
+
+static bool payload_key(const void *payload, size_t len, uint64_t *key)
+{
+    if (len < sizeof(*key)) return false;
+    memcpy(key, payload, sizeof(*key));
+    return true;
+}
+
+// Primer registro legible con clave >= key, calculado sin flash
+static uint32_t expected_seek(const flash_log_t *log, uint64_t key)
+{
+    uint32_t seq = 0;
+    if (key > KEY_BASE) {
+        seq = (uint32_t)(2 * ((key - KEY_BASE + KEY_STEP - 1) / KEY_STEP));
+    }
+    if (seq < log->oldest) seq = log->oldest;
+    while (seq < log->head && corrupt[seq]) seq++;
+    return seq < log->head ? seq : log->head;
+}
+
+// El índice puede devolver una secuencia anterior si entre medias solo hay registros dañados
+static bool seek_ok(const flash_log_t *log, uint32_t got, uint32_t want)
+{
+    if (got > want || got < log->oldest) return false;
+    for (uint32_t s = got; s < want; s++) {
+        if (!corrupt[s]) return false;
+    }
+    return true;
+}
+
+static void damage(flash_log_t *log, uint32_t seq)
+{
+    static const uint8_t zeros[8] = { 0 };
+    uint32_t offset = ((seq / log->per_sector) % log->sectors) * SECTOR_SIZE +
+                      (1 + seq % log->per_sector) * RECORD_SIZE + FLASH_LOG_RECORD_HEADER;
+    log->io.write(log->io.ctx, offset + 8, zeros, sizeof(zeros));     // Payload tras la clave: falla el crc
+    corrupt[seq] = 1;
+}
+
+static void mount(flash_file_t *ff, flash_log_t *log)
+{
+    flash_log_io_t io;
+    if (flash_file_open(ff, image, (uint32_t)SECTORS * SECTOR_SIZE, SECTOR_SIZE, &io) != 0 ||
+        flash_log_mount(log, &io, RECORD_SIZE) != ESP_OK) {
+        printf("No se pudo montar %s\n", image);
+        exit(2);
+    }
+}
+
+// Búsquedas aleatorias; devuelve lecturas máximas por búsqueda
+static uint32_t run_queries(flash_log_index_t *idx, int n, const char *label)
+{
+    flash_log_t *log = idx->log;
+    uint64_t lo = key_of(log->oldest) - 10 * KEY_STEP;
+    uint64_t span = key_of(log->head - 1) - lo + 20 * KEY_STEP;
+    uint32_t max_reads = 0, reads0 = idx->reads;
+    double t0 = now_s();
+
+    for (int i = 0; i < n; i++) {
+        uint64_t key = lo + (uint64_t)((double)rand() / RAND_MAX * span);
+        uint32_t before = idx->reads, seq;
+        CHECK(flash_log_index_seek(idx, key, &seq) == ESP_OK);
+        CHECK(seek_ok(log, seq, expected_seek(log, key)));
+        if (idx->reads - before > max_reads) max_reads = idx->reads - before;
+    }
+    double t = now_s() - t0;
+    printf("  %s: %d búsquedas, %.2f lecturas de media, %u como máximo, %.1f us por búsqueda (host)\n",
+           label, n, (double)(idx->reads - reads0) / n, max_reads, t / n * 1e6);
+    return max_reads;
+}
+
+int main(int argc, char **argv)
+{
+    static flash_log_index_entry_t entries[SECTORS];
+    flash_file_t ff;
+    flash_log_t log;
+    flash_log_index_t idx;
+    uint8_t payload[RECORD_SIZE - FLASH_LOG_RECORD_HEADER];
+
+    if (argc > 1) {
+        image = argv[1];
+    }
+    corrupt = calloc(APPENDED, 1);
+    srand(1);
+    remove(image);
+
+    printf("registro sintético: %d registros de %d bytes en %d sectores\n", APPENDED, RECORD_SIZE, SECTORS);
+    mount(&ff, &log);
+    flash_log_index_init(&idx, &log, payload_key, entries, SECTORS);
+    double t0 = now_s();
+    memset(payload, 0x5a, sizeof(payload));
+    for (uint32_t i = 0; i < APPENDED; i++) {
+        uint64_t key = key_of(log.head);
+        uint32_t seq;
+        memcpy(payload, &key, sizeof(key));
+        if (flash_log_append(&log, payload, sizeof(payload), &seq) == ESP_OK) {
+            flash_log_index_note(&idx, seq, key);
+        }
+    }
+    printf("  escritura con índice incremental: %.2f s, retenidos [%u, %u) = %u registros\n",
+           now_s() - t0, log.oldest, log.head, log.head - log.oldest);
+    CHECK(log.head - log.oldest > 1000000);
+
+    // Registros dañados: sueltos, al principio de un sector y un sector entero
+    for (int i = 0; i < 200; i++) {
+        damage(&log, log.oldest + (uint32_t)((double)rand() / RAND_MAX * (log.head - log.oldest - 1)));
+    }
+    uint32_t k = (log.oldest + log.head) / 2 / log.per_sector;
+    damage(&log, (k + 3) * log.per_sector);
+    for (uint32_t s = k * log.per_sector; s < (k + 1) * log.per_sector; s++) {
+        damage(&log, s);
+    }
+    damage(&log, log.head - 1);
+
+    printf("índice mantenido al añadir\n");
+    uint32_t limit = 2 * (uint32_t)ceil(log2(log.per_sector)) + 8;
+    CHECK(run_queries(&idx, QUERIES, "caliente") <= limit + 2 * log.per_sector);
+
+    printf("índice frío tras remontar\n");
+    flash_file_close(&ff);
+    mount(&ff, &log);
+    flash_log_index_init(&idx, &log, payload_key, entries, SECTORS);
+    uint32_t cold = run_queries(&idx, 1, "primera");
+    uint32_t bound = 2 * (uint32_t)ceil(log2(SECTORS)) + (uint32_t)ceil(log2(log.per_sector)) + 2;
+    printf("  cota O(log n): %u lecturas (sin contar registros dañados saltados)\n", bound);
+    CHECK(cold <= bound + log.per_sector);
+    run_queries(&idx, 1000, "siguientes 1000");
+    run_queries(&idx, QUERIES, "caliente");
+
+    printf("pendiente más antiguo\n");
+    uint32_t seq, consumed = log.oldest + (log.head - log.oldest) / 3;
+    uint64_t key;
+    while (corrupt[consumed]) consumed++;
+    flash_log_consume(&log, consumed);
+    flash_file_close(&ff);
+    mount(&ff, &log);
+    flash_log_index_init(&idx, &log, payload_key, entries, SECTORS);
+    uint32_t reads = ff.reads;
+    CHECK(flash_log_index_oldest_pending(&idx, &seq, &key) == ESP_OK);
+    CHECK(seq == consumed && key == key_of(consumed));
+    printf("  secuencia %u en %u lecturas (montaje: %u lecturas)\n", seq, ff.reads - reads, log.stats.mount_reads);
+
+    // first_pending al principio de un sector: la entrada caliente da el resultado sin leer flash
+    uint32_t boundary = (seq / log.per_sector + 1) * log.per_sector, expected = boundary;
+    while (corrupt[expected]) expected++;
+    flash_log_consume(&log, boundary);
+    CHECK(flash_log_index_oldest_pending(&idx, &seq, &key) == ESP_OK);
+    reads = ff.reads;
+    CHECK(flash_log_index_oldest_pending(&idx, &seq, &key) == ESP_OK);
+    CHECK(seq == expected && key == key_of(expected) && ff.reads == reads);
+    printf("  principio de sector con el índice caliente: secuencia %u en %u lecturas\n", seq, ff.reads - reads);
+
+    // Sector entero ilegible: se salta por su entrada y se sigue en el siguiente
+    expected = (k + 1) * log.per_sector;
+    while (corrupt[expected]) expected++;
+    flash_log_consume(&log, k * log.per_sector);
+    CHECK(flash_log_index_oldest_pending(&idx, &seq, &key) == ESP_OK);
+    CHECK(seq == expected && key == key_of(expected));
+    flash_log_consume(&log, log.head);
+    CHECK(flash_log_index_oldest_pending(&idx, &seq, &key) == ESP_ERR_NOT_FOUND);
+
+    flash_file_close(&ff);
+    remove(image);
+    free(corrupt);
+    printf("\n%s\n", failures ? "FALLO" : "OK");
+    return failures != 0;
+}
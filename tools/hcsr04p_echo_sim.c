@@ -0,0 +1,255 @@
+// tools/hcsr04p_echo_sim.c
+//
+// Prueba en host del driver HC-SR04P (components/hcsr04p) con flancos de echo simulados.
+// Un reloj simulado sustituye a esp_timer_get_time() y el "hardware" programa la subida y
+// bajada del pin echo al terminar el pulso de trigger.
+//
+//   - Polling: cada vuelta del bucle cuesta ~1 us de cpu y, de vez en cuando, la tarea pierde
+//     la cpu (pila wifi) unos cientos de us, que es lo que mete jitter en la serie de nieve.
+//   - Interrupción: la ISR se llama en cada flanco con una latencia de unos pocos us.
+//
+// Compara el error frente a la distancia real y la cpu ocupada por medida en los dos caminos,
+// y comprueba los casos límite de la ISR: echo tardío tras la bajada, bajada sin subida,
+// callback con las marcas de tiempo y timeout sin echo.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Itools/host -Icomponents/hcsr04p/include tools/hcsr04p_echo_sim.c components/hcsr04p/hcsr04p.c -lm -lpthread -o /tmp/hcsr04p_echo_sim
+//   /tmp/hcsr04p_echo_sim [medidas]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hcsr04p.h"
+#include "soc/gpio_reg.h"
+
+#define TRIGGER_PIN         5
+#define ECHO_PIN            18
+#define SENSOR_DELAY_US     450         // Del fin del trigger al inicio del echo (ráfaga de 8 ciclos)
+#define POLL_COST_US        1           // Coste de cpu de una vuelta del bucle de polling
+#define PREEMPT_PER_MILLE   2           // Probabilidad por vuelta de perder la cpu
+#define PREEMPT_MAX_US      300
+#define ISR_LATENCY_MAX_US  4           // Latencia de entrada a la ISR de GPIO
+#define ISR_COST_US         2           // Coste estimado de una entrada a la ISR
+#define MIN_CM              20.0
+#define MAX_CM              400.0
+
+// Reloj y pin simulados
+static int64_t sim_now_us;
+static int64_t rise_at, fall_at;        // Echo programado (-1 si no hay)
+static int64_t late_rise_at;            // Segundo echo tardío (-1 si no hay)
+static int echo_level;
+static int trigger_level;
+static int polling;                     // El bucle de polling cobra cpu en cada lectura del reloj
+static int64_t busy_us;                 // Cpu ocupada en la medida en curso
+static unsigned isr_entries;
+static gpio_isr_t echo_isr;
+static void *echo_isr_arg;
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * ((double)rand() / RAND_MAX);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    int64_t now = sim_now_us;
+    if (polling) {
+        sim_now_us += POLL_COST_US;
+        busy_us += POLL_COST_US;
+        if (rand() % 1000 < PREEMPT_PER_MILLE) {
+            sim_now_us += (int64_t)uniform(50, PREEMPT_MAX_US);     // Tiempo en otra tarea: no es cpu nuestra
+        }
+    }
+    return now;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    sim_now_us += us;
+    busy_us += us;
+}
+
+uint32_t host_reg_read(uint32_t reg)
+{
+    return reg == GPIO_IN_REG && echo_level ? 1UL << ECHO_PIN : 0;
+}
+
+void host_reg_write(uint32_t reg, uint32_t value)
+{
+    (void)reg;
+    (void)value;
+}
+
+// Nivel del echo en el instante actual (camino de polling)
+static int echo_level_now(void)
+{
+    return rise_at >= 0 && sim_now_us >= rise_at && sim_now_us < fall_at;
+}
+
+// Flanco entregado a la ISR con algo de latencia
+static void deliver_edge(int level, int64_t at)
+{
+    echo_level = level;
+    sim_now_us = at + (int64_t)uniform(0, ISR_LATENCY_MAX_US);
+    isr_entries++;
+    busy_us += ISR_COST_US;
+    echo_isr(echo_isr_arg);
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (pin != TRIGGER_PIN) {
+        return ESP_OK;
+    }
+    // Fin del pulso de trigger: el sensor emite y el echo llega más tarde
+    if (trigger_level && !level && rise_at >= 0) {
+        int64_t duration = fall_at - rise_at;
+        rise_at = sim_now_us + SENSOR_DELAY_US;
+        fall_at = rise_at + duration;
+        if (echo_isr != NULL && !polling) {
+            deliver_edge(1, rise_at);
+            deliver_edge(0, fall_at);
+            if (late_rise_at >= 0) {
+                deliver_edge(1, fall_at + late_rise_at);
+                deliver_edge(0, fall_at + late_rise_at + duration / 4);
+            }
+        }
+    }
+    trigger_level = level;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    return pin == ECHO_PIN ? echo_level_now() : trigger_level;
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg) { (void)cfg; return ESP_OK; }
+esp_err_t gpio_install_isr_service(int flags) { (void)flags; return ESP_OK; }
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) { (void)pin; (void)type; return ESP_OK; }
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg)
+{
+    (void)pin;
+    echo_isr = isr;
+    echo_isr_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+{
+    (void)pin;
+    echo_isr = NULL;
+    return ESP_OK;
+}
+
+// Programa un echo para la distancia dada (la duración se recoloca al terminar el trigger)
+static void schedule_echo(const hcsr04p_sensor_t *sensor, double distance_cm, int64_t late_after_us)
+{
+    rise_at = 0;
+    fall_at = (int64_t)llround(2.0 * distance_cm / sensor->sound_speed_cm_us);
+    late_rise_at = late_after_us;
+    echo_level = 0;
+    busy_us = 0;
+}
+
+typedef struct {
+    double sum_err, max_err;
+    int64_t busy_us;
+    int errors;
+} path_stats_t;
+
+static void measure_path(hcsr04p_sensor_t *sensor, int use_isr, int count, path_stats_t *st)
+{
+    srand(1234);            // Mismas distancias en los dos caminos
+    polling = !use_isr;
+    for (int i = 0; i < count; i++) {
+        double real = uniform(MIN_CM, MAX_CM);
+        schedule_echo(sensor, real, -1);
+        float d = hcsr04p_read_distance(sensor);
+        if (d < 0) {
+            st->errors++;
+            continue;
+        }
+        double err = fabs(d - real);
+        st->sum_err += err;
+        if (err > st->max_err) {
+            st->max_err = err;
+        }
+        st->busy_us += busy_us;
+    }
+    polling = 0;
+}
+
+static int64_t cb_start, cb_end;
+static unsigned cb_calls;
+
+static void on_echo(int64_t echo_start_us, int64_t echo_end_us, void *arg)
+{
+    (void)arg;
+    cb_start = echo_start_us;
+    cb_end = echo_end_us;
+    cb_calls++;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 5000;
+    hcsr04p_sensor_t sensor;
+    path_stats_t poll = {0}, isr = {0};
+
+    CHECK(hcsr04p_init(&sensor, TRIGGER_PIN, ECHO_PIN));
+    printf("%d medidas entre %.0f y %.0f cm\n", count, MIN_CM, MAX_CM);
+
+    measure_path(&sensor, 0, count, &poll);
+    CHECK(hcsr04p_enable_async(&sensor));
+    isr_entries = 0;
+    measure_path(&sensor, 1, count, &isr);
+    printf("  polling:      error medio %.3f cm, máximo %.3f cm, cpu %6.0f us/medida, %d fallos\n",
+           poll.sum_err / count, poll.max_err, (double)poll.busy_us / count, poll.errors);
+    printf("  interrupción: error medio %.3f cm, máximo %.3f cm, cpu %6.0f us/medida, %d fallos (%.1f ISR/medida)\n",
+           isr.sum_err / count, isr.max_err, (double)isr.busy_us / count, isr.errors,
+           (double)isr_entries / count);
+
+    // La latencia de la ISR acota el error: ISR_LATENCY_MAX_US de duración = ~0.07 cm
+    CHECK(isr.errors == 0);
+    CHECK(isr.max_err < ISR_LATENCY_MAX_US * sensor.sound_speed_cm_us / 2.0 + 0.05);
+    CHECK(isr.busy_us * 10 < poll.busy_us);
+    CHECK(isr.max_err <= poll.max_err);
+
+    // Echo tardío tras la bajada: no mueve la subida ni da una duración negativa
+    schedule_echo(&sensor, 150.0, 2000);
+    float d = hcsr04p_read_distance(&sensor);
+    printf("  echo tardío: %.2f cm (real 150.00)\n", d);
+    CHECK(fabs(d - 150.0) < 0.2);
+
+    // Bajada sin subida previa (residuo de otro echo): se ignora y la medida sigue
+    rise_at = -1;
+    CHECK(hcsr04p_start_measurement(&sensor, NULL, NULL));
+    echo_level = 0;
+    echo_isr(echo_isr_arg);
+    CHECK(sensor.echo_fall_us == 0);
+    CHECK(hcsr04p_wait_distance(&sensor, 0) < 0);
+
+    // El callback recibe las marcas de tiempo; la distancia se calcula fuera de la ISR
+    schedule_echo(&sensor, 250.0, -1);
+    cb_calls = 0;
+    CHECK(hcsr04p_start_measurement(&sensor, on_echo, NULL));
+    d = hcsr04p_wait_distance(&sensor, 50);
+    CHECK(cb_calls == 1);
+    CHECK(d == hcsr04p_echo_to_distance(&sensor, cb_start, cb_end));
+    CHECK(fabs(d - 250.0) < 0.2);
+
+    // Sin echo: timeout y -1
+    rise_at = -1;
+    CHECK(hcsr04p_read_distance(&sensor) < 0);
+
+    hcsr04p_disable_async(&sensor);
+    printf(failures ? "FALLO (%d)\n" : "OK\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,17 @@
+// tools/host/driver/i2c.h
+// Driver I2C legado: solo las transacciones completas que usan los componentes.
+// Las implementa cada prueba (normalmente contra un dispositivo simulado)
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2c_port_t;
+
+esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer,
+                                     size_t write_size, TickType_t ticks_to_wait);
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer,
+                                       size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                       TickType_t ticks_to_wait);
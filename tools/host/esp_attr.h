@@ -0,0 +1,8 @@
+// tools/host/esp_attr.h
+// Atributos de sección sin efecto en host
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
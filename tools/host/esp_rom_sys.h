@@ -0,0 +1,7 @@
+// tools/host/esp_rom_sys.h
+// Esperas activas de la rom: las implementa cada prueba (normalmente avanzando su reloj simulado)
+#pragma once
+
+#include <stdint.h>
+
+void esp_rom_delay_us(uint32_t us);
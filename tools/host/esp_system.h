@@ -0,0 +1,4 @@
+// tools/host/esp_system.h
+#pragma once
+
+#include "esp_err.h"
@@ -0,0 +1,7 @@
+// tools/host/esp_timer.h
+// Reloj en microsegundos: lo implementa cada prueba (reloj simulado o real)
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,112 @@
+// tools/host/flash_log_file.c
+#include "flash_log_file.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int raw_read(flash_file_t *ff, uint32_t offset, void *buf, size_t len)
+{
+    return offset + len <= ff->size && fseek(ff->f, offset, SEEK_SET) == 0 &&
+           fread(buf, 1, len, ff->f) == len ? 0 : -1;
+}
+
+static esp_err_t file_read(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    flash_file_t *ff = ctx;
+    if (raw_read(ff, offset, buf, len) != 0) {
+        return ESP_FAIL;
+    }
+    ff->reads++;
+    ff->bytes_read += len;
+    return ESP_OK;
+}
+
+// Como la flash NOR: programar solo puede pasar bits de 1 a 0
+static esp_err_t file_write(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    flash_file_t *ff = ctx;
+    uint8_t cur[256];
+    const uint8_t *src = buf;
+    esp_err_t ret = ESP_OK;
+
+    if (offset + len > ff->size) {
+        return ESP_FAIL;
+    }
+    if (ff->cut_after) {
+        if (ff->bytes_written >= ff->cut_after) {
+            return ESP_FAIL;
+        }
+        if (ff->bytes_written + len > ff->cut_after) {
+            len = (size_t)(ff->cut_after - ff->bytes_written);
+            ret = ESP_FAIL;
+        }
+    }
+
+    for (size_t done = 0; done < len; ) {
+        size_t n = len - done < sizeof(cur) ? len - done : sizeof(cur);
+        if (raw_read(ff, offset + done, cur, n) != 0) {
+            return ESP_FAIL;
+        }
+        for (size_t i = 0; i < n; i++) {
+            cur[i] &= src[done + i];
+        }
+        if (fseek(ff->f, offset + done, SEEK_SET) != 0 || fwrite(cur, 1, n, ff->f) != n) {
+            return ESP_FAIL;
+        }
+        done += n;
+    }
+    ff->writes++;
+    ff->bytes_written += len;
+    return ret;
+}
+
+static esp_err_t file_erase(void *ctx, uint32_t offset, size_t len)
+{
+    flash_file_t *ff = ctx;
+    uint8_t ones[4096];
+
+    if (offset % ff->sector_size || len % ff->sector_size || offset + len > ff->size ||
+        ff->sector_size > sizeof(ones)) {
+        return ESP_FAIL;
+    }
+    memset(ones, 0xff, ff->sector_size);
+    for (size_t done = 0; done < len; done += ff->sector_size) {
+        if (fseek(ff->f, offset + done, SEEK_SET) != 0 ||
+            fwrite(ones, 1, ff->sector_size, ff->f) != ff->sector_size) {
+            return ESP_FAIL;
+        }
+        ff->erases++;
+    }
+    return ESP_OK;
+}
+
+int flash_file_open(flash_file_t *ff, const char *path, uint32_t size, uint32_t sector_size,
+                    flash_log_io_t *io)
+{
+    memset(ff, 0, sizeof(*ff));
+    ff->size = size;
+    ff->sector_size = sector_size;
+    ff->f = fopen(path, "r+b");
+    if (ff->f == NULL) {
+        ff->f = fopen(path, "w+b");
+        if (ff->f == NULL || file_erase(ff, 0, size) != ESP_OK) {
+            return -1;
+        }
+        ff->erases = 0;
+    }
+
+    io->read = file_read;
+    io->write = file_write;
+    io->erase = file_erase;
+    io->ctx = ff;
+    io->size = size;
+    io->sector_size = sector_size;
+    return 0;
+}
+
+void flash_file_close(flash_file_t *ff)
+{
+    if (ff->f) {
+        fclose(ff->f);
+        ff->f = NULL;
+    }
+}
@@ -0,0 +1,25 @@
+// tools/host/flash_log_file.h
+// Medio de flash_log sobre una imagen en fichero con semántica NOR, para pruebas en host
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "flash_log.h"
+
+typedef struct {
+    FILE *f;
+    uint32_t size;
+    uint32_t sector_size;
+    // Contadores de operaciones (para estimar el coste en el dispositivo)
+    uint32_t reads, writes, erases;
+    uint64_t bytes_read, bytes_written;
+    // Corte de alimentación simulado: tras cut_after bytes escritos, las escrituras
+    // quedan a medias y fallan (0 = desactivado)
+    uint64_t cut_after;
+} flash_file_t;
+
+// Abre (o crea, borrada a 0xff) la imagen y rellena io; devuelve 0 o -1
+int flash_file_open(flash_file_t *ff, const char *path, uint32_t size, uint32_t sector_size,
+                    flash_log_io_t *io);
+
+void flash_file_close(flash_file_t *ff);
@@ -0,0 +1,37 @@
+// tools/host/freertos/FreeRTOS.h
+// Tipos y macros básicos de FreeRTOS sobre pthreads para las pruebas en host (tick de 1 ms)
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef uint32_t EventBits_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(x)   ((void)(x))
+
+static inline TickType_t host_tick_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Plazo absoluto para pthread_*_timedwait a partir de ticks (portMAX_DELAY = sin plazo)
+static inline struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
@@ -0,0 +1,77 @@
+// tools/host/freertos/event_groups.h
+// Grupos de eventos con pthread_mutex + pthread_cond
+#pragma once
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    EventBits_t bits;
+} host_event_group_t;
+
+typedef host_event_group_t *EventGroupHandle_t;
+
+static inline EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t g = calloc(1, sizeof(*g));
+    if (g != NULL) {
+        pthread_mutex_init(&g->mutex, NULL);
+        pthread_cond_init(&g->cond, NULL);
+    }
+    return g;
+}
+
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->mutex);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
+
+static inline EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    pthread_mutex_lock(&g->mutex);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->mutex);
+    return before;
+}
+
+static inline EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    pthread_mutex_lock(&g->mutex);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
+
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits,
+                                              BaseType_t clear, BaseType_t all, TickType_t ticks)
+{
+    struct timespec ts = host_deadline(ticks);
+    pthread_mutex_lock(&g->mutex);
+    while (1) {
+        EventBits_t hit = g->bits & bits;
+        if (all ? hit == bits : hit != 0) {
+            break;
+        }
+        int err = ticks == portMAX_DELAY ? pthread_cond_wait(&g->cond, &g->mutex)
+                                         : pthread_cond_timedwait(&g->cond, &g->mutex, &ts);
+        if (err == ETIMEDOUT) {
+            break;
+        }
+    }
+    EventBits_t now = g->bits;
+    if (clear && (all ? (now & bits) == bits : (now & bits) != 0)) {
+        g->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
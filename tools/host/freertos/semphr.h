@@ -0,0 +1,80 @@
+// tools/host/freertos/semphr.h
+// Semáforos (mutex, binario y de aviso desde "ISR") con pthread_mutex + pthread_cond
+#pragma once
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned count;
+} host_semaphore_t;
+
+typedef host_semaphore_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t host_semaphore_create(unsigned count)
+{
+    SemaphoreHandle_t s = calloc(1, sizeof(*s));
+    if (s != NULL) {
+        pthread_mutex_init(&s->mutex, NULL);
+        pthread_cond_init(&s->cond, NULL);
+        s->count = count;
+    }
+    return s;
+}
+
+// Un mutex es un semáforo binario que empieza libre (sin herencia de prioridad en host)
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return host_semaphore_create(1);
+}
+
+static inline SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return host_semaphore_create(0);
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    struct timespec ts = host_deadline(ticks);
+    int err = 0;
+    pthread_mutex_lock(&s->mutex);
+    while (s->count == 0 && err != ETIMEDOUT) {
+        err = ticks == portMAX_DELAY ? pthread_cond_wait(&s->cond, &s->mutex)
+                                     : pthread_cond_timedwait(&s->cond, &s->mutex, &ts);
+    }
+    BaseType_t taken = s->count > 0 ? pdTRUE : pdFALSE;
+    if (taken) {
+        s->count--;
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return taken;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&s->mutex);
+    BaseType_t given = s->count == 0 ? pdTRUE : pdFALSE;
+    s->count = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return given;
+}
+
+static inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *woken)
+{
+    if (woken != NULL) {
+        *woken = pdFALSE;
+    }
+    return xSemaphoreGive(s);
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    free(s);
+}
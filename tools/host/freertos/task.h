@@ -0,0 +1,17 @@
+// tools/host/freertos/task.h
+#pragma once
+
+#include <unistd.h>
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;            // Solo para los structs de los componentes
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return host_tick_count();
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
@@ -0,0 +1,19 @@
+// tools/host/soc/gpio_reg.h
+// Registros de entrada/salida de GPIO: direcciones del ESP32, leídas y escritas a través de
+// host_reg_read()/host_reg_write(), que implementa cada prueba
+#pragma once
+
+#include <stdint.h>
+
+#define GPIO_OUT_W1TS_REG       0x3ff44008
+#define GPIO_OUT_W1TC_REG       0x3ff4400c
+#define GPIO_OUT1_W1TS_REG      0x3ff44014
+#define GPIO_OUT1_W1TC_REG      0x3ff44018
+#define GPIO_IN_REG             0x3ff4403c
+#define GPIO_IN1_REG            0x3ff44040
+
+uint32_t host_reg_read(uint32_t reg);
+void host_reg_write(uint32_t reg, uint32_t value);
+
+#define REG_READ(reg)           host_reg_read(reg)
+#define REG_WRITE(reg, value)   host_reg_write((reg), (value))
@@ -0,0 +1,159 @@
+// tools/json_writer_bench.c
+//
+// Benchmark en host del serializador json_writer frente al formateo con snprintf("%.2f")
+// que usaban communication_publish_batch() y communication_task.
+// Mide bytes/s y pila máxima usada por cada implementación al serializar un lote.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Icomponents/utils/include tools/json_writer_bench.c components/utils/json_writer.c -lm -lpthread -o /tmp/json_bench
+//   /tmp/json_bench [iteraciones]
+//
+// En host la pila de snprintf depende de glibc; en el esp32 (newlib con float) la diferencia es mayor.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "json_writer.h"
+
+#define BATCH_SAMPLES   10
+#define MSG_SIZE        2048
+#define STACK_SIZE      (64 * 1024)
+#define STACK_PATTERN   0xA5
+
+// Mismos campos que nivometro_data_t publicados en el lote
+typedef struct {
+    uint64_t timestamp_us;
+    float us_cm, us_q, w_g, l_mm, bat_v;
+    uint8_t st;
+    int8_t t_c;
+} sample_t;
+
+static sample_t samples[BATCH_SAMPLES];
+static char out[MSG_SIZE];
+
+static int format_snprintf(void)
+{
+    int len = snprintf(out, sizeof(out), "{\"v\":1,\"n\":%u,\"s\":[", (unsigned)BATCH_SAMPLES);
+    for (int i = 0; i < BATCH_SAMPLES && len < (int)sizeof(out); i++) {
+        const sample_t *d = &samples[i];
+        len += snprintf(out + len, sizeof(out) - len,
+                        "%s{\"ts\":%llu,\"us_cm\":%.2f,\"us_q\":%.2f,\"w_g\":%.2f,\"l_mm\":%.0f,"
+                        "\"st\":%u,\"bat_v\":%.2f,\"t_c\":%d}",
+                        i ? "," : "", (unsigned long long)d->timestamp_us,
+                        d->us_cm, d->us_q, d->w_g, d->l_mm, d->st, d->bat_v, d->t_c);
+    }
+    if (len < (int)sizeof(out)) len += snprintf(out + len, sizeof(out) - len, "]}");
+    return len < (int)sizeof(out) ? len : -1;
+}
+
+static int format_json_writer(void)
+{
+    json_writer_t w;
+    json_writer_init(&w, out, sizeof(out));
+    json_obj_begin(&w, NULL);
+    json_write_uint(&w, "v", 1);
+    json_write_uint(&w, "n", BATCH_SAMPLES);
+    json_arr_begin(&w, "s");
+    for (int i = 0; i < BATCH_SAMPLES; i++) {
+        const sample_t *d = &samples[i];
+        json_obj_begin(&w, NULL);
+        json_write_uint(&w, "ts", d->timestamp_us);
+        json_write_fixed(&w, "us_cm", d->us_cm, 2);
+        json_write_fixed(&w, "us_q", d->us_q, 2);
+        json_write_fixed(&w, "w_g", d->w_g, 2);
+        json_write_fixed(&w, "l_mm", d->l_mm, 0);
+        json_write_uint(&w, "st", d->st);
+        json_write_fixed(&w, "bat_v", d->bat_v, 2);
+        json_write_int(&w, "t_c", d->t_c);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w);
+}
+
+typedef struct {
+    int (*fn)(void);
+    long iterations;
+    int len;
+    double seconds;
+    uint8_t *entry_sp;      // Pila al entrar al hilo (aprox.)
+} run_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *run_thread(void *arg)
+{
+    run_t *r = arg;
+    uint8_t marker;
+    r->entry_sp = &marker;
+    double t0 = now_s();
+    for (long i = 0; i < r->iterations; i++) {
+        r->len = r->fn();
+    }
+    r->seconds = now_s() - t0;
+    return NULL;
+}
+
+// Ejecuta fn en un hilo con pila pintada y devuelve los bytes de pila usados por debajo de la entrada al hilo
+static size_t run_measured(run_t *r)
+{
+    uint8_t *stack = malloc(STACK_SIZE);
+    memset(stack, STACK_PATTERN, STACK_SIZE);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, STACK_SIZE);
+    pthread_t th;
+    pthread_create(&th, &attr, run_thread, r);
+    pthread_join(th, NULL);
+    pthread_attr_destroy(&attr);
+
+    // La pila crece hacia abajo: el primer byte modificado marca la profundidad máxima
+    size_t untouched = 0;
+    while (untouched < STACK_SIZE && stack[untouched] == STACK_PATTERN) untouched++;
+    size_t used = (size_t)(r->entry_sp - (stack + untouched));
+    free(stack);
+    return used;
+}
+
+static void report(const char *name, int (*fn)(void), long iterations)
+{
+    run_t r = { .fn = fn, .iterations = iterations };
+    size_t stack = run_measured(&r);
+    printf("%-12s %5d B/msg  %8.0f msg/s  %7.2f MB/s  pila %5zu B\n",
+           name, r.len, iterations / r.seconds, r.len * iterations / r.seconds / 1e6,
+           stack);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 100000;
+
+    for (int i = 0; i < BATCH_SAMPLES; i++) {
+        samples[i] = (sample_t){
+            .timestamp_us = 1700000000000000ULL + i * 10000000ULL,
+            .us_cm = 123.456f + i, .us_q = 0.8f, .w_g = -1520.37f + i * 3.1f,
+            .l_mm = 812.0f + i, .bat_v = 3.71f, .st = 7, .t_c = -18,
+        };
+    }
+
+    // Primera llamada fuera del hilo medido: resuelve símbolos dinámicos y muestra ambas salidas
+    format_snprintf();
+    printf("snprintf:    %.96s...\n", out);
+    format_json_writer();
+    printf("json_writer: %.96s...\n\n", out);
+    now_s();
+
+    report("snprintf", format_snprintf, iterations);
+    report("json_writer", format_json_writer, iterations);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// tools/sample_bus_stress.c
+//
+// Prueba de estrés en host del bus de muestras (components/sample_bus).
+// Un productor publica registros a máxima velocidad y tres consumidores de distinta
+// velocidad los leen en sitio. Comprueba que:
+//   - cada consumidor ve secuencias estrictamente crecientes y sin registros corruptos;
+//   - un tramo prestado (peek) no cambia hasta su release, aunque el productor siga;
+//   - los huecos en las secuencias coinciden con el contador overflow;
+//   - delivered + overflow + pending == publicados, para cada consumidor.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Itools/host -Icomponents/sample_bus/include tools/sample_bus_stress.c components/sample_bus/sample_bus.c -lpthread -o /tmp/sample_bus_stress
+//   /tmp/sample_bus_stress [registros]
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sample_bus.h"
+
+#define BUS_SLOTS       32
+#define PAYLOAD_WORDS   6
+#define CANCEL_EVERY    97      // Cada cuántas reservas el productor simula una lectura fallida
+#define BURST           16      // Registros publicados seguidos antes de ceder la cpu
+
+// Registro de prueba: todos los campos se derivan de seq para detectar lecturas a medias
+typedef struct {
+    uint32_t seq;
+    uint32_t payload[PAYLOAD_WORDS];
+    uint32_t check;
+} record_t;
+
+typedef struct {
+    const char *name;
+    int id;
+    size_t max_span;            // Registros por peek
+    size_t min_wait;            // Registros que espera antes de leer
+    unsigned hold_us;           // Tiempo máximo con el tramo prestado
+    uint32_t seen;
+    uint32_t lost;              // Registros saltados según las secuencias
+    uint32_t errors;
+} consumer_ctx_t;
+
+static record_t storage[BUS_SLOTS];
+static sample_bus_t bus;
+static atomic_bool producer_done;
+static uint32_t claimed_ok, cancelled, published;
+
+static uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    return x ^ (x >> 16);
+}
+
+static void fill(record_t *r, uint32_t seq)
+{
+    r->seq = seq;
+    r->check = seq;
+    for (int i = 0; i < PAYLOAD_WORDS; i++) {
+        r->payload[i] = mix(seq * PAYLOAD_WORDS + i);
+        r->check ^= r->payload[i];
+    }
+}
+
+static int valid(const record_t *r)
+{
+    uint32_t check = r->seq;
+    for (int i = 0; i < PAYLOAD_WORDS; i++) {
+        if (r->payload[i] != mix(r->seq * PAYLOAD_WORDS + i)) {
+            return 0;
+        }
+        check ^= r->payload[i];
+    }
+    return check == r->check;
+}
+
+static void *producer(void *arg)
+{
+    uint32_t total = *(uint32_t *)arg;
+    uint32_t attempts = 0;
+
+    while (published < total) {
+        record_t *slot = sample_bus_claim(&bus);
+        attempts++;
+        if (slot == NULL) {
+            usleep(1);                      // Hueco prestado: muestra descartada (producer_dropped)
+            continue;
+        }
+        claimed_ok++;
+        fill(slot, published);
+        if (attempts % CANCEL_EVERY == 0) {
+            slot->seq = 0xffffffffU;        // Basura que nadie debe llegar a ver
+            sample_bus_cancel(&bus);
+            cancelled++;
+            continue;
+        }
+        sample_bus_publish(&bus);
+        published++;
+        if (published % BURST == 0) {
+            usleep(1);                      // Ráfagas de BURST registros: los consumidores rápidos alcanzan
+        }
+    }
+    atomic_store(&producer_done, 1);
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    consumer_ctx_t *ctx = arg;
+    unsigned seed = (unsigned)ctx->id * 7919U + 1;
+    uint32_t expected = 0;
+
+    while (1) {
+        int done = atomic_load(&producer_done);
+        size_t pending = sample_bus_wait(&bus, ctx->id, ctx->min_wait, 5);
+        if (pending == 0) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+
+        const record_t *span;
+        size_t n = sample_bus_peek(&bus, ctx->id, (const void **)&span, ctx->max_span);
+        for (size_t i = 0; i < n; i++) {
+            if (!valid(&span[i]) || span[i].seq < expected) {
+                ctx->errors++;
+                continue;
+            }
+            ctx->lost += span[i].seq - expected;
+            expected = span[i].seq + 1;
+            ctx->seen++;
+        }
+
+        // Con el tramo prestado el productor no puede tocarlo
+        if (ctx->hold_us) {
+            usleep(rand_r(&seed) % ctx->hold_us);
+            for (size_t i = 0; i < n; i++) {
+                if (!valid(&span[i]) || span[i].seq + (uint32_t)(n - i) != expected) {
+                    ctx->errors++;
+                }
+            }
+        }
+        sample_bus_release(&bus, ctx->id, n);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t total = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 200000;
+    consumer_ctx_t ctx[] = {
+        { .name = "rapido", .max_span = BUS_SLOTS, .min_wait = 1,  .hold_us = 0 },
+        { .name = "lotes",  .max_span = 10,        .min_wait = 10, .hold_us = 200 },
+        { .name = "lento",  .max_span = 1,         .min_wait = 1,  .hold_us = 50 },
+    };
+    const int n_ctx = sizeof(ctx) / sizeof(ctx[0]);
+    pthread_t prod, cons[SAMPLE_BUS_MAX_CONSUMERS];
+
+    if (sample_bus_init(&bus, storage, sizeof(record_t), BUS_SLOTS) != ESP_OK) {
+        fprintf(stderr, "sample_bus_init falló\n");
+        return 1;
+    }
+    for (int i = 0; i < n_ctx; i++) {
+        ctx[i].id = sample_bus_subscribe(&bus, ctx[i].name);
+        pthread_create(&cons[i], NULL, consumer, &ctx[i]);
+    }
+    pthread_create(&prod, NULL, producer, &total);
+
+    pthread_join(prod, NULL);
+    for (int i = 0; i < n_ctx; i++) {
+        pthread_join(cons[i], NULL);
+    }
+
+    int failed = 0;
+    printf("publicados %u, reservas %u, canceladas %u, descartes del productor %u\n",
+           published, claimed_ok, cancelled, bus.producer_dropped);
+    for (int i = 0; i < n_ctx; i++) {
+        sample_bus_consumer_stats_t st;
+        sample_bus_get_stats(&bus, ctx[i].id, &st);
+        int ok = ctx[i].errors == 0 &&
+                 st.delivered == ctx[i].seen &&
+                 st.overflow == ctx[i].lost &&
+                 st.delivered + st.overflow + st.pending == published;
+        printf("%-7s leídos %7u  overflow %7u  pendientes %u  errores %u  %s\n",
+               ctx[i].name, st.delivered, st.overflow, st.pending, ctx[i].errors, ok ? "OK" : "FALLO");
+        failed |= !ok;
+    }
+    return failed;
+}
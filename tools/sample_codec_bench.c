@@ -0,0 +1,266 @@
+// tools/sample_codec_bench.c
+//
+// Benchmark en host del esquema v2 de sample_codec (bloques comprimidos) frente al
+// struct en RAM, al esquema v1 y al registro de 64 bytes de flash_log.
+//
+// Por defecto usa una traza sintética de estación: una muestra por minuto con jitter
+// de reloj, nieve que crece y funde despacio, ruido de balanza y láser, ciclo diario de
+// temperatura, descarga lenta de batería y fallos esporádicos de sensor. Con un CSV de
+// datos registrados (ts_us,us_cm,us_q,l_mm,w_g,st,bat_v,t_c por línea) mide sobre él.
+//
+// Comprueba además que v2 decodifica exactamente lo mismo que v1 (misma cuantización),
+// que sample_codec_decode_range devuelve los mismos tramos y que sample_codec_block_append
+// deja el bloque intacto cuando la muestra no cabe.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   gcc -O2 -Itools/host -Icomponents/sample_codec/include -Icomponents/nivometro_sensors/include
+//       -Icomponents/hcsr04p/include -Icomponents/hx711/include -Icomponents/vl53l0x/include
+//       -Icomponents/filters/include tools/sample_codec_bench.c components/sample_codec/sample_codec.c -lm -o /tmp/sample_codec_bench
+//   /tmp/sample_codec_bench [datos.csv]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample_codec.h"
+
+#define TRACE_SAMPLES   (60 * 24 * 30)      // Un mes a una muestra por minuto
+#define BLOCK_SIZE      240                 // Bloque por registro de flash en storage
+#define BATCH_SAMPLES   10                  // MQTT_BATCH_SAMPLES
+#define RAW_SIZE        40                  // sizeof(nivometro_data_t) en el esp32
+#define FLASH_RECORD    64                  // Registro de flash_log por muestra
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double noise(double amplitude)
+{
+    return amplitude * ((double)rand() / RAND_MAX * 2.0 - 1.0);
+}
+
+static size_t synthetic_trace(nivometro_data_t *s, size_t n)
+{
+    uint64_t ts = 1700000000ULL * 1000000ULL;
+    double snow_cm = 40.0;
+    srand(1);
+    for (size_t i = 0; i < n; i++) {
+        double day = (double)i / (60 * 24);
+        snow_cm += (i % 4000 < 300) ? 0.02 : -0.002;        // Nevadas y fusión lenta
+        if (snow_cm < 0) snow_cm = 0;
+
+        nivometro_data_t *d = &s[i];
+        memset(d, 0, sizeof(*d));
+        ts += 60000000ULL + (uint64_t)(rand() % 40) * 1000;  // 60 s + jitter de despertar
+        d->timestamp_us = ts;
+        d->ultrasonic_distance_cm = (float)(200.0 - snow_cm + noise(0.3));
+        d->ultrasonic_confidence = (float)(0.9 + noise(0.05));
+        d->laser_distance_mm = (float)round((200.0 - snow_cm) * 10.0 + noise(2.0));
+        d->weight_grams = (float)(snow_cm * 35.0 + noise(5.0));
+        d->battery_voltage = (float)(4.1 - day * 0.01 + noise(0.002));
+        d->temperature_c = (int8_t)lround(-5.0 + 6.0 * sin(day * 2 * M_PI));
+        d->sensor_status = (rand() % 500 == 0) ? 0x05 : 0x07;
+        d->sampled_mask = 0x07;
+    }
+    return n;
+}
+
+static size_t load_csv(const char *path, nivometro_data_t *s, size_t max)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t n = 0;
+    if (!f) {
+        printf("No se pudo abrir %s\n", path);
+        exit(2);
+    }
+    while (n < max && fgets(line, sizeof(line), f)) {
+        unsigned long long ts;
+        float us, usq, l, w, bat;
+        int st, t;
+        if (sscanf(line, "%llu,%f,%f,%f,%f,%d,%f,%d", &ts, &us, &usq, &l, &w, &st, &bat, &t) != 8) {
+            continue;                                        // Cabecera o línea inválida
+        }
+        nivometro_data_t *d = &s[n++];
+        memset(d, 0, sizeof(*d));
+        d->timestamp_us = ts;
+        d->ultrasonic_distance_cm = us;
+        d->ultrasonic_confidence = usq;
+        d->laser_distance_mm = l;
+        d->weight_grams = w;
+        d->sensor_status = (uint8_t)st;
+        d->battery_voltage = bat;
+        d->temperature_c = (int8_t)t;
+        d->sampled_mask = 0x07;
+    }
+    fclose(f);
+    return n;
+}
+
+static int same_sample(const nivometro_data_t *a, const nivometro_data_t *b)
+{
+    return a->timestamp_us == b->timestamp_us &&
+           a->ultrasonic_distance_cm == b->ultrasonic_distance_cm &&
+           a->ultrasonic_confidence == b->ultrasonic_confidence &&
+           a->weight_grams == b->weight_grams &&
+           a->laser_distance_mm == b->laser_distance_mm &&
+           a->sensor_status == b->sensor_status &&
+           a->battery_voltage == b->battery_voltage &&
+           a->temperature_c == b->temperature_c;
+}
+
+// Lotes de BATCH_SAMPLES: v2 debe decodificar igual que v1
+static void test_batches(const nivometro_data_t *s, size_t n)
+{
+    uint8_t v1[SAMPLE_CODEC_SIZE(BATCH_SAMPLES)];
+    uint8_t v2[SAMPLE_CODEC_V2_SIZE_MAX(BATCH_SAMPLES)];
+    nivometro_data_t d1[BATCH_SAMPLES], d2[BATCH_SAMPLES];
+    size_t bytes_v1 = 0, bytes_v2 = 0, batches = 0;
+
+    printf("lotes de %d muestras (publicación MQTT)\n", BATCH_SAMPLES);
+    for (size_t i = 0; i + BATCH_SAMPLES <= n; i += BATCH_SAMPLES, batches++) {
+        int l1 = sample_codec_encode(&s[i], BATCH_SAMPLES, v1, sizeof(v1));
+        int l2 = sample_codec_encode_v2(&s[i], BATCH_SAMPLES, v2, sizeof(v2));
+        CHECK(l1 > 0 && l2 > 0);
+        if (l1 <= 0 || l2 <= 0) return;
+        bytes_v1 += l1;
+        bytes_v2 += l2;
+
+        CHECK(sample_codec_decode(v1, l1, d1, BATCH_SAMPLES) == BATCH_SAMPLES);
+        CHECK(sample_codec_decode(v2, l2, d2, BATCH_SAMPLES) == BATCH_SAMPLES);
+        for (int k = 0; k < BATCH_SAMPLES; k++) {
+            CHECK(same_sample(&d1[k], &d2[k]));
+            CHECK(d2[k].sampled_mask == s[i + k].sampled_mask);
+        }
+        CHECK(sample_codec_decode(v2, l2 - 1, d2, BATCH_SAMPLES) == -1 || l2 == SAMPLE_CODEC_HEADER_SIZE + 1);
+    }
+    if (batches) {
+        printf("  v1 %.1f B/lote, v2 %.1f B/lote (%.2fx)\n",
+               (double)bytes_v1 / batches, (double)bytes_v2 / batches, (double)bytes_v1 / bytes_v2);
+    }
+}
+
+// Bloques de BLOCK_SIZE bytes llenados con sample_codec_block_append, como en storage
+static void test_blocks(const nivometro_data_t *s, size_t n)
+{
+    static nivometro_data_t out[SAMPLE_CODEC_MAX_RECORDS];
+    uint8_t buf[BLOCK_SIZE], copy[BLOCK_SIZE];
+    sample_codec_block_t b;
+    size_t blocks = 0, bytes = 0, i = 0;
+    double t_enc = 0, t_dec = 0;
+
+    printf("bloques de %d bytes (almacenamiento)\n", BLOCK_SIZE);
+    while (i < n) {
+        size_t first = i;
+        double t0 = now_s();
+        sample_codec_block_init(&b, buf, sizeof(buf));
+        while (i < n) {
+            sample_codec_block_t before = b;
+            memcpy(copy, buf, sizeof(buf));
+            if (!sample_codec_block_append(&b, &s[i])) {
+                // Rechazo: ni el estado ni el buffer cambian
+                CHECK(memcmp(&before, &b, sizeof(b)) == 0);
+                CHECK(memcmp(copy, buf, sizeof(buf)) == 0);
+                break;
+            }
+            i++;
+        }
+        t_enc += now_s() - t0;
+        CHECK(b.count > 0);
+        if (b.count == 0) return;
+        blocks++;
+        bytes += sample_codec_block_size(&b);
+
+        t0 = now_s();
+        int got = sample_codec_decode(buf, sample_codec_block_size(&b), out, SAMPLE_CODEC_MAX_RECORDS);
+        t_dec += now_s() - t0;
+        CHECK(got == b.count);
+
+        // Lectura por tramos, como storage_outbox_peek tras un ack parcial
+        for (int k = 0; k < got; k += 7) {
+            nivometro_data_t part[7];
+            int m = sample_codec_decode_range(buf, sample_codec_block_size(&b), k, part, 7);
+            CHECK(m == (got - k < 7 ? got - k : 7));
+            for (int j = 0; j < m; j++) {
+                CHECK(same_sample(&part[j], &out[k + j]));
+            }
+        }
+        for (int k = 0; k < got; k++) {
+            uint8_t one[SAMPLE_CODEC_SIZE(1)];
+            nivometro_data_t ref;
+            sample_codec_encode(&s[first + k], 1, one, sizeof(one));
+            sample_codec_decode(one, sizeof(one), &ref, 1);
+            CHECK(same_sample(&ref, &out[k]));
+        }
+    }
+
+    double per_sample = (double)blocks * BLOCK_SIZE / n;
+    printf("  %zu muestras en %zu bloques: %.1f muestras/bloque, %.2f B/muestra codificados, %.2f B/muestra en flash\n",
+           n, blocks, (double)n / blocks, (double)bytes / n, per_sample);
+    printf("  frente a struct en RAM (%d B): %.1fx, v1 (%d B): %.1fx, registro flash_log (%d B): %.1fx\n",
+           RAW_SIZE, RAW_SIZE / per_sample, SAMPLE_CODEC_RECORD_SIZE,
+           SAMPLE_CODEC_RECORD_SIZE / per_sample, FLASH_RECORD, FLASH_RECORD / per_sample);
+    printf("  codificación %.0f muestras/s, decodificación %.0f muestras/s (host)\n",
+           n / t_enc, n / t_dec);
+}
+
+// Saltos extremos de reloj y valores saturados: siempre caben en el peor caso
+static void test_extremes(void)
+{
+    nivometro_data_t s[4] = { 0 }, d[4];
+    uint8_t buf[SAMPLE_CODEC_V2_SIZE_MAX(4)];
+
+    printf("valores extremos\n");
+    s[0].timestamp_us = 0;                                   // Antes de sincronizar la hora
+    s[1].timestamp_us = 1700000000ULL * 1000000ULL;          // Tras sincronizar
+    s[2].timestamp_us = 1000;                                // Reloj hacia atrás
+    s[3].timestamp_us = UINT64_MAX / 2;
+    s[1].weight_grams = 2.0e7f;
+    s[2].weight_grams = -2.0e7f;
+    s[3].ultrasonic_distance_cm = 1e9f;
+    s[3].temperature_c = -128;
+    s[3].sensor_status = 0x07;
+    s[3].sampled_mask = 0x05;
+
+    int len = sample_codec_encode_v2(s, 4, buf, sizeof(buf));
+    CHECK(len > 0);
+    CHECK(sample_codec_decode(buf, len, d, 4) == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(d[i].timestamp_us / 1000 == s[i].timestamp_us / 1000);
+    }
+    CHECK(d[1].weight_grams == 2.0e7f && d[2].weight_grams == -2.0e7f);
+    CHECK(d[3].ultrasonic_distance_cm == UINT16_MAX / 100.0f);
+    CHECK(d[3].temperature_c == -128 && d[3].sampled_mask == 0x05);
+}
+
+int main(int argc, char **argv)
+{
+    static nivometro_data_t samples[TRACE_SAMPLES];
+    size_t n;
+
+    if (argc > 1) {
+        n = load_csv(argv[1], samples, TRACE_SAMPLES);
+        printf("%zu muestras de %s\n\n", n, argv[1]);
+    } else {
+        n = synthetic_trace(samples, TRACE_SAMPLES);
+        printf("%zu muestras de la traza sintética\n\n", n);
+    }
+    if (n == 0) return 2;
+
+    test_extremes();
+    test_batches(samples, n);
+    test_blocks(samples, n);
+
+    printf("\n%s\n", failures ? "FALLO" : "OK");
+    return failures ? 1 : 0;
+}
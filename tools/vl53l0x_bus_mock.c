@@ -0,0 +1,383 @@
+// tools/vl53l0x_bus_mock.c
+//
+// Prueba en host del driver VL53L0X (components/vl53l0x) contra un bus I2C simulado.
+// El dispositivo simulado es un banco de 256 registros con autoincremento: cada escritura
+// empieza por el registro y cada lectura es registro + datos. Cuenta las transacciones y los
+// bytes que ve el bus y comprueba que coinciden con los contadores del driver.
+//
+// Se compila con cualquiera de los dos backends del driver. Con VL53L0X_I2C_MASTER_API=1 el bus
+// simulado tiene cola de transacciones: transmit() solo encola y las transacciones terminan al
+// vaciar la cola (wait_all_done o el "hardware" de la prueba), llamando a on_trans_done como lo
+// haría la ISR del controlador.
+//
+// Escenarios (el estado RTC_DATA_ATTR del driver se conserva entre llamadas, como en deep sleep):
+//   - arranque en frío con cada precisión: aplica la tabla completa;
+//   - despertar con la misma precisión: no reescribe la tabla (solo una lectura de verificación);
+//   - despertar tras un corte de alimentación del sensor: la verificación falla y se reaplica;
+//   - cambio de precisión: un bloque por transacción, sin lecturas;
+//   - lectura en modo único: disparo + ráfaga de resultado + limpieza de interrupción;
+//   - (i2c_master) lectura asíncrona: nada en el bus hasta que el controlador procesa la cola, el
+//     callback llega desde on_trans_done con la distancia y un NACK se notifica como fallo;
+//   - (i2c_master) bus sin cola: la lectura asíncrona se completa antes de retornar.
+//
+// Compilar y ejecutar desde la raíz del repositorio (el backend por defecto sale de la versión de
+// ESP-IDF, 5.2 en tools/host/esp_idf_version.h: driver legado):
+//   gcc -O2 -Itools/host -Icomponents/vl53l0x/include tools/vl53l0x_bus_mock.c components/vl53l0x/vl53l0x.c -lpthread -o /tmp/vl53l0x_bus_mock
+//   gcc -O2 -DVL53L0X_I2C_MASTER_API=1 -Itools/host -Icomponents/vl53l0x/include tools/vl53l0x_bus_mock.c components/vl53l0x/vl53l0x.c -lpthread -o /tmp/vl53l0x_bus_mock_master
+//   /tmp/vl53l0x_bus_mock && /tmp/vl53l0x_bus_mock_master
+
+#include <stdio.h>
+#include <string.h>
+#include "vl53l0x.h"
+
+#define I2C_PORT            0
+#define ADDRESS             VL53L0X_DEFAULT_ADDRESS
+#define REG_SYSRANGE_START  0x00
+#define REG_INTERRUPT_CLEAR 0x0B
+#define REG_INTERRUPT_STATUS 0x13
+#define REG_RANGE_STATUS    0x14
+#define REG_MSRC_CONFIG     0x60
+#define REG_MODEL_ID        0xC0
+
+// Dispositivo simulado
+static uint8_t regs[256];
+static unsigned bus_transactions;
+static unsigned bus_bytes;
+static unsigned bus_writes[256];        // Escrituras por registro inicial
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("  FALLO %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+// Valores de reset del sensor (corte de alimentación)
+static void device_power_on(void)
+{
+    memset(regs, 0, sizeof(regs));
+    regs[REG_MODEL_ID] = 0xEE;
+    regs[REG_MSRC_CONFIG] = 0x12;
+}
+
+static void device_write(const uint8_t *buf, size_t len)
+{
+    uint8_t reg = buf[0];
+    bus_writes[reg]++;
+    for (size_t i = 1; i < len; i++) {
+        regs[(uint8_t)(reg + i - 1)] = buf[i];
+    }
+    // Efectos de los registros de control
+    if (reg == REG_SYSRANGE_START && len > 1 && (buf[1] & 0x01)) {
+        regs[REG_RANGE_STATUS] = 11 << 3;           // Medida válida
+        regs[REG_RANGE_STATUS + 10] = 0x04;         // 1234 mm
+        regs[REG_RANGE_STATUS + 11] = 0xD2;
+        regs[REG_INTERRUPT_STATUS] = 0x04;          // Nueva medida lista
+    }
+    if (reg == REG_INTERRUPT_CLEAR && len > 1) {
+        regs[REG_INTERRUPT_STATUS] = 0;
+    }
+}
+
+static void device_read(uint8_t reg, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        out[i] = regs[(uint8_t)(reg + i)];
+    }
+}
+
+#if VL53L0X_I2C_MASTER_API
+
+// Transacción encolada en el controlador simulado
+typedef struct {
+    const uint8_t *write;
+    size_t write_size;
+    uint8_t *read;
+    size_t read_size;
+} pending_t;
+
+#define QUEUE_DEPTH 8
+
+static bool bus_has_queue = true;       // Bus creado con trans_queue_depth > 0
+static bool bus_nack_next;              // La siguiente transacción recibe NACK
+static pending_t queue[QUEUE_DEPTH];
+static size_t queued;
+static i2c_master_callback_t on_done;
+static void *on_done_arg;
+static struct i2c_master_bus_t { int port; } bus_obj;
+static struct i2c_master_dev_t { uint16_t address; } dev_obj;
+
+static bool execute(const pending_t *t)
+{
+    bus_transactions++;
+    bus_bytes += t->write_size + t->read_size;
+    if (bus_nack_next) {
+        bus_nack_next = false;
+        return false;
+    }
+    if (t->read_size > 0) {
+        CHECK(t->write_size == 1);
+        device_read(t->write[0], t->read, t->read_size);
+    } else {
+        device_write(t->write, t->write_size);
+    }
+    return true;
+}
+
+// El controlador procesa la cola y avisa de cada transacción (contexto ISR en el ESP32)
+static void bus_run_queue(void)
+{
+    for (size_t i = 0; i < queued; i++) {
+        i2c_master_event_data_t evt = {.event = execute(&queue[i]) ? I2C_EVENT_DONE : I2C_EVENT_NACK};
+        if (on_done != NULL) {
+            on_done(&dev_obj, &evt, on_done_arg);
+        }
+    }
+    queued = 0;
+}
+
+static esp_err_t submit(const uint8_t *write, size_t write_size, uint8_t *read, size_t read_size)
+{
+    pending_t t = {write, write_size, read, read_size};
+    if (!bus_has_queue) {
+        return execute(&t) ? ESP_OK : ESP_FAIL;
+    }
+    if (queued == QUEUE_DEPTH) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    queue[queued++] = t;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_get_bus_handle(i2c_port_t port_num, i2c_master_bus_handle_t *ret_handle)
+{
+    CHECK(port_num == I2C_PORT);
+    bus_obj.port = port_num;
+    *ret_handle = &bus_obj;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    CHECK(bus_handle == &bus_obj && dev_config->device_address == ADDRESS);
+    dev_obj.address = dev_config->device_address;
+    *ret_handle = &dev_obj;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_register_event_callbacks(i2c_master_dev_handle_t i2c_dev,
+                                              const i2c_master_event_callbacks_t *cbs, void *user_data)
+{
+    CHECK(i2c_dev == &dev_obj);
+    // Como en ESP-IDF: solo los buses con cola admiten callbacks
+    if (!bus_has_queue) {
+        on_done = NULL;
+        return ESP_ERR_INVALID_STATE;
+    }
+    on_done = cbs->on_trans_done;
+    on_done_arg = user_data;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                              int xfer_timeout_ms)
+{
+    CHECK(i2c_dev == &dev_obj && xfer_timeout_ms > 0);
+    return submit(write_buffer, write_size, NULL, 0);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer,
+                                      size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                      int xfer_timeout_ms)
+{
+    CHECK(i2c_dev == &dev_obj && xfer_timeout_ms > 0);
+    return submit(write_buffer, write_size, read_buffer, read_size);
+}
+
+esp_err_t i2c_master_bus_wait_all_done(i2c_master_bus_handle_t bus_handle, int timeout_ms)
+{
+    CHECK(bus_handle == &bus_obj && timeout_ms > 0);
+    bus_run_queue();
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer,
+                                     size_t write_size, TickType_t ticks_to_wait)
+{
+    CHECK(port == I2C_PORT && address == ADDRESS && ticks_to_wait > 0);
+    bus_transactions++;
+    bus_bytes += write_size;
+    device_write(write_buffer, write_size);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer,
+                                       size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                       TickType_t ticks_to_wait)
+{
+    CHECK(port == I2C_PORT && address == ADDRESS && write_size == 1 && ticks_to_wait > 0);
+    bus_transactions++;
+    bus_bytes += write_size + read_size;
+    device_read(write_buffer[0], read_buffer, read_size);
+    return ESP_OK;
+}
+
+#endif
+
+// GPIO1 no se usa en estas pruebas
+esp_err_t gpio_config(const gpio_config_t *cfg) { (void)cfg; return ESP_OK; }
+esp_err_t gpio_install_isr_service(int flags) { (void)flags; return ESP_OK; }
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg) { (void)pin; (void)isr; (void)arg; return ESP_OK; }
+
+static void reset_counters(void)
+{
+    bus_transactions = 0;
+    bus_bytes = 0;
+    memset(bus_writes, 0, sizeof(bus_writes));
+}
+
+// Inicializa y comprueba que los contadores del driver cuadran con el bus
+static unsigned init_and_count(vl53l0x_sensor_t *sensor, vl53l0x_accuracy_t accuracy)
+{
+    reset_counters();
+    CHECK(vl53l0x_init_with_accuracy(sensor, I2C_PORT, ADDRESS, accuracy));
+    CHECK(sensor->i2c_transactions == bus_transactions);
+    CHECK(sensor->i2c_bytes == bus_bytes);
+    CHECK(sensor->accuracy == accuracy);
+    return bus_transactions;
+}
+
+#if VL53L0X_I2C_MASTER_API
+
+static unsigned cb_calls;
+static uint16_t cb_range;
+static bool cb_ok;
+
+static void on_range(uint16_t range_mm, bool ok, void *arg)
+{
+    (void)arg;
+    cb_range = range_mm;
+    cb_ok = ok;
+    cb_calls++;
+}
+
+// Lectura del resultado sin bloquear: ráfaga + limpieza encoladas, completadas por on_trans_done
+static void check_async_read(vl53l0x_sensor_t *sensor)
+{
+    uint16_t mm = 0;
+
+    CHECK(sensor->async_bus);
+    CHECK(vl53l0x_start_ranging(sensor));
+    reset_counters();
+    cb_calls = 0;
+    CHECK(vl53l0x_wait_data_ready(sensor, 0));
+    reset_counters();
+    uint32_t before = sensor->i2c_transactions;
+    CHECK(vl53l0x_read_range_async(sensor, on_range, NULL));
+    CHECK(queued == 2 && bus_transactions == 0 && cb_calls == 0);
+    CHECK(!vl53l0x_read_range_async(sensor, on_range, NULL));      // Ya hay una en curso
+    CHECK(!vl53l0x_wait_range_async(sensor, 0, &mm));
+    bus_run_queue();
+    CHECK(cb_calls == 1 && cb_ok && cb_range == 1234);
+    CHECK(vl53l0x_wait_range_async(sensor, 0, &mm) && mm == 1234);
+    CHECK(sensor->i2c_transactions - before == bus_transactions && bus_transactions == 2);
+    CHECK(regs[REG_INTERRUPT_STATUS] == 0);
+    printf("  lectura asíncrona: %u mm, %u transacciones encoladas\n", mm, bus_transactions);
+
+    // NACK en la ráfaga: el callback informa del fallo y la espera también
+    CHECK(vl53l0x_start_ranging(sensor));
+    cb_calls = 0;
+    CHECK(vl53l0x_read_range_async(sensor, on_range, NULL));
+    bus_nack_next = true;
+    bus_run_queue();
+    CHECK(cb_calls == 1 && !cb_ok);
+    CHECK(!vl53l0x_wait_range_async(sensor, 0, &mm));
+
+    // Bus sin cola: no hay callbacks del controlador y la lectura termina antes de retornar
+    bus_has_queue = false;
+    CHECK(vl53l0x_init(sensor, I2C_PORT, ADDRESS));
+    CHECK(!sensor->async_bus);
+    CHECK(vl53l0x_start_ranging(sensor));
+    cb_calls = 0;
+    CHECK(vl53l0x_read_range_async(sensor, on_range, NULL));
+    CHECK(cb_calls == 1 && cb_ok && cb_range == 1234);
+    CHECK(vl53l0x_wait_range_async(sensor, 0, &mm) && mm == 1234);
+    bus_has_queue = true;
+}
+
+#endif
+
+int main(void)
+{
+    static const char *names[] = {"GOOD", "BETTER", "BEST", "FAST", "FASTER"};
+    static const uint8_t msrc[] = {0x1D, 0x1E, 0x1F, 0x1C, 0x18};
+    vl53l0x_sensor_t sensor;
+
+    printf("Transacciones I2C de vl53l0x_init_with_accuracy() (backend %s):\n",
+           VL53L0X_I2C_MASTER_API ? "i2c_master" : "legado");
+    for (int a = VL53L0X_ACCURACY_GOOD; a <= VL53L0X_ACCURACY_FASTER; a++) {
+        device_power_on();
+        unsigned cold = init_and_count(&sensor, a);
+        unsigned cold_bytes = bus_bytes;
+        CHECK(regs[REG_MSRC_CONFIG] == msrc[a]);
+        CHECK(bus_writes[REG_MSRC_CONFIG] == 1);
+
+        // Despertar de deep sleep: el sensor conserva sus registros y el driver su registro rtc
+        unsigned warm = init_and_count(&sensor, a);
+        unsigned warm_bytes = bus_bytes;
+        CHECK(bus_writes[REG_MSRC_CONFIG] == 0);
+        CHECK(warm < cold);
+
+        // Segundo despertar: sigue sin reescribir (antes la tabla alternaba en cada despertar)
+        unsigned warm2 = init_and_count(&sensor, a);
+        CHECK(warm2 == warm && bus_writes[REG_MSRC_CONFIG] == 0);
+
+        // El sensor perdió la alimentación durante el sueño: se detecta y se reaplica
+        device_power_on();
+        unsigned lost = init_and_count(&sensor, a);
+        CHECK(bus_writes[REG_MSRC_CONFIG] == 1 && regs[REG_MSRC_CONFIG] == msrc[a]);
+
+        printf("  %-6s frío %2u (%3u B), despertar %2u (%3u B), sensor sin alimentación %2u\n",
+               names[a], cold, cold_bytes, warm, warm_bytes, lost);
+    }
+
+    // Cambio de precisión en marcha: un bloque por transacción y ninguna lectura
+    reset_counters();
+    uint32_t before = sensor.i2c_transactions;
+    CHECK(vl53l0x_set_accuracy(&sensor, VL53L0X_ACCURACY_BEST));
+    CHECK(sensor.i2c_transactions - before == 3 && bus_transactions == 3);
+    CHECK(regs[REG_MSRC_CONFIG] == 0x1F && sensor.timing_budget_us == 200000);
+
+    // Precisión fuera de rango: rechazada sin tocar el bus
+    reset_counters();
+    CHECK(!vl53l0x_init_with_accuracy(&sensor, I2C_PORT, ADDRESS, (vl53l0x_accuracy_t)7));
+    CHECK(bus_transactions == 0);
+
+    // Lectura en modo único: disparo, comprobación de estado, ráfaga de resultado y limpieza
+    CHECK(vl53l0x_init(&sensor, I2C_PORT, ADDRESS));
+    reset_counters();
+    uint16_t mm = vl53l0x_read_distance(&sensor);
+    printf("  lectura en modo único: %u mm en %u transacciones\n", mm, bus_transactions);
+    CHECK(mm == 1234);
+    CHECK(bus_transactions == 4);
+    CHECK(regs[REG_INTERRUPT_STATUS] == 0);
+
+#if VL53L0X_I2C_MASTER_API
+    check_async_read(&sensor);
+#else
+    // Secuencia de la adquisición solapada con el driver legado: la lectura "asíncrona" termina
+    // antes de retornar y no vuelve a consultar el estado
+    CHECK(vl53l0x_start_ranging(&sensor));
+    CHECK(vl53l0x_wait_data_ready(&sensor, 0));
+    reset_counters();
+    mm = 0;
+    CHECK(vl53l0x_read_range_async(&sensor, NULL, NULL));
+    CHECK(vl53l0x_wait_range_async(&sensor, 0, &mm) && mm == 1234);
+    CHECK(bus_transactions == 2 && regs[REG_INTERRUPT_STATUS] == 0);
+    printf("  lectura asíncrona sobre bus síncrono: %u mm en %u transacciones\n", mm, bus_transactions);
+#endif
+
+    printf(failures ? "FALLO (%d)\n" : "OK\n", failures);
+    return failures != 0;
+}